@@ -0,0 +1,539 @@
+/**
+ * @file dlt_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief end to end load generator and benchmark of dlt_service
+ * @version 0.1
+ * @date 2022-01-04
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <getopt.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <dlt_lib.hpp>
+#include <dlt_enc_dec.h>
+
+using namespace auto_os::middleware;
+
+// every message carries its send time as "ts=<nanoseconds>"
+#define BENCH_TS_MARKER "ts="
+
+// time the clients get to finish before the sink stops counting
+#define BENCH_DRAIN_MS 500
+
+// maximum number of client processes
+#define BENCH_CLIENTS_MAX 64
+
+// app, context and session ids are a letter and three digits
+#define BENCH_IDS_MAX 999
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct bench_config {
+    int clients;
+    int threads;
+    int rate;
+    int duration_s;
+    int count;
+    int payload_size;
+    int apps;
+    int contexts;
+    // ring size of the asynchronous mode in KB, 0 to send synchronously
+    int async_kb;
+    // log level of each message, picked round robin
+    std::vector<dlt_msg_log_lvl> levels;
+};
+
+// what the sink saw, written by the sink thread only
+struct sink_stats {
+    uint64_t frames;
+    uint64_t first_ns;
+    uint64_t last_ns;
+    std::vector<uint64_t> lat;
+};
+
+static const struct {
+    const char *name;
+    dlt_msg_log_lvl lvl;
+} level_names[] = {
+    {"verbose", DLT_MSG_LOG_LVL_VERBOSE},
+    {"info", DLT_MSG_LOG_LVL_INFO},
+    {"warning", DLT_MSG_LOG_LVL_WARNING},
+    {"error", DLT_MSG_LOG_LVL_ERROR},
+    {"fatal", DLT_MSG_LOG_LVL_FATAL},
+};
+
+/**
+ * @brief parse a level mix such as "info:70,warning:20,error:10"
+ */
+static int parse_levels(const char *mix, std::vector<dlt_msg_log_lvl> &levels)
+{
+    std::string str = mix;
+    size_t off = 0;
+
+    levels.clear();
+    while (off < str.length()) {
+        size_t end = str.find(',', off);
+        std::string item = str.substr(off, end == std::string::npos ? std::string::npos : end - off);
+        size_t colon = item.find(':');
+        std::string name = item.substr(0, colon);
+        int weight = colon == std::string::npos ? 1 : atoi(item.c_str() + colon + 1);
+        bool found = false;
+
+        for (auto &l : level_names) {
+            if (name == l.name) {
+                levels.insert(levels.end(), std::max(weight, 0), l.lvl);
+                found = true;
+            }
+        }
+        if (!found) {
+            return -1;
+        }
+        off = end == std::string::npos ? str.length() : end + 1;
+    }
+
+    return levels.empty() ? -1 : 0;
+}
+
+// stands in for the storage server, counts the DLT frames of each
+// datagram, packed or compressed, and the latency of every frame
+static void sink_thread(int sock, std::atomic<bool> *stop, sink_stats *stats)
+{
+    dlt_decoder decoder;
+    uint8_t buf[65536];
+    struct timeval tv = {0, 100000};
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!*stop) {
+        int ret = recv(sock, buf, sizeof(buf), 0);
+        if (ret <= 0) {
+            continue;
+        }
+
+        uint64_t rx_ns = now_ns();
+        dlt_msg_view msg;
+
+        stats->last_ns = rx_ns;
+        if (stats->first_ns == 0) {
+            stats->first_ns = rx_ns;
+        }
+
+        decoder.feed(buf, ret);
+        while (decoder.next(msg) == 1) {
+            const uint8_t *ts;
+
+            stats->frames ++;
+            ts = (const uint8_t *)memmem(msg.payload, msg.payload_len,
+                                         BENCH_TS_MARKER, strlen(BENCH_TS_MARKER));
+            if (ts) {
+                stats->lat.push_back(rx_ns - strtoull((const char *)ts + strlen(BENCH_TS_MARKER), nullptr, 10));
+            }
+        }
+    }
+}
+
+/**
+ * @brief four character id, n is at most BENCH_IDS_MAX
+ */
+static std::string bench_id(char prefix, unsigned int n)
+{
+    char id[5];
+
+    snprintf(id, sizeof(id), "%c%03u", prefix, n % (BENCH_IDS_MAX + 1));
+
+    return id;
+}
+
+/**
+ * @brief one client process, each thread logs at the configured rate
+ *
+ * @return returns messages sent
+ */
+static uint64_t run_client(int proc, const bench_config &conf)
+{
+    dlt_lib *log;
+    std::vector<std::thread> threads;
+    std::vector<std::string> app_ids;
+    std::vector<std::string> ctx_ids;
+    std::atomic<uint64_t> sent(0);
+    std::string padding;
+    std::string session_id;
+    int fixed_len;
+
+    session_id = bench_id('s', proc);
+    for (int i = 0; i < conf.apps; i ++) {
+        app_ids.push_back(bench_id('a', i));
+    }
+    for (int i = 0; i < conf.contexts; i ++) {
+        ctx_ids.push_back(bench_id('c', i));
+    }
+
+    // "ts=<19 digits> <seq> " ahead of the padding
+    fixed_len = strlen(BENCH_TS_MARKER) + 19 + 1 + 10 + 1;
+    padding.assign(std::max(conf.payload_size - fixed_len, 0), 'x');
+
+    log = dlt_lib::instance();
+    log->connect(DLT_SERVER_ADDRESS, (uint8_t *)(session_id.c_str()));
+    if ((conf.async_kb > 0) &&
+        (log->enable_async(conf.async_kb * 1024, dlt_async_overflow::BLOCK) < 0)) {
+        fprintf(stderr, "client %d failed to enable async logging\n", proc);
+    }
+
+    uint64_t end_ns = now_ns() + conf.duration_s * 1000000000ULL;
+
+    for (int t = 0; t < conf.threads; t ++) {
+        threads.emplace_back([&, t]() {
+            uint64_t interval_ns = conf.rate > 0 ? 1000000000ULL / conf.rate : 0;
+            uint64_t next_ns = now_ns();
+            int seq = proc * conf.threads + t;
+            int i;
+
+            for (i = 0; (conf.count == 0) || (i < conf.count); i ++) {
+                uint64_t ts = now_ns();
+
+                if (ts >= end_ns) {
+                    break;
+                }
+                if (interval_ns > 0) {
+                    if (next_ns > ts) {
+                        struct timespec sleep_ts = {(time_t)(next_ns / 1000000000ULL),
+                                                    (long)(next_ns % 1000000000ULL)};
+
+                        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &sleep_ts, nullptr);
+                        ts = now_ns();
+                    }
+                    next_ns += interval_ns;
+                }
+
+                // spread the sources over the app and context ids
+                const std::string &app_id = app_ids[(seq + i) % app_ids.size()];
+                const std::string &ctx_id = ctx_ids[(seq + i / app_ids.size()) % ctx_ids.size()];
+                const char *fmt = BENCH_TS_MARKER "%019lu %010d %s";
+
+                switch (conf.levels[i % conf.levels.size()]) {
+                    case DLT_MSG_LOG_LVL_VERBOSE:
+                        log->verbose(app_id, ctx_id, fmt, (unsigned long)ts, i, padding.c_str());
+                    break;
+                    case DLT_MSG_LOG_LVL_WARNING:
+                        log->warning(app_id, ctx_id, fmt, (unsigned long)ts, i, padding.c_str());
+                    break;
+                    case DLT_MSG_LOG_LVL_ERROR:
+                        log->error(app_id, ctx_id, fmt, (unsigned long)ts, i, padding.c_str());
+                    break;
+                    case DLT_MSG_LOG_LVL_FATAL:
+                        log->fatal(app_id, ctx_id, fmt, (unsigned long)ts, i, padding.c_str());
+                    break;
+                    default:
+                        log->info(app_id, ctx_id, fmt, (unsigned long)ts, i, padding.c_str());
+                    break;
+                }
+            }
+            sent.fetch_add(i, std::memory_order_relaxed);
+        });
+    }
+    for (auto &thr : threads) {
+        thr.join();
+    }
+    if ((conf.async_kb > 0) && (proc == 0)) {
+        fprintf(stdout, "client wire version %d\n", log->get_wire_version());
+        fflush(stdout);
+    }
+    log->disconnect();
+
+    return sent.load();
+}
+
+/**
+ * @brief start dlt_service and give it time to create its sockets
+ *
+ * @return returns pid of the service or -1 on failure
+ */
+static pid_t spawn_service(const std::string &service, const std::string &config)
+{
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        int fd = open("/dev/null", O_WRONLY);
+
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        execl(service.c_str(), service.c_str(), "-f", config.c_str(), (char *)nullptr);
+        _exit(127);
+    }
+    if (pid < 0) {
+        return -1;
+    }
+
+    usleep(500000);
+    if (waitpid(pid, nullptr, WNOHANG) != 0) {
+        return -1;
+    }
+
+    return pid;
+}
+
+/**
+ * @brief cpu time used by a process so far, user and system
+ */
+static uint64_t process_cpu_ns(pid_t pid)
+{
+    char path[64];
+    char stat[1024];
+    unsigned long utime;
+    unsigned long stime;
+    char *p;
+    int fd;
+    int len;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    len = read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+    if (len <= 0) {
+        return 0;
+    }
+    stat[len] = '\0';
+
+    // the command name may contain spaces, fields continue after its ')'
+    p = strrchr(stat, ')');
+    if (!p || (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                      &utime, &stime) != 2)) {
+        return 0;
+    }
+
+    return (utime + stime) * (1000000000ULL / sysconf(_SC_CLK_TCK));
+}
+
+static uint64_t children_cpu_ns()
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_CHILDREN, &ru);
+
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-c client processes, at most 64] [-t threads per client] [-r messages per sec per thread, 0 unlimited]\n"
+                    "    [-d duration s] [-n messages per thread, 0 unlimited] [-s payload size]\n"
+                    "    [-l level mix, e.g. info:70,warning:20,error:10] [-A app ids, at most 999] [-C context ids, at most 999]\n"
+                    "    [-p sink port] [-S dlt_service to start] [-f its configuration] [-P pid of a running dlt_service]\n"
+                    "    [-a async ring size KB, 0 synchronous]\n",
+                    progname);
+}
+
+int main(int argc, char **argv)
+{
+    bench_config conf;
+    sink_stats stats;
+    std::atomic<bool> stop(false);
+    std::string service;
+    std::string config = "../src/bench/dlt_bench_config.json";
+    struct sockaddr_in addr;
+    uint64_t *sent_by_client;
+    pid_t service_pid = -1;
+    bool spawned = false;
+    int port = 2225;
+    int sock;
+    int ret;
+
+    conf.clients = 1;
+    conf.threads = 1;
+    conf.rate = 0;
+    conf.duration_s = 5;
+    conf.count = 0;
+    conf.payload_size = 60;
+    conf.apps = 1;
+    conf.contexts = 1;
+    conf.async_kb = 0;
+    parse_levels("info", conf.levels);
+
+    while ((ret = getopt(argc, argv, "c:t:r:d:n:s:l:A:C:p:S:f:P:a:")) != -1) {
+        switch (ret) {
+            case 'c':
+                conf.clients = std::min(std::max(1, atoi(optarg)), BENCH_CLIENTS_MAX);
+            break;
+            case 't':
+                conf.threads = std::max(1, atoi(optarg));
+            break;
+            case 'r':
+                conf.rate = atoi(optarg);
+            break;
+            case 'd':
+                conf.duration_s = atoi(optarg);
+            break;
+            case 'n':
+                conf.count = atoi(optarg);
+            break;
+            case 's':
+                conf.payload_size = std::min(atoi(optarg), DLT_MSG_MAX_LEN - 64);
+            break;
+            case 'l':
+                if (parse_levels(optarg, conf.levels) < 0) {
+                    fprintf(stderr, "invalid level mix [%s]\n", optarg);
+                    return -1;
+                }
+            break;
+            case 'A':
+                conf.apps = std::min(std::max(1, atoi(optarg)), BENCH_IDS_MAX);
+            break;
+            case 'C':
+                conf.contexts = std::min(std::max(1, atoi(optarg)), BENCH_IDS_MAX);
+            break;
+            case 'p':
+                port = atoi(optarg);
+            break;
+            case 'S':
+                service = optarg;
+            break;
+            case 'f':
+                config = optarg;
+            break;
+            case 'P':
+                service_pid = atoi(optarg);
+            break;
+            case 'a':
+                conf.async_kb = std::max(0, atoi(optarg));
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    // the sink is bound before the service starts forwarding to it
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "failed to bind sink port %d\n", port);
+        return -1;
+    }
+
+    if (!service.empty()) {
+        service_pid = spawn_service(service, config);
+        if (service_pid < 0) {
+            fprintf(stderr, "failed to start [%s -f %s]\n", service.c_str(), config.c_str());
+            return -1;
+        }
+        spawned = true;
+    }
+
+    stats.frames = 0;
+    stats.first_ns = 0;
+    stats.last_ns = 0;
+    if (conf.rate > 0) {
+        stats.lat.reserve((size_t)conf.rate * conf.threads * conf.clients * conf.duration_s);
+    }
+    std::thread sink(sink_thread, sock, &stop, &stats);
+
+    // each client reports how many messages it sent
+    sent_by_client = (uint64_t *)mmap(nullptr, sizeof(uint64_t) * BENCH_CLIENTS_MAX,
+                                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sent_by_client == MAP_FAILED) {
+        return -1;
+    }
+    memset(sent_by_client, 0, sizeof(uint64_t) * BENCH_CLIENTS_MAX);
+
+    uint64_t service_cpu_start = service_pid > 0 ? process_cpu_ns(service_pid) : 0;
+    uint64_t clients_cpu_start = children_cpu_ns();
+    uint64_t start_ns = now_ns();
+
+    // every client process has its own connection and session id
+    for (int c = 0; c < conf.clients; c ++) {
+        if (fork() == 0) {
+            sent_by_client[c] = run_client(c, conf);
+            _exit(0);
+        }
+    }
+    for (int c = 0; c < conf.clients; c ++) {
+        wait(nullptr);
+    }
+
+    uint64_t send_ns = now_ns() - start_ns;
+    uint64_t clients_cpu = children_cpu_ns() - clients_cpu_start;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_DRAIN_MS));
+    stop = true;
+    sink.join();
+    close(sock);
+
+    uint64_t service_cpu = service_pid > 0 ? process_cpu_ns(service_pid) - service_cpu_start : 0;
+    uint64_t sent = 0;
+
+    if (spawned) {
+        kill(service_pid, SIGTERM);
+        waitpid(service_pid, nullptr, 0);
+    }
+
+    for (int c = 0; c < conf.clients; c ++) {
+        sent += sent_by_client[c];
+    }
+    munmap(sent_by_client, sizeof(uint64_t) * BENCH_CLIENTS_MAX);
+
+    if ((sent == 0) || (stats.frames == 0)) {
+        fprintf(stderr, "sent %lu, no frames received on port %d\n", sent, port);
+        return -1;
+    }
+
+    double fwd_sec = (stats.last_ns - start_ns) / 1e9;
+
+    fprintf(stdout, "clients %d x %d threads, rate %s, payload %d, %zu levels, %d apps, %d contexts\n",
+                    conf.clients, conf.threads,
+                    conf.rate > 0 ? (std::to_string(conf.rate) + "/s per thread").c_str() : "unlimited",
+                    conf.payload_size, conf.levels.size(), conf.apps, conf.contexts);
+    fprintf(stdout, "sent      %10lu in %.3f s (%.0f msgs/sec)\n", sent, send_ns / 1e9, sent / (send_ns / 1e9));
+    fprintf(stdout, "forwarded %10lu in %.3f s (%.0f msgs/sec) loss %.2f%%\n",
+                    stats.frames, fwd_sec, stats.frames / fwd_sec,
+                    sent > stats.frames ? 100.0 * (sent - stats.frames) / sent : 0.0);
+    fprintf(stdout, "cpu       clients %.0f ns/msg", (double)clients_cpu / sent);
+    if (service_pid > 0) {
+        fprintf(stdout, " dlt_service %.0f ns/msg", (double)service_cpu / stats.frames);
+    }
+    fprintf(stdout, "\n");
+
+    if (!stats.lat.empty()) {
+        auto &lat = stats.lat;
+
+        std::sort(lat.begin(), lat.end());
+        fprintf(stdout, "latency   p50 %.1f us p90 %.1f us p99 %.1f us p99.9 %.1f us max %.1f us\n",
+                        lat[lat.size() / 2] / 1000.0,
+                        lat[(lat.size() * 90) / 100] / 1000.0,
+                        lat[(lat.size() * 99) / 100] / 1000.0,
+                        lat[(lat.size() * 999) / 1000] / 1000.0,
+                        lat.back() / 1000.0);
+    }
+
+    return 0;
+}
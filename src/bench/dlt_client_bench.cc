@@ -0,0 +1,163 @@
+/**
+ * @file dlt_client_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief ns per call of the dlt_lib logging calls against a local receiver
+ * @version 0.1
+ * @date 2022-01-04
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <dlt_lib.hpp>
+
+using namespace auto_os::middleware;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// stands in for dlt_service, only drains the socket so sends never block
+// on a full receive queue for long
+static void receiver_thread(int sock, std::atomic<bool> *stop, std::atomic<uint64_t> *received)
+{
+    struct mmsghdr msgs[64];
+    struct iovec iovs[64];
+    static uint8_t bufs[64][DLT_MSG_MAX_LEN];
+    struct timeval tv = {0, 100000};
+
+    for (int i = 0; i < 64; i ++) {
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len = sizeof(bufs[i]);
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // the recvmmsg timeout is only checked after a datagram arrived
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!*stop) {
+        int ret = recvmmsg(sock, msgs, 64, MSG_WAITFORONE, nullptr);
+
+        if (ret > 0) {
+            received->fetch_add(ret, std::memory_order_relaxed);
+        }
+    }
+}
+
+static void report(const char *name, int count, uint64_t ns)
+{
+    fprintf(stdout, "%-28s %8.1f ns/call %10.0f calls/sec\n", name, (double)ns / count, count / (ns / 1e9));
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n calls per case] [-s payload size] [-a receiver socket path]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = "/tmp/dlt_client_bench.sock";
+    std::string app_id = "bnch";
+    std::string ctx_id = "clnt";
+    std::atomic<uint64_t> received(0);
+    std::atomic<bool> stop(false);
+    struct sockaddr_un addr;
+    dlt_lib *log;
+    int payload_size = 60;
+    int count = 200000;
+    int sock;
+    int ret;
+    int i;
+
+    while ((ret = getopt(argc, argv, "n:s:a:")) != -1) {
+        switch (ret) {
+            case 'n':
+                count = atoi(optarg);
+            break;
+            case 's':
+                payload_size = std::min(atoi(optarg), DLT_MSG_MAX_LEN - 64);
+            break;
+            case 'a':
+                path = optarg;
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(addr.sun_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "failed to bind [%s]\n", path.c_str());
+        return -1;
+    }
+
+    std::thread receiver(receiver_thread, sock, &stop, &received);
+    std::string payload(payload_size, 'x');
+    uint64_t start;
+
+    log = dlt_lib::instance();
+    log->connect(path, (uint8_t *)"sess");
+
+    fprintf(stdout, "payload %d bytes, %d calls per case\n", payload_size, count);
+
+    // printf style string, one datagram per call
+    start = now_ns();
+    for (i = 0; i < count; i ++) {
+        log->info(app_id, ctx_id, "%s %d", payload.c_str(), i);
+    }
+    report("info (string)", count, now_ns() - start);
+
+    // typed verbose arguments, no formatting
+    start = now_ns();
+    for (i = 0; i < count; i ++) {
+        log->log(DLT_MSG_LOG_LVL_INFO, app_id, ctx_id, payload.c_str(), i, 3.5, true);
+    }
+    report("log (typed args)", count, now_ns() - start);
+
+    // non verbose, message id and raw values only
+    start = now_ns();
+    for (i = 0; i < count; i ++) {
+        DLT_LOG_NV(DLT_MSG_LOG_LVL_INFO, app_id, ctx_id, "client bench %s %d", payload.c_str(), i);
+    }
+    report("DLT_LOG_NV (non verbose)", count, now_ns() - start);
+
+    // asynchronous, the call only appends to the ring of the thread
+    log->enable_async(4 * 1024 * 1024, dlt_async_overflow::BLOCK);
+    start = now_ns();
+    for (i = 0; i < count; i ++) {
+        log->info(app_id, ctx_id, "%s %d", payload.c_str(), i);
+    }
+    report("info (async)", count, now_ns() - start);
+
+    log->disconnect();
+
+    // the receiver gets whatever is still queued
+    usleep(200000);
+    stop = true;
+    receiver.join();
+    close(sock);
+    unlink(path.c_str());
+
+    fprintf(stdout, "received %lu of %d messages\n", received.load(), count * 4);
+
+    return 0;
+}
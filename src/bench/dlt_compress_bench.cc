@@ -0,0 +1,244 @@
+/**
+ * @file dlt_compress_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief compression ratio and MB/s of dlt_block for several block sizes
+ * @version 0.1
+ * @date 2021-12-30
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <auto_lib.h>
+#include <dlt_enc_dec.h>
+#include <dlt_compress.h>
+
+using namespace auto_os::middleware;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the messages sent by dlt_test, at their levels
+static const struct {
+    dlt_extended_header_msg_type_info_log lvl;
+    const char *str;
+} test_msgs[] = {
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_VERBOSE, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_ERROR, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_FATAL, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO, "typed dlt message 42 -7 3.5 true\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO, "non verbose dlt message 42 str 3.50\n"},
+};
+
+/**
+ * @brief frames with storage headers as dlt_service stores the output of
+ *        dlt_test run in a loop
+ */
+static void make_corpus(int count, std::vector<uint8_t> &corpus, std::vector<size_t> &frames)
+{
+    uint8_t session_id[4] = {'s', 'e', 's', 's'};
+    uint8_t app_id[4] = {'a', 'p', 'p', '1'};
+    uint8_t ctx_id[4] = {'c', 't', 'x', '1'};
+    uint8_t msg_info[sizeof(test_msgs) / sizeof(test_msgs[0])];
+    dlt_header_template tmpl;
+    dlt_header hdr;
+    uint8_t buf[4096];
+    uint32_t timestamp = 0;
+    uint32_t sec = 1640995200;
+    int32_t usec = 0;
+
+    hdr.set_msg_type_info(dlt_msg_typeinfo::DLT_MSG_TYPEINFO_STRG);
+    hdr.std_hdr.set_use_ext_hdr();
+    hdr.std_hdr.set_valid_ecu_id();
+    hdr.std_hdr.set_ecu_id("ecu1");
+    hdr.std_hdr.set_valid_session_id();
+    hdr.std_hdr.set_version(1);
+    hdr.std_hdr.set_session_id(session_id);
+    hdr.ext_hdr.set_verbose();
+    hdr.ext_hdr.set_msg_type(dlt_extended_header_msg_type::eDLT_TYPE_LOG);
+    hdr.ext_hdr.set_app_id(app_id);
+    hdr.ext_hdr.set_context_id(ctx_id);
+    tmpl.init(hdr);
+
+    for (size_t i = 0; i < sizeof(test_msgs) / sizeof(test_msgs[0]); i ++) {
+        // set_msg_type_info_log ors into the info bits
+        hdr.ext_hdr.message_info &= 0x0f;
+        hdr.ext_hdr.set_msg_type_info_log(test_msgs[i].lvl);
+        msg_info[i] = hdr.ext_hdr.message_info;
+    }
+
+    srand(1);
+    for (int i = 0; i < count; i ++) {
+        int idx = i % (sizeof(test_msgs) / sizeof(test_msgs[0]));
+        int len = strlen(test_msgs[idx].str);
+        uint8_t *payload = buf + DLT_STORAGE_HDR_LEN + tmpl.hdr_len;
+        uint8_t *msg;
+
+        // a few hundred microseconds between messages
+        usec += rand() % 500;
+        if (usec >= 1000000) {
+            usec -= 1000000;
+            sec ++;
+        }
+        timestamp += rand() % 5;
+
+        memcpy(payload, test_msgs[idx].str, len);
+        msg = tmpl.encode(payload, len, i & 0xff, session_id, timestamp,
+                          msg_info[idx], app_id, ctx_id);
+
+        memcpy(buf, DLT_STORAGE_HDR_PATTERN, DLT_STORAGE_HDR_PATTERN_LEN);
+        memcpy(buf + 4, &sec, sizeof(sec));
+        memcpy(buf + 8, &usec, sizeof(usec));
+        memcpy(buf + 12, "ecu1", 4);
+
+        frames.push_back(corpus.size());
+        corpus.insert(corpus.end(), buf, buf + DLT_STORAGE_HDR_LEN);
+        corpus.insert(corpus.end(), msg, msg + tmpl.hdr_len + len + 1);
+    }
+}
+
+// frames of a .dlt file, for example dlt_service storage
+static int load_corpus(const std::string &file, std::vector<uint8_t> &corpus, std::vector<size_t> &frames)
+{
+    std::ifstream in(file, std::ifstream::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t off = 0;
+    dlt_msg_view msg;
+    size_t need;
+    int ret;
+
+    if (!in.good() && !in.eof()) {
+        return -1;
+    }
+
+    while ((ret = dlt_decoder::parse(data.data() + off, data.size() - off, true, msg, need)) > 0) {
+        frames.push_back(corpus.size());
+        corpus.insert(corpus.end(), data.begin() + off, data.begin() + off + ret);
+        off += ret;
+    }
+
+    return frames.empty() ? -1 : 0;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n messages] [-f corpus .dlt file] [-b block size bytes (repeatable)]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<size_t> block_sizes;
+    std::vector<uint8_t> corpus;
+    std::vector<size_t> frames;
+    std::string corpus_file;
+    int count = 200000;
+    int ret;
+
+    while ((ret = getopt(argc, argv, "n:f:b:")) != -1) {
+        switch (ret) {
+            case 'n':
+                count = atoi(optarg);
+            break;
+            case 'f':
+                corpus_file = optarg;
+            break;
+            case 'b':
+                block_sizes.push_back(atoi(optarg));
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (block_sizes.empty()) {
+        block_sizes = {1024, 4096, 16384, 65536, 262144};
+    }
+
+    if (!corpus_file.empty()) {
+        if (load_corpus(corpus_file, corpus, frames) < 0) {
+            fprintf(stderr, "no dlt frames in %s\n", corpus_file.c_str());
+            return -1;
+        }
+    } else {
+        make_corpus(count, corpus, frames);
+    }
+    frames.push_back(corpus.size());
+
+    fprintf(stdout, "corpus %zu frames %zu bytes\n", frames.size() - 1, corpus.size());
+
+    for (auto block_size : block_sizes) {
+        std::vector<std::pair<size_t, size_t>> blocks;
+        std::vector<uint8_t> out(dlt_block::bound(std::max(block_size, corpus.size())));
+        std::vector<uint8_t> raw(std::max(block_size, (size_t)65536));
+        std::vector<size_t> enc_off;
+        size_t enc_len = 0;
+        uint64_t comp_ns;
+        uint64_t decomp_ns;
+        int rounds = 0;
+        size_t start = 0;
+        bool ok = true;
+
+        // whole frames per block, like the storage blocks and datagrams
+        for (size_t i = 1; i < frames.size(); i ++) {
+            if ((frames[i] - start > block_size) && (frames[i - 1] > start)) {
+                blocks.push_back({start, frames[i - 1] - start});
+                start = frames[i - 1];
+            }
+        }
+        blocks.push_back({start, corpus.size() - start});
+
+        uint64_t begin = now_ns();
+        do {
+            enc_len = 0;
+            enc_off.clear();
+            for (auto &b : blocks) {
+                enc_off.push_back(enc_len);
+                enc_len += dlt_block::encode(corpus.data() + b.first, b.second, true,
+                                             out.data() + enc_len, out.size() - enc_len);
+            }
+            rounds ++;
+        } while (now_ns() - begin < 200000000ULL);
+        comp_ns = (now_ns() - begin) / rounds;
+
+        rounds = 0;
+        begin = now_ns();
+        do {
+            for (size_t i = 0; i < blocks.size(); i ++) {
+                dlt_block_hdr hdr;
+                size_t need;
+
+                if (raw.size() < blocks[i].second) {
+                    raw.resize(blocks[i].second);
+                }
+                if ((dlt_block::parse(out.data() + enc_off[i], enc_len - enc_off[i], hdr, need) <= 0) ||
+                    (dlt_block::decode(out.data() + enc_off[i], hdr, raw.data()) != (int)blocks[i].second) ||
+                    ((rounds == 0) && (memcmp(raw.data(), corpus.data() + blocks[i].first, blocks[i].second) != 0))) {
+                    ok = false;
+                }
+            }
+            rounds ++;
+        } while (now_ns() - begin < 200000000ULL);
+        decomp_ns = (now_ns() - begin) / rounds;
+
+        fprintf(stdout, "block %7zu  ratio %5.2f  compress %7.1f MB/s  decompress %7.1f MB/s%s\n",
+                        block_size, (double)corpus.size() / enc_len,
+                        corpus.size() / (comp_ns / 1e9) / 1e6,
+                        corpus.size() / (decomp_ns / 1e9) / 1e6,
+                        ok ? "" : "  ROUND TRIP FAILED");
+    }
+
+    return 0;
+}
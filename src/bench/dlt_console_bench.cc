@@ -0,0 +1,295 @@
+/**
+ * @file dlt_console_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief console lines per second of fprintf per message against dlt_console_formatter
+ * @version 0.1
+ * @date 2022-01-02
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <dlt_enc_dec.h>
+#include <dlt_console_format.h>
+
+using namespace auto_os::middleware;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the messages sent by dlt_test, at their levels
+static const struct {
+    dlt_extended_header_msg_type_info_log lvl;
+    const char *str;
+} test_msgs[] = {
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_VERBOSE, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_ERROR, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_FATAL, "testing dlt message\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO, "typed dlt message 42 -7 3.5 true\n"},
+    {dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO, "non verbose dlt message 42 str 3.50\n"},
+};
+
+/**
+ * @brief string messages encoded as dlt_service encodes them, back to back
+ */
+static void make_corpus(int count, int payload_size, std::vector<uint8_t> &corpus, std::vector<size_t> &frames)
+{
+    uint8_t session_id[4] = {'s', 'e', 's', 's'};
+    uint8_t app_id[4] = {'a', 'p', 'p', '1'};
+    uint8_t ctx_id[4] = {'c', 't', 'x', '1'};
+    uint8_t msg_info[sizeof(test_msgs) / sizeof(test_msgs[0])];
+    std::string payload(payload_size > 0 ? payload_size - 1 : 0, 'x');
+    dlt_header_template tmpl;
+    dlt_header hdr;
+    uint8_t buf[4096];
+
+    payload += "\n";
+
+    hdr.set_msg_type_info(dlt_msg_typeinfo::DLT_MSG_TYPEINFO_STRG);
+    hdr.std_hdr.set_use_ext_hdr();
+    hdr.std_hdr.set_valid_ecu_id();
+    hdr.std_hdr.set_ecu_id("ecu1");
+    hdr.std_hdr.set_valid_session_id();
+    hdr.std_hdr.set_version(1);
+    hdr.std_hdr.set_session_id(session_id);
+    hdr.ext_hdr.set_verbose();
+    hdr.ext_hdr.set_msg_type(dlt_extended_header_msg_type::eDLT_TYPE_LOG);
+    hdr.ext_hdr.set_app_id(app_id);
+    hdr.ext_hdr.set_context_id(ctx_id);
+    tmpl.init(hdr);
+
+    for (size_t i = 0; i < sizeof(test_msgs) / sizeof(test_msgs[0]); i ++) {
+        // set_msg_type_info_log ors into the info bits
+        hdr.ext_hdr.message_info &= 0x0f;
+        hdr.ext_hdr.set_msg_type_info_log(test_msgs[i].lvl);
+        msg_info[i] = hdr.ext_hdr.message_info;
+    }
+
+    for (int i = 0; i < count; i ++) {
+        int idx = i % (sizeof(test_msgs) / sizeof(test_msgs[0]));
+        const char *str = payload_size > 0 ? payload.c_str() : test_msgs[idx].str;
+        int len = strlen(str);
+        uint8_t *msg;
+
+        memcpy(buf + tmpl.hdr_len, str, len);
+        msg = tmpl.encode(buf + tmpl.hdr_len, len, i & 0xff, session_id, i,
+                          msg_info[idx], app_id, ctx_id);
+
+        frames.push_back(corpus.size());
+        corpus.insert(corpus.end(), msg, msg + tmpl.hdr_len + len + 1);
+    }
+    frames.push_back(corpus.size());
+}
+
+/**
+ * @brief the console output of dlt_service before dlt_console_formatter
+ */
+static void log_console_fprintf(FILE *out,
+                                uint8_t loglvl,
+                                const uint8_t *ecuid,
+                                uint16_t msg_count,
+                                const uint8_t *app_id,
+                                const uint8_t *ctx_id,
+                                const char *str,
+                                int str_len)
+{
+    char msg[4096];
+    std::string log_level;
+
+    // copy the string and null terminate
+    strncpy(msg, str, str_len);
+    msg[str_len] = '\0';
+
+    switch (loglvl) {
+        case 4:
+            log_level = "info";
+        break;
+        case 3:
+            log_level = "warning";
+        break;
+        case 6:
+            log_level = "verbose";
+        break;
+        case 2:
+            log_level = "error";
+        break;
+        case 1:
+            log_level = "fatal";
+        break;
+        default:
+            log_level = "unknown";
+        break;
+    }
+
+    fprintf(out, "[%c%c%c%c] [%d] [%c%c%c%c][%c%c%c%c] [%s] %s",
+                 ecuid[0], ecuid[1], ecuid[2], ecuid[3],
+                 msg_count,
+                 app_id[0], app_id[1], app_id[2], app_id[3],
+                 ctx_id[0], ctx_id[1], ctx_id[2], ctx_id[3],
+                 log_level.c_str(),
+                 msg);
+}
+
+// fields the old path had at hand from the received message
+struct legacy_msg {
+    dlt_msg_view view;
+    const char *str;
+    int str_len;
+};
+
+static uint64_t run_fprintf(FILE *out, std::vector<legacy_msg> &msgs)
+{
+    uint64_t begin = now_ns();
+
+    for (auto &m : msgs) {
+        log_console_fprintf(out, m.view.get_msg_type_info(), m.view.ecu_id, m.view.msg_counter,
+                            m.view.app_id, m.view.ctx_id, m.str, m.str_len);
+    }
+
+    return now_ns() - begin;
+}
+
+static uint64_t run_formatter(dlt_console_formatter &fmt, std::vector<uint8_t> &corpus,
+                              std::vector<size_t> &frames, int batch)
+{
+    uint64_t begin = now_ns();
+
+    // the console sink flushes once per drained batch
+    for (size_t i = 0; i + 1 < frames.size(); i ++) {
+        fmt.format(corpus.data() + frames[i], frames[i + 1] - frames[i]);
+        if ((i + 1) % batch == 0) {
+            fmt.flush();
+        }
+    }
+    fmt.flush();
+
+    return now_ns() - begin;
+}
+
+static std::string read_file(int fd)
+{
+    std::string data;
+    char buf[65536];
+    int ret;
+
+    lseek(fd, 0, SEEK_SET);
+    while ((ret = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, ret);
+    }
+
+    return data;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n messages] [-s payload size, 0 for the dlt_test messages] [-b messages per flush] [-o output file]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<legacy_msg> msgs;
+    std::vector<uint8_t> corpus;
+    std::vector<size_t> frames;
+    std::string output = "/dev/null";
+    uint8_t ecu_id[4] = {'e', 'c', 'u', '1'};
+    int payload_size = 0;
+    int count = 200000;
+    int batch = 1000;
+    int ret;
+
+    while ((ret = getopt(argc, argv, "n:s:b:o:")) != -1) {
+        switch (ret) {
+            case 'n':
+                count = atoi(optarg);
+            break;
+            case 's':
+                payload_size = std::min(atoi(optarg), 2048);
+            break;
+            case 'b':
+                batch = std::max(1, atoi(optarg));
+            break;
+            case 'o':
+                output = optarg;
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    make_corpus(count, payload_size, corpus, frames);
+    for (size_t i = 0; i + 1 < frames.size(); i ++) {
+        legacy_msg m;
+        size_t need;
+
+        dlt_decoder::parse(corpus.data() + frames[i], frames[i + 1] - frames[i], false, m.view, need);
+        // the string argument after its type info and length
+        m.str = (const char *)m.view.payload + 6;
+        m.str_len = m.view.payload_len - 7;
+        msgs.push_back(m);
+    }
+
+    // same lines from both, checked on a temporary file
+    {
+        char path[] = "/tmp/dlt_console_benchXXXXXX";
+        int fd = mkstemp(path);
+        std::vector<legacy_msg> check(msgs.begin(), msgs.begin() + std::min((size_t)1000, msgs.size()));
+        std::vector<size_t> check_frames(frames.begin(), frames.begin() + check.size() + 1);
+        FILE *out = fdopen(dup(fd), "w");
+        std::string old_lines;
+
+        unlink(path);
+        setvbuf(out, nullptr, _IONBF, 0);
+        run_fprintf(out, check);
+        fclose(out);
+        old_lines = read_file(fd);
+        ftruncate(fd, 0);
+        lseek(fd, 0, SEEK_SET);
+
+        dlt_console_formatter fmt(fd, ecu_id, nullptr);
+
+        run_formatter(fmt, corpus, check_frames, batch);
+        fprintf(stdout, "output %s\n", old_lines == read_file(fd) ? "identical" : "DIFFERS");
+        close(fd);
+    }
+
+    int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "failed to open %s\n", output.c_str());
+        return -1;
+    }
+
+    // stderr is unbuffered, one write per line
+    FILE *out = fdopen(dup(fd), "w");
+    setvbuf(out, nullptr, _IONBF, 0);
+    uint64_t fprintf_ns = run_fprintf(out, msgs);
+    fclose(out);
+
+    dlt_console_formatter fmt(fd, ecu_id, nullptr);
+    uint64_t fmt_ns = run_formatter(fmt, corpus, frames, batch);
+    close(fd);
+
+    fprintf(stdout, "messages %d payload %s\n", count,
+                    payload_size > 0 ? std::to_string(payload_size).c_str() : "dlt_test");
+    fprintf(stdout, "fprintf    %7.1f ns/msg %10.0f msgs/sec %8d writes\n",
+                    (double)fprintf_ns / count, count / (fprintf_ns / 1e9), count);
+    fprintf(stdout, "formatter  %7.1f ns/msg %10.0f msgs/sec %8lu writes\n",
+                    (double)fmt_ns / count, count / (fmt_ns / 1e9), fmt.get_writes());
+    fprintf(stdout, "speedup    %.2fx\n", (double)fprintf_ns / fmt_ns);
+
+    return 0;
+}
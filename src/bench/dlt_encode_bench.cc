@@ -0,0 +1,171 @@
+/**
+ * @file dlt_encode_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief measures dlt header encode time per message
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <auto_lib.h>
+#include <dlt_enc_dec.h>
+
+using namespace auto_os::middleware;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// same header setup as dlt_service
+static void setup_header(dlt_header &hdr)
+{
+    uint8_t session_id[4] = {'s', 'e', 's', 's'};
+    uint8_t app_id[4] = {'b', 'n', 'c', 'h'};
+    uint8_t ctx_id[4] = {'e', 'n', 'c', ' '};
+
+    hdr.set_msg_type_info(dlt_msg_typeinfo::DLT_MSG_TYPEINFO_STRG);
+    hdr.std_hdr.set_use_ext_hdr();
+    hdr.std_hdr.set_valid_ecu_id();
+    hdr.std_hdr.set_ecu_id("ecu1");
+    hdr.std_hdr.set_valid_session_id();
+    hdr.std_hdr.set_version(1);
+    hdr.std_hdr.set_session_id(session_id);
+    hdr.ext_hdr.set_verbose();
+    hdr.ext_hdr.set_msg_type(dlt_extended_header_msg_type::eDLT_TYPE_LOG);
+    hdr.ext_hdr.set_msg_type_info_log(dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO);
+    hdr.ext_hdr.set_app_id(app_id);
+    hdr.ext_hdr.set_context_id(ctx_id);
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n iterations] [-s payload size] [-c decode chunk size]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t out[4096];
+    static uint8_t in_place[4096];
+    dlt_header_template tmpl;
+    dlt_header hdr;
+    int iterations = 10000000;
+    int payload_size = 60;
+    int chunk_size = 4096;
+    volatile uint8_t sink = 0;
+    size_t off;
+    int ret;
+    int i;
+
+    while ((ret = getopt(argc, argv, "n:s:c:")) != -1) {
+        switch (ret) {
+            case 'n':
+                iterations = atoi(optarg);
+            break;
+            case 's':
+                payload_size = atoi(optarg);
+            break;
+            case 'c':
+                chunk_size = atoi(optarg);
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (payload_size > (int)sizeof(in_place) - DLT_HDR_MAX_LEN - 1) {
+        fprintf(stderr, "payload size too large\n");
+        return -1;
+    }
+
+    std::string payload(payload_size, 'x');
+    uint8_t *in_place_payload = in_place + DLT_HDR_MAX_LEN;
+
+    setup_header(hdr);
+    tmpl.init(hdr);
+
+    // both paths must produce the same bytes
+    off = 0;
+    int len = hdr.encode((uint8_t *)payload.data(), payload_size, out, sizeof(out), off);
+    memcpy(in_place_payload, payload.data(), payload_size);
+    uint8_t *frame = tmpl.encode(in_place_payload, payload_size, 0,
+                                 hdr.std_hdr.session_id, 0,
+                                 hdr.ext_hdr.message_info,
+                                 hdr.ext_hdr.app_id, hdr.ext_hdr.context_id);
+    if ((len != tmpl.hdr_len + payload_size + 1) || (memcmp(out, frame, len) != 0)) {
+        fprintf(stderr, "template encode does not match dlt_header::encode\n");
+        return -1;
+    }
+
+    uint64_t start = now_ns();
+    for (i = 0; i < iterations; i ++) {
+        off = 0;
+        hdr.std_hdr.set_msg_counter(i);
+        hdr.encode((uint8_t *)payload.data(), payload_size, out, sizeof(out), off);
+        sink += out[1];
+    }
+    uint64_t encode_ns = now_ns() - start;
+
+    start = now_ns();
+    for (i = 0; i < iterations; i ++) {
+        frame = tmpl.encode(in_place_payload, payload_size, i,
+                            hdr.std_hdr.session_id, 0,
+                            hdr.ext_hdr.message_info,
+                            hdr.ext_hdr.app_id, hdr.ext_hdr.context_id);
+        sink += frame[1];
+    }
+    uint64_t tmpl_ns = now_ns() - start;
+
+    // decode a 64 MB stream fed in chunks, so frames are split across feeds
+    std::vector<uint8_t> stream;
+    int n_frames = (64 * 1024 * 1024) / len;
+
+    stream.reserve(n_frames * len);
+    for (i = 0; i < n_frames; i ++) {
+        stream.insert(stream.end(), out, out + len);
+    }
+
+    dlt_decoder dec;
+    dlt_msg_view msg;
+    int decoded = 0;
+
+    start = now_ns();
+    for (size_t pos = 0; pos < stream.size(); pos += chunk_size) {
+        dec.feed(stream.data() + pos, std::min((size_t)chunk_size, stream.size() - pos));
+        while (dec.next(msg) == 1) {
+            dlt_arg_reader args(msg);
+            dlt_arg_view arg;
+
+            while (args.next(arg) == 1) {
+                sink += arg.data[0];
+            }
+            decoded ++;
+        }
+    }
+    uint64_t decode_ns = now_ns() - start;
+
+    if ((decoded != n_frames) || (dec.get_errors() != 0)) {
+        fprintf(stderr, "decoded %d of %d frames, %lu errors\n", decoded, n_frames, dec.get_errors());
+        return -1;
+    }
+
+    fprintf(stdout, "payload %d bytes\n", payload_size);
+    fprintf(stdout, "dlt_header::encode          %.1f ns/msg\n", (double)encode_ns / iterations);
+    fprintf(stdout, "dlt_header_template::encode %.1f ns/msg\n", (double)tmpl_ns / iterations);
+    fprintf(stdout, "dlt_decoder %d byte chunks  %.1f ns/msg %.0f MB/s\n", chunk_size,
+                    (double)decode_ns / n_frames,
+                    (stream.size() / (1024.0 * 1024.0)) / (decode_ns / 1e9));
+
+    return 0;
+}
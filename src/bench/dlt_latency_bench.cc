@@ -0,0 +1,143 @@
+/**
+ * @file dlt_latency_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief measures ingest to forward latency of dlt_service
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <dlt_lib.hpp>
+
+// every message carries its send time as "ts=<nanoseconds>"
+#define BENCH_TS_MARKER "ts="
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// stands in for the storage server and records the latency of every frame
+static void sink_thread(int sock, std::atomic<bool> *stop, std::vector<uint64_t> *lat)
+{
+    uint8_t buf[4096];
+    struct timeval tv = {0, 100000};
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!*stop) {
+        int ret = recv(sock, buf, sizeof(buf) - 1, 0);
+        if (ret <= 0) {
+            continue;
+        }
+
+        uint64_t rx_ns = now_ns();
+        uint8_t *off = buf;
+
+        // a datagram may contain more than one frame
+        while ((off = (uint8_t *)memmem(off, ret - (off - buf), BENCH_TS_MARKER,
+                                        strlen(BENCH_TS_MARKER))) != nullptr) {
+            off += strlen(BENCH_TS_MARKER);
+            lat->push_back(rx_ns - strtoull((char *)off, nullptr, 10));
+        }
+    }
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n messages] [-r messages per sec] [-p sink port]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    auto_os::middleware::dlt_lib *log;
+    std::string session_id = "sess";
+    std::string app_id = "bnch";
+    std::string context_id = "ltcy";
+    std::vector<uint64_t> lat;
+    std::atomic<bool> stop(false);
+    struct sockaddr_in addr;
+    int count = 10000;
+    int rate = 10000;
+    int port = 2225;
+    int sock;
+    int ret;
+
+    while ((ret = getopt(argc, argv, "n:r:p:")) != -1) {
+        switch (ret) {
+            case 'n':
+                count = atoi(optarg);
+            break;
+            case 'r':
+                rate = atoi(optarg);
+            break;
+            case 'p':
+                port = atoi(optarg);
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "failed to bind sink port %d\n", port);
+        return -1;
+    }
+
+    lat.reserve(count);
+    std::thread sink(sink_thread, sock, &stop, &lat);
+
+    log = auto_os::middleware::dlt_lib::instance();
+    log->connect(DLT_SERVER_ADDRESS, (uint8_t *)(session_id.c_str()));
+
+    uint64_t interval_ns = 1000000000ULL / rate;
+    uint64_t next_ns = now_ns();
+
+    for (int i = 0; i < count; i ++) {
+        while (now_ns() < next_ns) { }
+        next_ns += interval_ns;
+
+        log->info(app_id, context_id, BENCH_TS_MARKER "%lu message %d",
+                  (unsigned long)now_ns(), i);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    stop = true;
+    sink.join();
+    close(sock);
+
+    if (lat.empty()) {
+        fprintf(stderr, "no frames received on port %d\n", port);
+        return -1;
+    }
+
+    std::sort(lat.begin(), lat.end());
+    fprintf(stdout, "sent %d received %zu\n", count, lat.size());
+    fprintf(stdout, "p50 %.1f us p99 %.1f us max %.1f us\n",
+                    lat[lat.size() / 2] / 1000.0,
+                    lat[(lat.size() * 99) / 100] / 1000.0,
+                    lat.back() / 1000.0);
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file dlt_storage_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief measures messages per second stored by dlt_file_storage and the
+ *        time of an indexed query against decoding every segment
+ * @version 0.1
+ * @date 2021-12-28
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <auto_lib.h>
+#include <dlt_enc_dec.h>
+#include <dlt_file_storage.h>
+#include <dlt_storage_reader.h>
+
+using namespace auto_os::middleware;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// same header setup as dlt_service
+static void setup_header(dlt_header &hdr)
+{
+    uint8_t session_id[4] = {'s', 'e', 's', 's'};
+    uint8_t app_id[4] = {'b', 'n', 'c', 'h'};
+    uint8_t ctx_id[4] = {'s', 't', 'o', 'r'};
+
+    hdr.set_msg_type_info(dlt_msg_typeinfo::DLT_MSG_TYPEINFO_STRG);
+    hdr.std_hdr.set_use_ext_hdr();
+    hdr.std_hdr.set_valid_ecu_id();
+    hdr.std_hdr.set_ecu_id("ecu1");
+    hdr.std_hdr.set_valid_session_id();
+    hdr.std_hdr.set_version(1);
+    hdr.std_hdr.set_session_id(session_id);
+    hdr.ext_hdr.set_verbose();
+    hdr.ext_hdr.set_msg_type(dlt_extended_header_msg_type::eDLT_TYPE_LOG);
+    hdr.ext_hdr.set_msg_type_info_log(dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO);
+    hdr.ext_hdr.set_app_id(app_id);
+    hdr.ext_hdr.set_context_id(ctx_id);
+}
+
+// decodes every segment and counts the messages
+static uint64_t count_stored(const std::string &dir)
+{
+    std::vector<uint8_t> buf(65536);
+    struct dirent *ent;
+    dlt_msg_view msg;
+    uint64_t n_msgs = 0;
+    DIR *d;
+
+    d = opendir(dir.c_str());
+    if (!d) {
+        return 0;
+    }
+
+    while ((ent = readdir(d)) != nullptr) {
+        std::string name = ent->d_name;
+        dlt_decoder decoder(true);
+
+        if ((name.length() < 4) || (name.compare(name.length() - 4, 4, ".dlt") != 0)) {
+            continue;
+        }
+
+        std::ifstream file(dir + "/" + name, std::ifstream::binary);
+        while (file) {
+            file.read((char *)buf.data(), buf.size());
+            decoder.feed(buf.data(), file.gcount());
+            while (decoder.next(msg) == 1) {
+                n_msgs ++;
+            }
+        }
+    }
+    closedir(d);
+
+    return n_msgs;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n messages] [-s payload size] [-d directory] [-b block size kb] "
+                    "[-f none|segment|interval|batch] [-B (buffered io)] [-I (no index)] [-z (compress)]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    dlt_file_storage_config config;
+    dlt_header_template tmpl;
+    dlt_header hdr;
+    uint8_t ecu_id[4] = {'e', 'c', 'u', '1'};
+    uint8_t buf[4096];
+    int count = 1000000;
+    int payload_size = 60;
+    std::string fsync = "segment";
+    int ret;
+
+    config.directory = "./dlt_storage_bench";
+    config.prefix = "bench";
+    config.segment_size = 16 * 1024 * 1024;
+    config.segment_duration_s = 0;
+    config.max_segments = 0;
+    config.block_size = 256 * 1024;
+    config.flush_interval_ms = 100;
+    config.fsync_interval_ms = 1000;
+    config.direct_io = true;
+    config.index = true;
+    config.compress = false;
+
+    while ((ret = getopt(argc, argv, "n:s:d:b:f:BIz")) != -1) {
+        switch (ret) {
+            case 'n':
+                count = atoi(optarg);
+            break;
+            case 's':
+                payload_size = atoi(optarg);
+            break;
+            case 'd':
+                config.directory = optarg;
+            break;
+            case 'b':
+                config.block_size = atoi(optarg) * 1024;
+            break;
+            case 'f':
+                fsync = optarg;
+            break;
+            case 'B':
+                config.direct_io = false;
+            break;
+            case 'I':
+                config.index = false;
+            break;
+            case 'z':
+                config.compress = true;
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (fsync == "none") {
+        config.fsync = dlt_fsync_policy::NONE;
+    } else if (fsync == "interval") {
+        config.fsync = dlt_fsync_policy::INTERVAL;
+    } else if (fsync == "batch") {
+        config.fsync = dlt_fsync_policy::BATCH;
+    } else {
+        config.fsync = dlt_fsync_policy::SEGMENT;
+    }
+
+    setup_header(hdr);
+    tmpl.init(hdr);
+
+    uint8_t *payload = buf + tmpl.hdr_len;
+    memset(payload, 'x', payload_size);
+
+    uint64_t start_ns;
+    uint64_t write_ns;
+    uint64_t total_ns;
+    uint64_t dropped;
+    uint64_t errors;
+
+    {
+        dlt_file_storage storage(config, ecu_id);
+        uint8_t warn_info;
+        uint8_t info;
+        uint8_t app_id[4];
+        uint8_t *msg;
+
+        // set_msg_type_info_log ors into the info bits
+        info = hdr.ext_hdr.message_info;
+        hdr.ext_hdr.message_info &= 0x0f;
+        hdr.ext_hdr.set_msg_type_info_log(dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN);
+        warn_info = hdr.ext_hdr.message_info;
+        memcpy(app_id, "ap00", sizeof(app_id));
+
+        start_ns = now_ns();
+        for (int i = 0; i < count; i ++) {
+            // 16 applications, one warning in 20000 messages
+            app_id[2] = '0' + (i % 16) / 10;
+            app_id[3] = '0' + (i % 16) % 10;
+            msg = tmpl.encode(payload, payload_size, i & 0xff, hdr.std_hdr.session_id, i,
+                              (i % 20000 == 3) ? warn_info : info, app_id, hdr.ext_hdr.context_id);
+            storage.write(msg, tmpl.hdr_len + payload_size + 1);
+        }
+        write_ns = now_ns() - start_ns;
+        dropped = storage.get_dropped();
+        errors = storage.get_write_errors();
+    }
+    // the destructor waits for the writer to finish
+    total_ns = now_ns() - start_ns;
+
+    uint64_t scan_ns = now_ns();
+    uint64_t stored = count_stored(config.directory);
+    scan_ns = now_ns() - scan_ns;
+
+    // what an incident query reads: one application, warning and above
+    dlt_storage_reader reader(config.directory, config.prefix);
+    dlt_storage_query q;
+
+    q.app_id = "ap03";
+    q.set_min_level(dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN);
+
+    uint64_t query_ns = now_ns();
+    int64_t matched = reader.query(q, [](dlt_msg_view &) { return true; });
+    query_ns = now_ns() - query_ns;
+
+    fprintf(stdout, "queued %d in %.3f s (%.0f msgs/sec)\n", count, write_ns / 1e9, count / (write_ns / 1e9));
+    fprintf(stdout, "stored %lu in %.3f s (%.0f msgs/sec) dropped %lu write errors %lu\n",
+                    stored, total_ns / 1e9, stored / (total_ns / 1e9), dropped, errors);
+    fprintf(stdout, "decoded all segments in %.3f ms\n", scan_ns / 1e6);
+    fprintf(stdout, "query ap03 >= warning matched %ld in %.3f ms, read %lu bytes in %lu spans, skipped %lu spans\n",
+                    matched, query_ns / 1e6, reader.get_bytes_read(),
+                    reader.get_spans_read(), reader.get_spans_skipped());
+
+    return 0;
+}
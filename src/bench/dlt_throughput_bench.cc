@@ -0,0 +1,309 @@
+/**
+ * @file dlt_throughput_bench.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief measures messages per second forwarded by dlt_service
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <dlt_lib.hpp>
+#include <dlt_enc_dec.h>
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// stands in for the storage server, counts the DLT frames of each
+// datagram, packed or compressed
+static void sink_thread(int sock, std::atomic<bool> *stop,
+                        uint64_t *frames, uint64_t *first_ns, uint64_t *last_ns)
+{
+    auto_os::middleware::dlt_decoder decoder;
+    uint8_t buf[65536];
+    struct timeval tv = {0, 100000};
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!*stop) {
+        int ret = recv(sock, buf, sizeof(buf), 0);
+        if (ret <= 0) {
+            continue;
+        }
+
+        *last_ns = now_ns();
+        if (*first_ns == 0) {
+            *first_ns = *last_ns;
+        }
+
+        auto_os::middleware::dlt_msg_view msg;
+
+        decoder.feed(buf, ret);
+        while (decoder.next(msg) == 1) {
+            (*frames) ++;
+        }
+    }
+}
+
+// a dlt viewer connected to the viewer server, counts the frames of the
+// tcp stream including the replayed history
+static void viewer_thread(int sock, std::atomic<bool> *stop, uint64_t *frames)
+{
+    auto_os::middleware::dlt_decoder decoder;
+    uint8_t buf[65536];
+    struct timeval tv = {0, 100000};
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!*stop) {
+        int ret = recv(sock, buf, sizeof(buf), 0);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0) {
+            continue;
+        }
+
+        auto_os::middleware::dlt_msg_view msg;
+
+        decoder.feed(buf, ret);
+        while (decoder.next(msg) == 1) {
+            (*frames) ++;
+        }
+    }
+}
+
+static int connect_viewer(int port)
+{
+    struct sockaddr_in addr;
+    int rcvbuf = 4096;
+    int sock;
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    // keeps a viewer that never reads stalled early
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+static void run_clients(int proc, int count, int threads, int payload_size, bool async,
+                        auto_os::middleware::dlt_async_overflow overflow, bool shm)
+{
+    auto_os::middleware::dlt_lib *log;
+    std::vector<std::thread> clients;
+    std::string context_id = "thpt";
+    char session_id[5];
+
+    snprintf(session_id, sizeof(session_id), "s%03d", proc);
+
+    log = auto_os::middleware::dlt_lib::instance();
+    log->connect(DLT_SERVER_ADDRESS, (uint8_t *)session_id);
+    if (shm && (log->enable_shm(DLT_SHM_SERVER_ADDRESS, 1024 * 1024) < 0)) {
+        fprintf(stderr, "failed to set up shared memory transport\n");
+        return;
+    }
+    if (async) {
+        log->enable_async(256 * 1024, overflow);
+    }
+
+    std::string payload(payload_size, 'x');
+    for (int t = 0; t < threads; t ++) {
+        clients.emplace_back([&, t]() {
+            char app_id[5];
+
+            snprintf(app_id, sizeof(app_id), "a%03d", proc * threads + t);
+            for (int i = 0; i < count; i ++) {
+                log->info(app_id, context_id, "%s", payload.c_str());
+            }
+        });
+    }
+    for (auto &c : clients) {
+        c.join();
+    }
+
+    uint64_t shm_dropped = log->get_shm_dropped();
+
+    // drains the rings before the sink stops
+    log->disconnect();
+
+    if (shm) {
+        fprintf(stdout, "shared memory ring dropped %lu\n", shm_dropped);
+    }
+    if (async) {
+        auto_os::middleware::dlt_async_stats stats;
+
+        log->get_async_stats(stats);
+        fprintf(stdout, "async sent %lu send errors %lu dropped newest %lu dropped oldest %lu blocked %lu\n",
+                        stats.sent, stats.send_errors, stats.dropped_newest,
+                        stats.dropped_oldest, stats.blocked);
+    }
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> [-n messages per thread] [-t threads] [-s payload size] [-p sink port] [-a newest|oldest|block] [-m] [-c client processes] [-V viewers] [-P viewer port]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    std::atomic<bool> stop(false);
+    struct sockaddr_in addr;
+    uint64_t frames = 0;
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+    int count = 100000;
+    int threads = 4;
+    int payload_size = 60;
+    int port = 2225;
+    bool async = false;
+    bool shm = false;
+    int procs = 0;
+    int viewers = 0;
+    int viewer_port = 3490;
+    std::vector<int> viewer_socks;
+    uint64_t viewer_frames = 0;
+    auto_os::middleware::dlt_async_overflow overflow = auto_os::middleware::dlt_async_overflow::BLOCK;
+    int sock;
+    int ret;
+
+    while ((ret = getopt(argc, argv, "n:t:s:p:a:mc:V:P:")) != -1) {
+        switch (ret) {
+            case 'n':
+                count = atoi(optarg);
+            break;
+            case 't':
+                threads = atoi(optarg);
+            break;
+            case 's':
+                payload_size = atoi(optarg);
+            break;
+            case 'p':
+                port = atoi(optarg);
+            break;
+            case 'a':
+                async = true;
+                if (!strcmp(optarg, "newest")) {
+                    overflow = auto_os::middleware::dlt_async_overflow::DROP_NEWEST;
+                } else if (!strcmp(optarg, "oldest")) {
+                    overflow = auto_os::middleware::dlt_async_overflow::DROP_OLDEST;
+                }
+            break;
+            case 'm':
+                shm = true;
+            break;
+            case 'c':
+                procs = atoi(optarg);
+            break;
+            case 'V':
+                viewers = atoi(optarg);
+            break;
+            case 'P':
+                viewer_port = atoi(optarg);
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "failed to bind sink port %d\n", port);
+        return -1;
+    }
+
+    std::thread sink(sink_thread, sock, &stop, &frames, &first_ns, &last_ns);
+    std::thread viewer;
+
+    // the first viewer reads, the others never do
+    for (int v = 0; v < viewers; v ++) {
+        int viewer_sock = connect_viewer(viewer_port);
+
+        if (viewer_sock < 0) {
+            fprintf(stderr, "failed to connect viewer to port %d\n", viewer_port);
+            return -1;
+        }
+        viewer_socks.push_back(viewer_sock);
+    }
+    if (viewers > 0) {
+        viewer = std::thread(viewer_thread, viewer_socks[0], &stop, &viewer_frames);
+    }
+
+    uint64_t start_ns = now_ns();
+
+    // every client process has its own connection and session id, every
+    // thread its own app id
+    if (procs == 0) {
+        run_clients(0, count, threads, payload_size, async, overflow, shm);
+    } else {
+        for (int p = 0; p < procs; p ++) {
+            if (fork() == 0) {
+                run_clients(p, count, threads, payload_size, async, overflow, shm);
+                fflush(stdout);
+                _exit(0);
+            }
+        }
+        for (int p = 0; p < procs; p ++) {
+            wait(nullptr);
+        }
+    }
+
+    uint64_t send_ns = now_ns() - start_ns;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    stop = true;
+    sink.join();
+    close(sock);
+    if (viewer.joinable()) {
+        viewer.join();
+    }
+    for (auto viewer_sock : viewer_socks) {
+        close(viewer_sock);
+    }
+
+    uint64_t sent = (uint64_t)count * threads * (procs ? procs : 1);
+    double fwd_sec = (last_ns - start_ns) / 1e9;
+
+    fprintf(stdout, "sent %lu in %.3f s (%.0f msgs/sec)\n", sent, send_ns / 1e9, sent / (send_ns / 1e9));
+    fprintf(stdout, "forwarded %lu in %.3f s (%.0f msgs/sec) loss %.2f%%\n",
+                    frames, fwd_sec, frames / fwd_sec,
+                    100.0 * (sent - frames) / sent);
+    if (viewers > 0) {
+        fprintf(stdout, "viewer received %lu with replayed history, %d stalled viewers\n",
+                        viewer_frames, viewers - 1);
+    }
+    return 0;
+}
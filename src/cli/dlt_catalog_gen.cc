@@ -0,0 +1,206 @@
+/**
+ * @file dlt_catalog_gen.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief generates the non verbose message catalog from DLT_LOG_NV call sites
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ * 
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <getopt.h>
+#include <string.h>
+#include <dlt_catalog.h>
+
+#define DLT_LOG_NV_TOKEN "DLT_LOG_NV("
+
+/**
+ * @brief parse adjacent string literals the way the compiler joins them
+ * 
+ * @param in src source text
+ * @param in/out off start of the first literal, end of the last on return
+ * @param out str unescaped string
+ * @return returns 0 on success -1 if there is no string literal
+ */
+static int parse_literal(const std::string &src, size_t &off, std::string &str)
+{
+    bool found = false;
+
+    str.clear();
+
+    while (1) {
+        while ((off < src.length()) && isspace(src[off])) {
+            off ++;
+        }
+        if ((off >= src.length()) || (src[off] != '"')) {
+            break;
+        }
+        found = true;
+        off ++;
+
+        while ((off < src.length()) && (src[off] != '"')) {
+            char c = src[off ++];
+
+            if (c != '\\') {
+                str += c;
+                continue;
+            }
+
+            c = src[off ++];
+            switch (c) {
+                case 'n': str += '\n'; break;
+                case 't': str += '\t'; break;
+                case 'r': str += '\r'; break;
+                case 'a': str += '\a'; break;
+                case 'b': str += '\b'; break;
+                case 'f': str += '\f'; break;
+                case 'v': str += '\v'; break;
+                case 'x': {
+                    int val = 0;
+                    while ((off < src.length()) && isxdigit(src[off])) {
+                        val = (val * 16) + (isdigit(src[off]) ? src[off] - '0' :
+                                                                (tolower(src[off]) - 'a' + 10));
+                        off ++;
+                    }
+                    str += (char)val;
+                } break;
+                default:
+                    if ((c >= '0') && (c <= '7')) {
+                        int val = c - '0';
+                        int i;
+
+                        for (i = 0; (i < 2) && (src[off] >= '0') && (src[off] <= '7'); i ++) {
+                            val = (val * 8) + (src[off ++] - '0');
+                        }
+                        str += (char)val;
+                    } else {
+                        // \\ \" \' \?
+                        str += c;
+                    }
+                break;
+            }
+        }
+        off ++;
+    }
+
+    return found ? 0 : -1;
+}
+
+/**
+ * @brief skip the first n top level arguments of a call
+ * 
+ * @return returns 0 on success -1 if the call ends first
+ */
+static int skip_args(const std::string &src, size_t &off, int n)
+{
+    int depth = 0;
+
+    while ((off < src.length()) && (n > 0)) {
+        char c = src[off ++];
+
+        if ((c == '"') || (c == '\'')) {
+            while ((off < src.length()) && (src[off] != c)) {
+                off += (src[off] == '\\') ? 2 : 1;
+            }
+            off ++;
+        } else if ((c == '(') || (c == '[') || (c == '{')) {
+            depth ++;
+        } else if ((c == ')') || (c == ']') || (c == '}')) {
+            if (depth == 0) {
+                return -1;
+            }
+            depth --;
+        } else if ((c == ',') && (depth == 0)) {
+            n --;
+        }
+    }
+
+    return n == 0 ? 0 : -1;
+}
+
+static int scan_file(const std::string &file, auto_os::middleware::dlt_catalog &catalog)
+{
+    std::ifstream in(file);
+    std::stringstream ss;
+    std::string src;
+    size_t pos = 0;
+    int count = 0;
+
+    if (!in.is_open()) {
+        fprintf(stderr, "failed to open %s\n", file.c_str());
+        return -1;
+    }
+
+    ss << in.rdbuf();
+    src = ss.str();
+
+    while ((pos = src.find(DLT_LOG_NV_TOKEN, pos)) != std::string::npos) {
+        size_t off = pos + strlen(DLT_LOG_NV_TOKEN);
+        int line = 1 + std::count(src.begin(), src.begin() + pos, '\n');
+        std::string format;
+
+        pos = off;
+
+        // level, app id, context id, then the format literal. the macro
+        // definition itself has no literal there and is skipped
+        if ((skip_args(src, off, 3) < 0) || (parse_literal(src, off, format) < 0)) {
+            continue;
+        }
+
+        if (catalog.add(format, file, line) < 0) {
+            fprintf(stderr, "%s:%d: unsupported format or message id collision\n",
+                            file.c_str(), line);
+            return -1;
+        }
+        count ++;
+    }
+
+    return count;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> <-o catalog file> <source files...>\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    auto_os::middleware::dlt_catalog catalog;
+    std::string out_file;
+    int ret;
+    int i;
+
+    while ((ret = getopt(argc, argv, "o:")) != -1) {
+        switch (ret) {
+            case 'o':
+                out_file = std::string(optarg);
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (out_file.empty()) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    for (i = optind; i < argc; i ++) {
+        if (scan_file(argv[i], catalog) < 0) {
+            return -1;
+        }
+    }
+
+    if (catalog.save(out_file) < 0) {
+        fprintf(stderr, "failed to write %s\n", out_file.c_str());
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file dlt_query.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief prints the stored messages of an app, level and time range
+ * @version 0.1
+ * @date 2021-12-29
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ *
+ */
+#include <iostream>
+#include <string>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <dlt_catalog.h>
+#include <dlt_storage_reader.h>
+
+using namespace auto_os::middleware;
+
+/**
+ * @brief parse "YYYY-mm-dd HH:MM:SS[.frac]" in local time or seconds since the epoch
+ *
+ * @param in str time string
+ * @param out time_us microseconds since the epoch
+ * @return returns 0 on success -1 if the time is not valid
+ */
+static int parse_time(const char *str, uint64_t &time_us)
+{
+    struct tm tm;
+    const char *end;
+    char *num_end;
+    double frac = 0;
+
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+    if (!end) {
+        double sec = strtod(str, &num_end);
+
+        if ((num_end == str) || (*num_end != '\0') || (sec < 0)) {
+            return -1;
+        }
+        time_us = sec * 1000000;
+        return 0;
+    }
+
+    if (*end == '.') {
+        frac = strtod(end, &num_end);
+        end = num_end;
+    }
+    if (*end != '\0') {
+        return -1;
+    }
+
+    tm.tm_isdst = -1;
+    time_us = (uint64_t)mktime(&tm) * 1000000 + (uint64_t)(frac * 1000000);
+
+    return 0;
+}
+
+static int parse_level(const std::string &level, dlt_extended_header_msg_type_info_log &lvl)
+{
+    static const struct {
+        const char *name;
+        dlt_extended_header_msg_type_info_log lvl;
+    } levels[] = {
+        {"fatal", dlt_extended_header_msg_type_info_log::eDLT_LOG_FATAL},
+        {"error", dlt_extended_header_msg_type_info_log::eDLT_LOG_ERROR},
+        {"warning", dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN},
+        {"info", dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO},
+        {"debug", dlt_extended_header_msg_type_info_log::eDLT_LOG_DEBUG},
+        {"verbose", dlt_extended_header_msg_type_info_log::eDLT_LOG_VERBOSE},
+    };
+
+    for (auto &l : levels) {
+        if (level == l.name) {
+            lvl = l.lvl;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static const char *level_name(dlt_msg_view &msg)
+{
+    static const char *names[] = {"", "fatal", "error", "warning", "info", "debug", "verbose"};
+    int lvl = msg.get_msg_type_info();
+
+    if (!msg.has_ext_hdr || (msg.get_msg_type() != 0) || (lvl < 1) || (lvl > 6)) {
+        return "unknown";
+    }
+    return names[lvl];
+}
+
+static std::string format_payload(dlt_msg_view &msg, dlt_catalog &catalog)
+{
+    std::string text;
+    dlt_arg_view arg;
+
+    if (!msg.is_verbose()) {
+        if (catalog.expand(msg.payload, msg.payload_len, text) < 0) {
+            text = "[non verbose " + std::to_string(msg.get_message_id()) + "]";
+        }
+        while (!text.empty() && (text.back() == '\n')) {
+            text.pop_back();
+        }
+        return text;
+    }
+
+    dlt_arg_reader reader(msg);
+    while (reader.next(arg) == 1) {
+        if (!text.empty()) {
+            text += " ";
+        }
+        if (arg.is_type(DLT_TYPEINFO_BOOL)) {
+            text += arg.as_bool() ? "true" : "false";
+        } else if (arg.is_type(DLT_TYPEINFO_SINT)) {
+            text += std::to_string(arg.as_int());
+        } else if (arg.is_type(DLT_TYPEINFO_UINT)) {
+            text += std::to_string(arg.as_uint());
+        } else if (arg.is_type(DLT_TYPEINFO_FLOA)) {
+            text += std::to_string(arg.as_float());
+        } else if (arg.is_type(DLT_TYPEINFO_STRG)) {
+            text += arg.as_string();
+        } else if (arg.is_type(DLT_TYPEINFO_RAWD)) {
+            char hex[3];
+
+            for (uint32_t i = 0; i < arg.data_len; i ++) {
+                snprintf(hex, sizeof(hex), "%02x", arg.data[i]);
+                text += hex;
+            }
+        }
+    }
+    while (!text.empty() && (text.back() == '\n')) {
+        text.pop_back();
+    }
+
+    return text;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "<%s> -d directory [-p prefix] [-a app id] [-c context id] "
+                    "[-l minimum level] [-s start time] [-e end time] [-C catalog] [-n (count only)] [-v (stats)]\n"
+                    "\ttimes are \"YYYY-mm-dd HH:MM:SS[.frac]\" local time or seconds since the epoch\n"
+                    "\tlevels are fatal, error, warning, info, debug or verbose\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+    dlt_storage_query q;
+    dlt_catalog catalog;
+    std::string directory;
+    std::string prefix;
+    bool count_only = false;
+    bool stats = false;
+    int ret;
+
+    while ((ret = getopt(argc, argv, "d:p:a:c:l:s:e:C:nv")) != -1) {
+        switch (ret) {
+            case 'd':
+                directory = optarg;
+            break;
+            case 'p':
+                prefix = optarg;
+            break;
+            case 'a':
+                q.app_id = optarg;
+            break;
+            case 'c':
+                q.ctx_id = optarg;
+            break;
+            case 'l': {
+                dlt_extended_header_msg_type_info_log lvl;
+
+                if (parse_level(optarg, lvl) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                q.set_min_level(lvl);
+            } break;
+            case 's':
+                if (parse_time(optarg, q.start_us) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+            break;
+            case 'e':
+                if (parse_time(optarg, q.end_us) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+            break;
+            case 'C':
+                if (catalog.load(optarg) < 0) {
+                    fprintf(stderr, "failed to load catalog %s\n", optarg);
+                    return -1;
+                }
+            break;
+            case 'n':
+                count_only = true;
+            break;
+            case 'v':
+                stats = true;
+            break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (directory.empty()) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    dlt_storage_reader reader(directory, prefix);
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t matched = reader.query(q, [&](dlt_msg_view &msg) {
+        char time_str[32];
+        struct tm tm;
+        time_t sec = msg.storage_sec;
+        const uint8_t *ecu = msg.ecu_id ? msg.ecu_id : msg.storage_ecu_id;
+        static const uint8_t none[4] = {'-', '-', '-', '-'};
+        const uint8_t *app = msg.has_ext_hdr ? msg.app_id : none;
+        const uint8_t *ctx = msg.has_ext_hdr ? msg.ctx_id : none;
+        // the ids are not nul terminated
+        char ecu_str[5] = {0};
+        char app_str[5] = {0};
+        char ctx_str[5] = {0};
+
+        if (count_only) {
+            return true;
+        }
+
+        memcpy(ecu_str, ecu, 4);
+        memcpy(app_str, app, 4);
+        memcpy(ctx_str, ctx, 4);
+        localtime_r(&sec, &tm);
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm);
+        fprintf(stdout, "%s.%06d [%s] [%d] [%s][%s] [%s] %s\n",
+                        time_str, msg.storage_usec,
+                        ecu_str,
+                        msg.msg_counter,
+                        app_str,
+                        ctx_str,
+                        level_name(msg),
+                        format_payload(msg, catalog).c_str());
+        return true;
+    });
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (matched < 0) {
+        fprintf(stderr, "failed to read %s\n", directory.c_str());
+        return -1;
+    }
+
+    if (count_only) {
+        fprintf(stdout, "%ld\n", matched);
+    }
+    if (stats) {
+        fprintf(stderr, "matched %ld, read %lu bytes in %lu spans, skipped %lu spans, %.3f ms\n",
+                        matched, reader.get_bytes_read(),
+                        reader.get_spans_read(), reader.get_spans_skipped(),
+                        (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    }
+
+    return 0;
+}
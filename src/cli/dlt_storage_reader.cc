@@ -0,0 +1,312 @@
+/**
+ * @file dlt_storage_reader.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief range queries over stored .dlt segments using their index
+ * @version 0.1
+ * @date 2021-12-29
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <dlt_compress.h>
+#include <dlt_storage_reader.h>
+
+namespace auto_os::middleware {
+
+// maps a whole file read only
+class dlt_mapped_file {
+    public:
+        explicit dlt_mapped_file(const std::string &path) : data(nullptr), len(0)
+        {
+            struct stat st;
+            int fd;
+
+            fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+                void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (addr != MAP_FAILED) {
+                    data = (const uint8_t *)addr;
+                    len = st.st_size;
+                }
+            }
+            close(fd);
+        }
+        ~dlt_mapped_file()
+        {
+            if (data) {
+                munmap((void *)data, len);
+            }
+        }
+
+        const uint8_t *data;
+        size_t len;
+};
+
+static void pad_id(const std::string &id, uint8_t *out)
+{
+    memset(out, 0, 4);
+    memcpy(out, id.data(), std::min(id.length(), (size_t)4));
+}
+
+dlt_storage_reader::dlt_storage_reader(const std::string &directory, const std::string &prefix) :
+                                directory_(directory),
+                                prefix_(prefix),
+                                block_src_(nullptr),
+                                spans_read_(0),
+                                spans_skipped_(0),
+                                bytes_read_(0)
+{
+    memset(app_id_, 0, sizeof(app_id_));
+    memset(ctx_id_, 0, sizeof(ctx_id_));
+}
+
+int64_t dlt_storage_reader::query(const dlt_storage_query &q, const std::function<bool(dlt_msg_view &)> &cb)
+{
+    std::vector<std::string> segments;
+    struct dirent *ent;
+    int64_t matched = 0;
+    DIR *dir;
+
+    pad_id(q.app_id, app_id_);
+    pad_id(q.ctx_id, ctx_id_);
+
+    dir = opendir(directory_.c_str());
+    if (!dir) {
+        return -1;
+    }
+    while ((ent = readdir(dir)) != nullptr) {
+        std::string name = ent->d_name;
+
+        if ((name.compare(0, prefix_.length(), prefix_) == 0) &&
+            (name.length() > 4) && (name.compare(name.length() - 4, 4, ".dlt") == 0)) {
+            segments.push_back(directory_ + "/" + name);
+        }
+    }
+    closedir(dir);
+
+    // names carry the creation time
+    std::sort(segments.begin(), segments.end());
+
+    for (auto &path : segments) {
+        if (query_segment(path, q, cb, matched) < 0) {
+            break;
+        }
+    }
+
+    return matched;
+}
+
+int dlt_storage_reader::query_segment(const std::string &path, const dlt_storage_query &q,
+                                      const std::function<bool(dlt_msg_view &)> &cb, int64_t &matched)
+{
+    dlt_mapped_file seg(path);
+    dlt_mapped_file idx(dlt_index_path(path));
+    const dlt_index_file_hdr *hdr = (const dlt_index_file_hdr *)idx.data;
+    size_t indexed_end = 0;
+    bool compressed;
+    size_t off;
+
+    if (!seg.data) {
+        return 0;
+    }
+    block_src_ = nullptr;
+
+    if (hdr && (idx.len >= sizeof(*hdr)) &&
+        (memcmp(hdr->magic, DLT_INDEX_MAGIC, sizeof(hdr->magic)) == 0) &&
+        (hdr->version == DLT_INDEX_VERSION)) {
+        compressed = !!(hdr->flags & DLT_INDEX_FILE_COMPRESSED);
+        off = sizeof(*hdr);
+        while (off + sizeof(dlt_index_entry) <= idx.len) {
+            const dlt_index_entry *e = (const dlt_index_entry *)(idx.data + off);
+            const dlt_index_key *keys = (const dlt_index_key *)(e + 1);
+            size_t entry_len = sizeof(*e) + e->n_keys * sizeof(dlt_index_key);
+            dlt_block_hdr block_hdr;
+            size_t need;
+            int block_len = 0;
+
+            // the entry of a block may be written before its data reached
+            // the file, stop at the first one that is not complete
+            if (off + entry_len > idx.len) {
+                break;
+            }
+            if (compressed) {
+                if (e->offset > seg.len) {
+                    break;
+                }
+                block_len = dlt_block::parse(seg.data + e->offset, seg.len - e->offset, block_hdr, need);
+                if ((block_len <= 0) || (e->block_off + e->length > block_hdr.raw_len)) {
+                    break;
+                }
+            } else if (e->offset + e->length > seg.len) {
+                break;
+            }
+            off += entry_len;
+            indexed_end = compressed ? e->offset + block_len : e->offset + e->length;
+
+            if (!match_span(e, keys, q)) {
+                spans_skipped_ ++;
+                continue;
+            }
+            spans_read_ ++;
+
+            if (!compressed) {
+                if (!scan(seg.data, e->offset, indexed_end, q, cb, matched)) {
+                    return -1;
+                }
+                continue;
+            }
+            if ((block_src_ != seg.data + e->offset) && (load_block(seg.data + e->offset, block_len) < 0)) {
+                continue;
+            }
+            if (!scan(block_.data(), e->block_off, e->block_off + e->length, q, cb, matched)) {
+                return -1;
+            }
+        }
+    }
+
+    if (!scan(seg.data, indexed_end, seg.len, q, cb, matched)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+bool dlt_storage_reader::scan(const uint8_t *data, size_t off, size_t end, const dlt_storage_query &q,
+                              const std::function<bool(dlt_msg_view &)> &cb, int64_t &matched)
+{
+    dlt_msg_view msg;
+    size_t need;
+
+    bytes_read_ += end - off;
+
+    while (off < end) {
+        int ret;
+
+        if (dlt_block::is_block(data + off, end - off)) {
+            std::vector<uint8_t> raw;
+
+            ret = load_block(data + off, end - off);
+            if (ret > 0) {
+                // the frames of a block are scanned from a copy, the
+                // nested scan reuses block_
+                raw.swap(block_);
+                block_src_ = nullptr;
+                bytes_read_ -= raw.size();
+                if (!scan(raw.data(), 0, raw.size(), q, cb, matched)) {
+                    return false;
+                }
+                off += ret;
+                continue;
+            }
+        } else {
+            ret = dlt_decoder::parse(data + off, end - off, true, msg, need);
+        }
+
+        if (ret == 0) {
+            break;
+        }
+        // padding of a segment that was not closed, or garbage, skip to
+        // the next storage header or block
+        if (ret < 0) {
+            const uint8_t *p = data + off + 1;
+            const void *next;
+
+            while ((next = memmem(p, data + end - p, "DL", 2)) != nullptr) {
+                p = (const uint8_t *)next;
+                if ((data + end - p >= DLT_STORAGE_HDR_PATTERN_LEN) &&
+                    ((p[2] == DLT_STORAGE_HDR_PATTERN[2]) || (p[2] == DLT_BLOCK_MAGIC[2])) && (p[3] == 0x01)) {
+                    break;
+                }
+                p ++;
+            }
+            if (!next) {
+                break;
+            }
+            off = p - data;
+            continue;
+        }
+        off += ret;
+
+        if (!match_msg(msg, q)) {
+            continue;
+        }
+        matched ++;
+        if (!cb(msg)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int dlt_storage_reader::load_block(const uint8_t *data, size_t len)
+{
+    dlt_block_hdr hdr;
+    size_t need;
+    int ret;
+
+    ret = dlt_block::parse(data, len, hdr, need);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    block_.resize(hdr.raw_len);
+    if (dlt_block::decode(data, hdr, block_.data()) < 0) {
+        block_src_ = nullptr;
+        return -1;
+    }
+    block_src_ = data;
+
+    return ret;
+}
+
+bool dlt_storage_reader::match_span(const dlt_index_entry *e, const dlt_index_key *keys,
+                                    const dlt_storage_query &q)
+{
+    if ((e->last_us < q.start_us) || (e->first_us > q.end_us) || !(e->levels & q.levels)) {
+        return false;
+    }
+    if ((q.app_id.empty() && q.ctx_id.empty()) || (e->flags & DLT_INDEX_KEYS_OVERFLOW)) {
+        return true;
+    }
+
+    for (uint16_t i = 0; i < e->n_keys; i ++) {
+        if ((q.app_id.empty() || (memcmp(keys[i].app_id, app_id_, 4) == 0)) &&
+            (q.ctx_id.empty() || (memcmp(keys[i].ctx_id, ctx_id_, 4) == 0)) &&
+            (keys[i].levels & q.levels)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool dlt_storage_reader::match_msg(const dlt_msg_view &msg, const dlt_storage_query &q)
+{
+    uint64_t time_us = (uint64_t)msg.storage_sec * 1000000 + msg.storage_usec;
+    uint8_t level = msg.has_ext_hdr ? dlt_index_level_bit(msg.message_info) : DLT_INDEX_LEVEL_NON_LOG;
+
+    if ((time_us < q.start_us) || (time_us > q.end_us) || !(level & q.levels)) {
+        return false;
+    }
+    if (!q.app_id.empty() && (!msg.has_ext_hdr || (memcmp(msg.app_id, app_id_, 4) != 0))) {
+        return false;
+    }
+    if (!q.ctx_id.empty() && (!msg.has_ext_hdr || (memcmp(msg.ctx_id, ctx_id_, 4) != 0))) {
+        return false;
+    }
+
+    return true;
+}
+
+}
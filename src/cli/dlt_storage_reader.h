@@ -0,0 +1,117 @@
+/**
+ * @file dlt_storage_reader.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief range queries over stored .dlt segments using their index
+ * @version 0.1
+ * @date 2021-12-29
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_STORAGE_READER_H__
+#define __AUTO_MIDDLEWARE_DLT_STORAGE_READER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <dlt_enc_dec.h>
+#include <dlt_storage_index.h>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief messages to find, every condition must match
+ */
+struct dlt_storage_query {
+    // up to 4 characters, empty matches any
+    std::string app_id;
+    std::string ctx_id;
+    // bitmap of accepted levels, see dlt_index_level_bit
+    uint8_t levels;
+    // storage time range in microseconds since the epoch, inclusive
+    uint64_t start_us;
+    uint64_t end_us;
+
+    dlt_storage_query() :
+                    levels(0xff),
+                    start_us(0),
+                    end_us(UINT64_MAX)
+    { }
+
+    /**
+     * @brief accept log messages of this level or more severe
+     */
+    inline void set_min_level(dlt_extended_header_msg_type_info_log lvl)
+    {
+        levels = (2 << static_cast<int>(lvl)) - 2;
+    }
+};
+
+/**
+ * @brief reads the segments of a storage directory
+ *
+ * Segments are mapped with mmap. When a segment has an index, only the
+ * spans whose time range, levels and (app_id, ctx_id) keys can match
+ * are decoded, data past the last index entry is always scanned.
+ * Segments without an index are scanned whole. Compressed blocks are
+ * decompressed once per query however many of their spans match.
+ */
+class dlt_storage_reader {
+    public:
+        /**
+         * @brief create reader
+         *
+         * @param in directory storage directory
+         * @param in prefix segment file prefix, empty reads all .dlt files
+         */
+        explicit dlt_storage_reader(const std::string &directory, const std::string &prefix = "");
+        ~dlt_storage_reader() { }
+
+        dlt_storage_reader(const dlt_storage_reader &) = delete;
+        const dlt_storage_reader &operator=(const dlt_storage_reader &) = delete;
+        dlt_storage_reader(const dlt_storage_reader &&) = delete;
+        const dlt_storage_reader &&operator=(const dlt_storage_reader &&) = delete;
+
+        /**
+         * @brief call cb with each matching message, oldest segment first
+         *
+         * the view points into the mapped segment and is valid during the
+         * callback only.
+         *
+         * @param in q query
+         * @param in cb returns false to stop the query
+         * @return returns number of matching messages, -1 if the directory
+         *         can not be read
+         */
+        int64_t query(const dlt_storage_query &q, const std::function<bool(dlt_msg_view &)> &cb);
+
+        inline uint64_t get_spans_read() { return spans_read_; }
+        inline uint64_t get_spans_skipped() { return spans_skipped_; }
+        inline uint64_t get_bytes_read() { return bytes_read_; }
+
+    private:
+        int query_segment(const std::string &path, const dlt_storage_query &q,
+                          const std::function<bool(dlt_msg_view &)> &cb, int64_t &matched);
+        bool scan(const uint8_t *data, size_t off, size_t end, const dlt_storage_query &q,
+                  const std::function<bool(dlt_msg_view &)> &cb, int64_t &matched);
+        bool match_span(const dlt_index_entry *e, const dlt_index_key *keys, const dlt_storage_query &q);
+        bool match_msg(const dlt_msg_view &msg, const dlt_storage_query &q);
+        int load_block(const uint8_t *data, size_t len);
+
+        std::string directory_;
+        std::string prefix_;
+        // query ids padded to 4 bytes
+        uint8_t app_id_[4];
+        uint8_t ctx_id_[4];
+        // last decompressed block and its position in the mapped segment
+        std::vector<uint8_t> block_;
+        const uint8_t *block_src_;
+
+        uint64_t spans_read_;
+        uint64_t spans_skipped_;
+        uint64_t bytes_read_;
+};
+
+}
+
+#endif
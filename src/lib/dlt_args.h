@@ -0,0 +1,267 @@
+/**
+ * @file dlt_args.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief serializes typed values as dlt verbose arguments
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ * 
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_ARGS_H__
+#define __AUTO_MIDDLEWARE_DLT_ARGS_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <dlt_msg_if.h>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief message id of a non verbose message, FNV-1a hash of its format
+ *
+ * evaluated at compile time by DLT_LOG_NV and by dlt_catalog_gen when it
+ * scans the sources, so both always agree.
+ *
+ * @param in fmt format string
+ * @return returns message id
+ */
+constexpr uint32_t dlt_msg_id(const char *fmt)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*fmt) {
+        hash = (hash ^ (uint8_t)*fmt) * 16777619u;
+        fmt ++;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief raw bytes logged as a RAWD argument
+ */
+struct dlt_raw {
+    const void *data;
+    uint16_t len;
+};
+
+/**
+ * @brief writes verbose arguments back to back into a buffer
+ *
+ * values are copied in host byte order, nothing is formatted as text.
+ * an argument that does not fit is dropped and the writer stops.
+ */
+class dlt_arg_writer {
+    public:
+        explicit dlt_arg_writer(uint8_t *buf, size_t size) :
+                            buf_(buf),
+                            size_(size),
+                            off_(0),
+                            n_args_(0),
+                            full_(false)
+        { }
+        ~dlt_arg_writer() { }
+
+        inline bool put(bool val)
+        {
+            uint8_t v = val ? 1 : 0;
+
+            return put_value(DLT_TYPEINFO_BOOL | DLT_TYPEINFO_TYLE_8BIT, &v, sizeof(v));
+        }
+
+        template <typename T,
+                  typename std::enable_if<std::is_integral<T>::value &&
+                                          !std::is_same<T, bool>::value, int>::type = 0>
+        inline bool put(T val)
+        {
+            uint32_t type = std::is_signed<T>::value ? DLT_TYPEINFO_SINT : DLT_TYPEINFO_UINT;
+
+            return put_value(type | tyle(sizeof(T)), &val, sizeof(T));
+        }
+
+        inline bool put(float val)
+        {
+            return put_value(DLT_TYPEINFO_FLOA | DLT_TYPEINFO_TYLE_32BIT, &val, sizeof(val));
+        }
+
+        inline bool put(double val)
+        {
+            return put_value(DLT_TYPEINFO_FLOA | DLT_TYPEINFO_TYLE_64BIT, &val, sizeof(val));
+        }
+
+        inline bool put(const char *str)
+        {
+            return put_bytes(DLT_TYPEINFO_STRG, str, strlen(str), true);
+        }
+
+        inline bool put(const std::string &str)
+        {
+            return put_bytes(DLT_TYPEINFO_STRG, str.data(), str.length(), true);
+        }
+
+        inline bool put(const dlt_raw &raw)
+        {
+            return put_bytes(DLT_TYPEINFO_RAWD, raw.data, raw.len, false);
+        }
+
+        inline size_t get_len() { return off_; }
+        inline int get_n_args() { return n_args_; }
+
+    private:
+        static constexpr uint32_t tyle(size_t size)
+        {
+            return size == 1 ? DLT_TYPEINFO_TYLE_8BIT :
+                   size == 2 ? DLT_TYPEINFO_TYLE_16BIT :
+                   size == 4 ? DLT_TYPEINFO_TYLE_32BIT :
+                               DLT_TYPEINFO_TYLE_64BIT;
+        }
+
+        inline bool put_value(uint32_t type, const void *val, size_t len)
+        {
+            if (full_ || (off_ + sizeof(type) + len > size_)) {
+                full_ = true;
+                return false;
+            }
+
+            memcpy(buf_ + off_, &type, sizeof(type));
+            memcpy(buf_ + off_ + sizeof(type), val, len);
+            off_ += sizeof(type) + len;
+            n_args_ ++;
+
+            return true;
+        }
+
+        // STRG and RAWD: type info, 16 bit length, bytes
+        inline bool put_bytes(uint32_t type, const void *data, size_t len, bool null_term)
+        {
+            uint16_t arg_len = len + (null_term ? 1 : 0);
+
+            if (full_ || (len > UINT16_MAX - 1) ||
+                (off_ + sizeof(type) + sizeof(arg_len) + arg_len > size_)) {
+                full_ = true;
+                return false;
+            }
+
+            memcpy(buf_ + off_, &type, sizeof(type));
+            off_ += sizeof(type);
+            memcpy(buf_ + off_, &arg_len, sizeof(arg_len));
+            off_ += sizeof(arg_len);
+            memcpy(buf_ + off_, data, len);
+            off_ += len;
+            if (null_term) {
+                buf_[off_ ++] = '\0';
+            }
+            n_args_ ++;
+
+            return true;
+        }
+
+        uint8_t *buf_;
+        size_t size_;
+        size_t off_;
+        int n_args_;
+        bool full_;
+};
+
+/**
+ * @brief writes the message id and argument values of a non verbose message
+ *
+ * values are packed in host byte order without type info, after the
+ * default argument promotions of printf: integers narrower than int are
+ * widened to 32 bits, float to double. strings are a 16 bit length
+ * followed by the bytes.
+ */
+class dlt_nv_arg_writer {
+    public:
+        explicit dlt_nv_arg_writer(uint8_t *buf, size_t size, uint32_t msg_id) :
+                            buf_(buf),
+                            size_(size),
+                            off_(0),
+                            full_(false)
+        {
+            put_value(&msg_id, sizeof(msg_id));
+        }
+        ~dlt_nv_arg_writer() { }
+
+        template <typename T,
+                  typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        inline bool put(T val)
+        {
+            if (sizeof(T) < sizeof(int32_t)) {
+                if (std::is_signed<T>::value) {
+                    int32_t v = val;
+                    return put_value(&v, sizeof(v));
+                }
+                uint32_t v = val;
+                return put_value(&v, sizeof(v));
+            }
+
+            return put_value(&val, sizeof(T));
+        }
+
+        inline bool put(double val)
+        {
+            return put_value(&val, sizeof(val));
+        }
+
+        inline bool put(const char *str)
+        {
+            return put_string(str, strlen(str));
+        }
+
+        inline bool put(const std::string &str)
+        {
+            return put_string(str.data(), str.length());
+        }
+
+        inline size_t get_len() { return off_; }
+
+    private:
+        inline bool put_value(const void *val, size_t len)
+        {
+            if (full_ || (off_ + len > size_)) {
+                full_ = true;
+                return false;
+            }
+
+            memcpy(buf_ + off_, val, len);
+            off_ += len;
+
+            return true;
+        }
+
+        inline bool put_string(const char *str, size_t len)
+        {
+            uint16_t str_len = len;
+
+            if (full_ || (len > UINT16_MAX) || (off_ + sizeof(str_len) + len > size_)) {
+                full_ = true;
+                return false;
+            }
+
+            memcpy(buf_ + off_, &str_len, sizeof(str_len));
+            memcpy(buf_ + off_ + sizeof(str_len), str, len);
+            off_ += sizeof(str_len) + len;
+
+            return true;
+        }
+
+        uint8_t *buf_;
+        size_t size_;
+        size_t off_;
+        bool full_;
+};
+
+/**
+ * @brief never called, lets the compiler check DLT_LOG_NV arguments
+ *        against the format like printf
+ */
+static inline void dlt_nv_format_check(const char *, ...) __attribute__((format(printf, 1, 2)));
+static inline void dlt_nv_format_check(const char *, ...) { }
+
+}
+
+#endif
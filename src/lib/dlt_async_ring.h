@@ -0,0 +1,227 @@
+/**
+ * @file dlt_async_ring.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief per thread record ring of the asynchronous dlt_lib mode
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ * 
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_ASYNC_RING_H__
+#define __AUTO_MIDDLEWARE_DLT_ASYNC_RING_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief what a logging call does when its ring is full
+ */
+enum class dlt_async_overflow {
+    DROP_NEWEST,
+    DROP_OLDEST,
+    BLOCK,
+};
+
+/**
+ * @brief variable sized records between one logging thread and the flusher
+ *
+ * every record is a 16 bit length followed by the message, a record never
+ * wraps, the unused end of the buffer is skipped with a padding marker.
+ * the logging thread only moves tail_. head_ is moved by the flusher and,
+ * with DROP_OLDEST, also by the logging thread, so it is advanced with a
+ * compare and swap and the flusher discards a record it lost the race for.
+ */
+class dlt_async_ring {
+    public:
+        /**
+         * @brief create ring
+         * 
+         * @param in size size in bytes, must be a power of 2
+         */
+        explicit dlt_async_ring(size_t size) :
+                            buf_(new uint8_t[size]),
+                            size_(size),
+                            closed_(false),
+                            head_(0),
+                            tail_(0),
+                            dropped_newest_(0),
+                            dropped_oldest_(0),
+                            blocked_(0)
+        { }
+        ~dlt_async_ring() { }
+
+        dlt_async_ring(const dlt_async_ring &) = delete;
+        const dlt_async_ring &operator=(const dlt_async_ring &) = delete;
+        dlt_async_ring(const dlt_async_ring &&) = delete;
+        const dlt_async_ring &&operator=(const dlt_async_ring &&) = delete;
+
+        /**
+         * @brief append a record, called from the logging thread
+         * 
+         * @param in data message
+         * @param in len length of the message
+         * @param in overflow what to do when the ring is full
+         * @return true if the record is queued
+         * @return false if it is dropped
+         */
+        bool push(const uint8_t *data, uint16_t len, dlt_async_overflow overflow)
+        {
+            uint64_t tail = tail_.load(std::memory_order_relaxed);
+            size_t off = tail & (size_ - 1);
+            size_t pad = (size_ - off < LEN_FIELD + len) ? size_ - off : 0;
+            size_t need = pad + LEN_FIELD + len;
+            bool waited = false;
+
+            if ((len >= PADDING) || (LEN_FIELD + len > size_)) {
+                dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            while (1) {
+                uint64_t head = head_.load(std::memory_order_acquire);
+
+                if (tail + need - head <= size_) {
+                    break;
+                }
+
+                switch (overflow) {
+                    case dlt_async_overflow::DROP_NEWEST:
+                        dropped_newest_.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                    case dlt_async_overflow::DROP_OLDEST:
+                        if (head_.compare_exchange_weak(head, head + record_size(head),
+                                                        std::memory_order_acq_rel)) {
+                            if (!is_padding(head)) {
+                                dropped_oldest_.fetch_add(1, std::memory_order_relaxed);
+                            }
+                        }
+                    break;
+                    case dlt_async_overflow::BLOCK:
+                        if (!waited) {
+                            blocked_.fetch_add(1, std::memory_order_relaxed);
+                            waited = true;
+                        }
+                        std::this_thread::yield();
+                    break;
+                }
+            }
+
+            if (pad >= LEN_FIELD) {
+                uint16_t marker = PADDING;
+                memcpy(buf_.get() + off, &marker, LEN_FIELD);
+            }
+            off = (tail + pad) & (size_ - 1);
+            memcpy(buf_.get() + off, &len, LEN_FIELD);
+            memcpy(buf_.get() + off + LEN_FIELD, data, len);
+
+            tail_.store(tail + need, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * @brief take the oldest record, called from the flusher
+         * 
+         * @param out data buffer for the message
+         * @param in size size of the buffer
+         * @return returns length of the message or -1 if the ring is empty
+         */
+        int pop(uint8_t *data, size_t size)
+        {
+            while (1) {
+                uint64_t head = head_.load(std::memory_order_acquire);
+                uint64_t rec;
+                uint16_t len;
+
+                if (head == tail_.load(std::memory_order_acquire)) {
+                    return -1;
+                }
+
+                if (is_padding(head)) {
+                    head_.compare_exchange_weak(head, head + record_size(head),
+                                                std::memory_order_acq_rel);
+                    continue;
+                }
+
+                memcpy(&len, buf_.get() + (head & (size_ - 1)), LEN_FIELD);
+                rec = LEN_FIELD + len;
+
+                // a record overwritten under us can read as garbage, the
+                // compare and swap below fails for it
+                if ((len > size) || (rec > size_ - (head & (size_ - 1)))) {
+                    continue;
+                }
+
+                memcpy(data, buf_.get() + (head & (size_ - 1)) + LEN_FIELD, len);
+
+                if (head_.compare_exchange_strong(head, head + rec,
+                                                  std::memory_order_acq_rel)) {
+                    return len;
+                }
+            }
+        }
+
+        inline bool empty()
+        {
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+        }
+
+        // set when the owning thread exits, the flusher frees the ring once drained
+        inline void close() { closed_ = true; }
+        inline bool is_closed() { return closed_; }
+
+        inline uint64_t get_dropped_newest() { return dropped_newest_.load(std::memory_order_relaxed); }
+        inline uint64_t get_dropped_oldest() { return dropped_oldest_.load(std::memory_order_relaxed); }
+        inline uint64_t get_blocked() { return blocked_.load(std::memory_order_relaxed); }
+
+    private:
+        static constexpr size_t LEN_FIELD = sizeof(uint16_t);
+        static constexpr uint16_t PADDING = 0xffff;
+
+        inline bool is_padding(uint64_t pos)
+        {
+            size_t off = pos & (size_ - 1);
+            uint16_t len;
+
+            if (size_ - off < LEN_FIELD) {
+                return true;
+            }
+
+            memcpy(&len, buf_.get() + off, LEN_FIELD);
+
+            return len == PADDING;
+        }
+
+        inline uint64_t record_size(uint64_t pos)
+        {
+            size_t off = pos & (size_ - 1);
+            uint16_t len;
+
+            if (is_padding(pos)) {
+                return size_ - off;
+            }
+
+            memcpy(&len, buf_.get() + off, LEN_FIELD);
+
+            return LEN_FIELD + len;
+        }
+
+        std::unique_ptr<uint8_t[]> buf_;
+        size_t size_;
+        std::atomic<bool> closed_;
+        alignas(64) std::atomic<uint64_t> head_;
+        alignas(64) std::atomic<uint64_t> tail_;
+        std::atomic<uint64_t> dropped_newest_;
+        std::atomic<uint64_t> dropped_oldest_;
+        std::atomic<uint64_t> blocked_;
+};
+
+}
+
+#endif
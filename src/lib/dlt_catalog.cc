@@ -0,0 +1,324 @@
+/**
+ * @file dlt_catalog.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief catalog of non verbose message formats
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ * 
+ */
+#include <string.h>
+#include <fstream>
+#include <jsoncpp/json/json.h>
+#include <dlt_args.h>
+#include <dlt_catalog.h>
+
+namespace auto_os::middleware {
+
+static const char *arg_type_names[] = {
+    "sint32",
+    "uint32",
+    "sint64",
+    "uint64",
+    "float64",
+    "string",
+};
+
+/**
+ * @brief find the next conversion in a format
+ * 
+ * @param in format format string
+ * @param in/out off start of the search, end of the conversion on return
+ * @param out start start of the conversion, at the '%'
+ * @param out type argument type of the conversion
+ * @return returns 1 if a conversion is found, 0 at the end of the format,
+ *         -1 on an unsupported conversion
+ */
+static int next_conversion(const std::string &format, size_t &off, size_t &start,
+                           dlt_nv_arg_type &type)
+{
+    while (off < format.length()) {
+        bool wide = false;
+
+        if (format[off] != '%') {
+            off ++;
+            continue;
+        }
+
+        start = off;
+        off ++;
+
+        if ((off < format.length()) && (format[off] == '%')) {
+            off ++;
+            continue;
+        }
+
+        // flags, width and precision, '*' would need an extra argument
+        while ((off < format.length()) && strchr("-+ #0123456789.", format[off])) {
+            off ++;
+        }
+
+        // length modifiers, anything longer than int is 64 bits
+        while ((off < format.length()) && strchr("hlzjt", format[off])) {
+            if (format[off] != 'h') {
+                wide = true;
+            }
+            off ++;
+        }
+
+        if (off == format.length()) {
+            return -1;
+        }
+
+        switch (format[off]) {
+            case 'd':
+            case 'i':
+                type = wide ? dlt_nv_arg_type::SINT64 : dlt_nv_arg_type::SINT32;
+            break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            case 'c':
+                type = wide ? dlt_nv_arg_type::UINT64 : dlt_nv_arg_type::UINT32;
+            break;
+            case 'p':
+                type = dlt_nv_arg_type::UINT64;
+            break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                type = dlt_nv_arg_type::FLOAT64;
+            break;
+            case 's':
+                type = dlt_nv_arg_type::STRING;
+            break;
+            default:
+                return -1;
+        }
+        off ++;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief append format text without conversions, '%%' becomes '%'
+ */
+static void append_literal(const std::string &format, size_t start, size_t end, std::string &out)
+{
+    size_t i;
+
+    for (i = start; i < end; i ++) {
+        out += format[i];
+        if ((format[i] == '%') && (i + 1 < end) && (format[i + 1] == '%')) {
+            i ++;
+        }
+    }
+}
+
+int dlt_catalog::parse_format(const std::string format, std::vector<dlt_nv_arg_type> &args)
+{
+    dlt_nv_arg_type type;
+    size_t start;
+    size_t off = 0;
+    int ret;
+
+    args.clear();
+    while ((ret = next_conversion(format, off, start, type)) == 1) {
+        args.push_back(type);
+    }
+
+    return ret;
+}
+
+int dlt_catalog::add(const std::string format, const std::string file, int line)
+{
+    dlt_catalog_entry entry;
+
+    entry.msg_id = dlt_msg_id(format.c_str());
+    entry.format = format;
+    entry.file = file;
+    entry.line = line;
+
+    if (parse_format(format, entry.args) < 0) {
+        return -1;
+    }
+
+    auto it = entries_.find(entry.msg_id);
+    if (it != entries_.end()) {
+        // the same format at several call sites shares one id
+        return it->second.format == format ? 0 : -1;
+    }
+
+    entries_[entry.msg_id] = entry;
+
+    return 0;
+}
+
+const dlt_catalog_entry *dlt_catalog::lookup(uint32_t msg_id)
+{
+    auto it = entries_.find(msg_id);
+
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+int dlt_catalog::load(const std::string file)
+{
+    Json::Value root;
+    std::ifstream in(file, std::ifstream::binary);
+
+    if (!in.is_open()) {
+        return -1;
+    }
+
+    try {
+        in >> root;
+    } catch (const std::exception &e) {
+        return -1;
+    }
+
+    for (auto &msg : root["messages"]) {
+        if (add(msg["format"].asString(), msg["file"].asString(), msg["line"].asInt()) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int dlt_catalog::save(const std::string file)
+{
+    Json::Value root;
+    Json::Value msgs(Json::arrayValue);
+    std::ofstream out(file, std::ofstream::binary);
+
+    if (!out.is_open()) {
+        return -1;
+    }
+
+    for (auto &it : entries_) {
+        Json::Value msg;
+        Json::Value args(Json::arrayValue);
+
+        msg["id"] = it.second.msg_id;
+        msg["format"] = it.second.format;
+        for (auto arg : it.second.args) {
+            args.append(arg_type_names[static_cast<int>(arg)]);
+        }
+        msg["args"] = args;
+        msg["file"] = it.second.file;
+        msg["line"] = it.second.line;
+        msgs.append(msg);
+    }
+    root["messages"] = msgs;
+
+    out << root;
+
+    return out.good() ? 0 : -1;
+}
+
+int dlt_catalog::expand(const uint8_t *payload, size_t payload_len, std::string &out)
+{
+    const dlt_catalog_entry *entry;
+    dlt_nv_arg_type type;
+    uint32_t msg_id;
+    size_t data_off = sizeof(msg_id);
+    size_t prev = 0;
+    size_t start;
+    size_t off = 0;
+    char buf[512];
+    int ret;
+
+    if (payload_len < sizeof(msg_id)) {
+        return -1;
+    }
+
+    memcpy(&msg_id, payload, sizeof(msg_id));
+    entry = lookup(msg_id);
+    if (!entry) {
+        return -1;
+    }
+
+    out.clear();
+
+    while ((ret = next_conversion(entry->format, off, start, type)) == 1) {
+        std::string spec = entry->format.substr(start, off - start);
+
+        append_literal(entry->format, prev, start, out);
+        prev = off;
+
+        switch (type) {
+            case dlt_nv_arg_type::SINT32:
+            case dlt_nv_arg_type::UINT32: {
+                uint32_t val;
+
+                if (data_off + sizeof(val) > payload_len) {
+                    return -1;
+                }
+                memcpy(&val, payload + data_off, sizeof(val));
+                data_off += sizeof(val);
+                snprintf(buf, sizeof(buf), spec.c_str(), val);
+            } break;
+            case dlt_nv_arg_type::SINT64:
+            case dlt_nv_arg_type::UINT64: {
+                uint64_t val;
+
+                if (data_off + sizeof(val) > payload_len) {
+                    return -1;
+                }
+                memcpy(&val, payload + data_off, sizeof(val));
+                data_off += sizeof(val);
+                snprintf(buf, sizeof(buf), spec.c_str(), val);
+            } break;
+            case dlt_nv_arg_type::FLOAT64: {
+                double val;
+
+                if (data_off + sizeof(val) > payload_len) {
+                    return -1;
+                }
+                memcpy(&val, payload + data_off, sizeof(val));
+                data_off += sizeof(val);
+                snprintf(buf, sizeof(buf), spec.c_str(), val);
+            } break;
+            case dlt_nv_arg_type::STRING: {
+                uint16_t len;
+
+                if (data_off + sizeof(len) > payload_len) {
+                    return -1;
+                }
+                memcpy(&len, payload + data_off, sizeof(len));
+                data_off += sizeof(len);
+                if (data_off + len > payload_len) {
+                    return -1;
+                }
+                std::string str((const char *)payload + data_off, len);
+                data_off += len;
+                snprintf(buf, sizeof(buf), spec.c_str(), str.c_str());
+            } break;
+        }
+        out += buf;
+    }
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    append_literal(entry->format, prev, entry->format.length(), out);
+
+    return 0;
+}
+
+}
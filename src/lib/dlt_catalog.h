@@ -0,0 +1,112 @@
+/**
+ * @file dlt_catalog.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief catalog of non verbose message formats
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ * 
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_CATALOG_H__
+#define __AUTO_MIDDLEWARE_DLT_CATALOG_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief packed value type of a non verbose argument
+ */
+enum class dlt_nv_arg_type {
+    SINT32,
+    UINT32,
+    SINT64,
+    UINT64,
+    FLOAT64,
+    STRING,
+};
+
+struct dlt_catalog_entry {
+    uint32_t msg_id;
+    std::string format;
+    std::vector<dlt_nv_arg_type> args;
+    // first call site using the format
+    std::string file;
+    int line;
+};
+
+/**
+ * @brief maps non verbose message ids to their format and argument types
+ */
+class dlt_catalog {
+    public:
+        explicit dlt_catalog() { }
+        ~dlt_catalog() { }
+
+        /**
+         * @brief load catalog file
+         * 
+         * @param in file catalog file written by save
+         * @return returns 0 on success -1 on failure
+         */
+        int load(const std::string file);
+
+        /**
+         * @brief write catalog file
+         * 
+         * @param in file catalog file
+         * @return returns 0 on success -1 on failure
+         */
+        int save(const std::string file);
+
+        /**
+         * @brief add format to the catalog
+         * 
+         * @param in format format string
+         * @param in file source file of the call site
+         * @param in line source line of the call site
+         * @return returns 0 on success, -1 if the format is not supported or
+         *         its id collides with a different format
+         */
+        int add(const std::string format, const std::string file, int line);
+
+        /**
+         * @brief find format by message id
+         * 
+         * @return returns entry or nullptr if unknown
+         */
+        const dlt_catalog_entry *lookup(uint32_t msg_id);
+
+        /**
+         * @brief render a non verbose payload as text
+         * 
+         * @param in payload message id followed by the packed arguments
+         * @param in payload_len length of the payload
+         * @param out out rendered text
+         * @return returns 0 on success -1 if the id is unknown or the
+         *         payload does not match the format
+         */
+        int expand(const uint8_t *payload, size_t payload_len, std::string &out);
+
+        /**
+         * @brief get argument types of a printf style format
+         * 
+         * @param in format format string
+         * @param out args argument types
+         * @return returns 0 on success -1 on unsupported conversions
+         */
+        static int parse_format(const std::string format, std::vector<dlt_nv_arg_type> &args);
+
+        inline size_t size() { return entries_.size(); }
+
+    private:
+        std::unordered_map<uint32_t, dlt_catalog_entry> entries_;
+};
+
+}
+
+#endif
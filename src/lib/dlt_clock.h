@@ -0,0 +1,158 @@
+/**
+ * @file dlt_clock.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief monotonic clock of the dlt timestamps, read from the tsc when it is reliable
+ * @version 0.1
+ * @date 2022-01-05
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ *
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_CLOCK_H__
+#define __AUTO_MIDDLEWARE_DLT_CLOCK_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace auto_os::middleware {
+
+// dlt timestamps count 0.1 ms
+#define DLT_CLOCK_TICK_NS 100000ULL
+
+// time the tsc is first measured against CLOCK_MONOTONIC
+#define DLT_CLOCK_CALIBRATE_NS 1000000ULL
+
+// cycles after which a thread reads CLOCK_MONOTONIC again, 0.1 to 0.3 s
+#define DLT_CLOCK_ANCHOR_CYCLES (1ULL << 28)
+
+#define DLT_CLOCK_SOURCE_PATH "/sys/devices/system/clocksource/clocksource0/current_clocksource"
+
+/**
+ * @brief CLOCK_MONOTONIC, the time since the ecu started
+ *
+ * reading CLOCK_MONOTONIC costs 20 to 50 ns, more than the rest of a
+ * logging call's bookkeeping. when the kernel itself keeps time with the
+ * tsc, the tsc is read instead and scaled to ns from a reference point
+ * each thread takes from CLOCK_MONOTONIC every DLT_CLOCK_ANCHOR_CYCLES.
+ * the scale is measured for 1 ms at startup and refined at every new
+ * reference, so threads agree with each other and with CLOCK_MONOTONIC
+ * to well within a timestamp tick. CLOCK_MONOTONIC_COARSE is cheaper
+ * still but only advances once per kernel tick, 1 to 10 ms.
+ */
+class dlt_clock {
+    public:
+        static dlt_clock *instance()
+        {
+            static dlt_clock clock;
+            return &clock;
+        }
+
+        dlt_clock(const dlt_clock &) = delete;
+        const dlt_clock &operator=(const dlt_clock &) = delete;
+        dlt_clock(const dlt_clock &&) = delete;
+        const dlt_clock &&operator=(const dlt_clock &&) = delete;
+
+        /**
+         * @brief current time as a dlt timestamp
+         *
+         * @return returns time since startup in 0.1 ms, wraps after 4.9 days
+         */
+        inline uint32_t now()
+        {
+            return now_ns() / DLT_CLOCK_TICK_NS;
+        }
+
+        inline uint64_t now_ns()
+        {
+#if defined(__x86_64__)
+            uint64_t mult = mult_.load(std::memory_order_relaxed);
+
+            if (mult > 0) {
+                static thread_local struct {
+                    uint64_t tsc;
+                    uint64_t ns;
+                } ref = {0, 0};
+                uint64_t cycles = __rdtsc() - ref.tsc;
+
+                if (cycles < DLT_CLOCK_ANCHOR_CYCLES) {
+                    return ref.ns + ((cycles * mult) >> 32);
+                }
+
+                ref.ns = monotonic_ns();
+                ref.tsc = __rdtsc();
+                refine(ref.tsc, ref.ns);
+
+                return ref.ns;
+            }
+#endif
+            return monotonic_ns();
+        }
+
+        /**
+         * @brief check if the tsc is used
+         */
+        inline bool is_tsc() { return mult_.load(std::memory_order_relaxed) > 0; }
+
+    private:
+        dlt_clock() : mult_(0), base_tsc_(0), base_ns_(0)
+        {
+#if defined(__x86_64__)
+            char source[32] = "";
+            FILE *fp = fopen(DLT_CLOCK_SOURCE_PATH, "r");
+
+            if (fp) {
+                if (!fgets(source, sizeof(source), fp)) {
+                    source[0] = '\0';
+                }
+                fclose(fp);
+            }
+
+            // the kernel falls back to another clocksource when the tsc
+            // is not constant or not synchronized between cpus
+            if (strncmp(source, "tsc", 3) != 0) {
+                return;
+            }
+
+            uint64_t end;
+
+            base_ns_ = monotonic_ns();
+            base_tsc_ = __rdtsc();
+            while ((end = monotonic_ns()) - base_ns_ < DLT_CLOCK_CALIBRATE_NS) { }
+            refine(__rdtsc(), end);
+#endif
+        }
+
+        static inline uint64_t monotonic_ns()
+        {
+            struct timespec ts;
+
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        }
+
+        /**
+         * @brief measure the ns per cycle over the whole time since startup
+         */
+        inline void refine(uint64_t tsc, uint64_t ns)
+        {
+            if (tsc > base_tsc_) {
+                mult_.store((uint64_t)(((unsigned __int128)(ns - base_ns_) << 32) / (tsc - base_tsc_)),
+                            std::memory_order_relaxed);
+            }
+        }
+
+        // ns per cycle in 32.32 fixed point, 0 if the tsc is not used
+        std::atomic<uint64_t> mult_;
+        uint64_t base_tsc_;
+        uint64_t base_ns_;
+};
+
+}
+
+#endif
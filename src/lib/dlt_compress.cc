@@ -0,0 +1,345 @@
+/**
+ * @file dlt_compress.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief compressed blocks of encoded dlt messages
+ * @version 0.1
+ * @date 2021-12-30
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#ifdef DLT_HAVE_LZ4
+#include <lz4.h>
+#endif
+#include <dlt_compress.h>
+
+namespace auto_os::middleware {
+
+#define DLT_LZ4_HASH_LOG 12
+#define DLT_LZ4_MIN_MATCH 4
+#define DLT_LZ4_MAX_OFFSET 65535
+// the last match starts at least this far from the end
+#define DLT_LZ4_MF_LIMIT 12
+// the last bytes are always literals
+#define DLT_LZ4_LAST_LITERALS 5
+// lz4 positions are kept in 32 bits
+#define DLT_LZ4_MAX_INPUT 0x7e000000
+
+// liblz4 is used to compress where it is installed. decompression always
+// uses the decoder below, LZ4_decompress_safe accepts a match offset of 0
+// and would copy stale output bytes into the frames
+#ifdef DLT_HAVE_LZ4
+
+int dlt_lz4::compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_size)
+{
+    int ret;
+
+    if (len > DLT_LZ4_MAX_INPUT) {
+        return -1;
+    }
+
+    ret = LZ4_compress_default((const char *)src, (char *)dst, len, std::min(dst_size, (size_t)INT_MAX));
+    return ret > 0 ? ret : -1;
+}
+
+#else
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash4(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - DLT_LZ4_HASH_LOG);
+}
+
+static inline uint8_t *write_len(uint8_t *op, size_t len)
+{
+    while (len >= 255) {
+        *op ++ = 255;
+        len -= 255;
+    }
+    *op ++ = len;
+
+    return op;
+}
+
+int dlt_lz4::compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_size)
+{
+    uint32_t table[1 << DLT_LZ4_HASH_LOG];
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_size;
+    size_t lit;
+
+    if (len > DLT_LZ4_MAX_INPUT) {
+        return -1;
+    }
+
+    memset(table, 0, sizeof(table));
+
+    if (len > DLT_LZ4_MF_LIMIT) {
+        // only valid positions for inputs longer than the limit
+        const uint8_t *mf_limit = end - DLT_LZ4_MF_LIMIT;
+        const uint8_t *match_limit = end - DLT_LZ4_LAST_LITERALS;
+        uint32_t misses = 0;
+
+        while (ip < mf_limit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash4(seq);
+            const uint8_t *ref = src + table[h];
+            const uint8_t *mp;
+            const uint8_t *rp;
+            uint8_t *token;
+            size_t ml;
+
+            table[h] = ip - src;
+            if ((ref >= ip) || (ip - ref > DLT_LZ4_MAX_OFFSET) || (read32(ref) != seq)) {
+                // step over incompressible data faster
+                ip += 1 + (misses ++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            while ((ip > anchor) && (ref > src) && (ip[-1] == ref[-1])) {
+                ip --;
+                ref --;
+            }
+
+            mp = ip + DLT_LZ4_MIN_MATCH;
+            rp = ref + DLT_LZ4_MIN_MATCH;
+            while (mp + 8 <= match_limit) {
+                uint64_t diff = read64(mp) ^ read64(rp);
+
+                if (diff) {
+                    mp += __builtin_ctzll(diff) >> 3;
+                    goto found;
+                }
+                mp += 8;
+                rp += 8;
+            }
+            while ((mp < match_limit) && (*mp == *rp)) {
+                mp ++;
+                rp ++;
+            }
+found:
+            lit = ip - anchor;
+            ml = mp - ip - DLT_LZ4_MIN_MATCH;
+            if (op + 1 + lit / 255 + 1 + lit + 2 + ml / 255 + 1 > oend) {
+                return -1;
+            }
+
+            token = op ++;
+            if (lit >= 15) {
+                *token = 15 << 4;
+                op = write_len(op, lit - 15);
+            } else {
+                *token = lit << 4;
+            }
+            memcpy(op, anchor, lit);
+            op += lit;
+
+            *op ++ = (ip - ref) & 0xff;
+            *op ++ = (ip - ref) >> 8;
+
+            if (ml >= 15) {
+                *token |= 15;
+                op = write_len(op, ml - 15);
+            } else {
+                *token |= ml;
+            }
+
+            ip = mp;
+            anchor = ip;
+            if (ip < mf_limit) {
+                table[hash4(read32(ip - 2))] = ip - 2 - src;
+            }
+        }
+    }
+
+    lit = end - anchor;
+    if (op + 1 + lit / 255 + 1 + lit > oend) {
+        return -1;
+    }
+    if (lit >= 15) {
+        *op ++ = 15 << 4;
+        op = write_len(op, lit - 15);
+    } else {
+        *op ++ = lit << 4;
+    }
+    memcpy(op, anchor, lit);
+    op += lit;
+
+    return op - dst;
+}
+
+#endif
+
+int dlt_lz4::decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + len;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_size;
+
+    while (ip < iend) {
+        uint8_t token = *ip ++;
+        size_t lit = token >> 4;
+        size_t ml = token & 0x0f;
+        size_t off;
+        uint8_t b;
+
+        if (lit == 15) {
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip ++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (((size_t)(iend - ip) < lit) || ((size_t)(oend - op) < lit)) {
+            return -1;
+        }
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+
+        // the last sequence has no match
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ((off == 0) || (off > (size_t)(op - dst))) {
+            return -1;
+        }
+
+        if (ml == 15) {
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip ++;
+                ml += b;
+            } while (b == 255);
+        }
+        ml += DLT_LZ4_MIN_MATCH;
+        if ((size_t)(oend - op) < ml) {
+            return -1;
+        }
+
+        const uint8_t *match = op - off;
+
+        if (off >= ml) {
+            memcpy(op, match, ml);
+            op += ml;
+        } else {
+            // overlapping copy repeats the last off bytes
+            while (ml --) {
+                *op ++ = *match ++;
+            }
+        }
+    }
+
+    return op - dst;
+}
+
+bool dlt_block::is_block(const uint8_t *buff, size_t len)
+{
+    return (len >= DLT_BLOCK_MAGIC_LEN) && (memcmp(buff, DLT_BLOCK_MAGIC, DLT_BLOCK_MAGIC_LEN) == 0);
+}
+
+int dlt_block::encode(const uint8_t *raw, size_t raw_len, bool storage_hdr, uint8_t *out, size_t out_size)
+{
+    dlt_block_hdr hdr;
+    int ret;
+
+    if ((raw_len > DLT_BLOCK_MAX_RAW_LEN) || (out_size < DLT_BLOCK_HDR_LEN)) {
+        return -1;
+    }
+
+    memcpy(hdr.magic, DLT_BLOCK_MAGIC, DLT_BLOCK_MAGIC_LEN);
+    hdr.codec = DLT_BLOCK_CODEC_LZ4;
+    hdr.flags = storage_hdr ? DLT_BLOCK_FLAG_STORAGE_HDR : 0;
+    hdr.reserved = 0;
+    hdr.raw_len = raw_len;
+
+    // smaller than the input or the data is stored as is
+    ret = dlt_lz4::compress(raw, raw_len, out + DLT_BLOCK_HDR_LEN,
+                            std::min(out_size - DLT_BLOCK_HDR_LEN, raw_len));
+    if (ret < 0) {
+        if (out_size - DLT_BLOCK_HDR_LEN < raw_len) {
+            return -1;
+        }
+        hdr.codec = DLT_BLOCK_CODEC_NONE;
+        memcpy(out + DLT_BLOCK_HDR_LEN, raw, raw_len);
+        ret = raw_len;
+    }
+    hdr.data_len = ret;
+    memcpy(out, &hdr, sizeof(hdr));
+
+    return DLT_BLOCK_HDR_LEN + ret;
+}
+
+int dlt_block::parse(const uint8_t *buff, size_t len, dlt_block_hdr &hdr, size_t &need)
+{
+    need = DLT_BLOCK_HDR_LEN;
+    if (len < need) {
+        return 0;
+    }
+
+    memcpy(&hdr, buff, sizeof(hdr));
+    if ((memcmp(hdr.magic, DLT_BLOCK_MAGIC, DLT_BLOCK_MAGIC_LEN) != 0) ||
+        (hdr.raw_len > DLT_BLOCK_MAX_RAW_LEN) ||
+        ((hdr.codec == DLT_BLOCK_CODEC_NONE) && (hdr.data_len != hdr.raw_len)) ||
+        ((hdr.codec == DLT_BLOCK_CODEC_LZ4) && (hdr.data_len > dlt_lz4::bound(hdr.raw_len))) ||
+        (hdr.codec > DLT_BLOCK_CODEC_LZ4)) {
+        return -1;
+    }
+
+    need = DLT_BLOCK_HDR_LEN + hdr.data_len;
+    if (len < need) {
+        return 0;
+    }
+
+    return need;
+}
+
+int dlt_block::decode(const uint8_t *buff, const dlt_block_hdr &hdr, uint8_t *raw)
+{
+    const uint8_t *data = buff + DLT_BLOCK_HDR_LEN;
+
+    if (hdr.codec == DLT_BLOCK_CODEC_NONE) {
+        memcpy(raw, data, hdr.raw_len);
+        return hdr.raw_len;
+    }
+
+    if (dlt_lz4::decompress(data, hdr.data_len, raw, hdr.raw_len) != (int)hdr.raw_len) {
+        return -1;
+    }
+
+    return hdr.raw_len;
+}
+
+}
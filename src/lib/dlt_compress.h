@@ -0,0 +1,143 @@
+/**
+ * @file dlt_compress.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief compressed blocks of encoded dlt messages
+ * @version 0.1
+ * @date 2021-12-30
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_COMPRESS_H__
+#define __AUTO_MIDDLEWARE_DLT_COMPRESS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace auto_os::middleware {
+
+// 'D' as the first byte of a dlt frame would be header version 2, so a
+// block never looks like a frame, and in a file it differs from the
+// storage header pattern "DLT\x01"
+#define DLT_BLOCK_MAGIC "DLZ\x01"
+#define DLT_BLOCK_MAGIC_LEN 4
+#define DLT_BLOCK_HDR_LEN 16
+
+// largest uncompressed block accepted by the decoder
+#define DLT_BLOCK_MAX_RAW_LEN (16 * 1024 * 1024)
+
+#define DLT_BLOCK_CODEC_NONE 0
+// lz4 block format
+#define DLT_BLOCK_CODEC_LZ4 1
+
+// frames in the block carry a storage header
+#define DLT_BLOCK_FLAG_STORAGE_HDR 0x01
+
+/**
+ * @brief block header, little endian like the storage header
+ */
+struct dlt_block_hdr {
+    char magic[4];
+    uint8_t codec;
+    uint8_t flags;
+    uint16_t reserved;
+    // length of the frames after decompression
+    uint32_t raw_len;
+    // length of the data following the header
+    uint32_t data_len;
+} __attribute__ ((__packed__));
+
+/**
+ * @brief lz4 block format compressor
+ *
+ * Greedy single probe matching with a 4K entry hash table, output is
+ * readable by any lz4 block decoder. Built with DLT_HAVE_LZ4 compress
+ * uses liblz4 instead, decompress is the same in both builds.
+ */
+class dlt_lz4 {
+    public:
+        /**
+         * @brief largest output for an input of len bytes
+         */
+        static inline size_t bound(size_t len) { return len + len / 255 + 16; }
+
+        /**
+         * @brief compress a buffer
+         *
+         * @param in src data
+         * @param in len length of the data
+         * @param out dst output buffer
+         * @param in dst_size size of the output buffer
+         * @return returns compressed length or -1 if it does not fit
+         */
+        static int compress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_size);
+
+        /**
+         * @brief decompress a buffer
+         *
+         * @param in src compressed data
+         * @param in len length of the compressed data
+         * @param out dst output buffer
+         * @param in dst_size size of the output buffer
+         * @return returns decompressed length or -1 if the data is malformed
+         *         or does not fit
+         */
+        static int decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_size);
+};
+
+/**
+ * @brief a run of encoded frames compressed as one unit
+ *
+ * A block is written where a frame would be, in a storage file or a
+ * datagram, and dlt_decoder returns its frames like uncompressed ones.
+ */
+class dlt_block {
+    public:
+        /**
+         * @brief largest block for raw_len bytes of frames
+         */
+        static inline size_t bound(size_t raw_len) { return DLT_BLOCK_HDR_LEN + dlt_lz4::bound(raw_len); }
+
+        /**
+         * @brief check for the block magic
+         */
+        static bool is_block(const uint8_t *buff, size_t len);
+
+        /**
+         * @brief compress frames into a block
+         *
+         * frames that do not compress are stored as they are.
+         *
+         * @param in raw frames
+         * @param in raw_len length of the frames
+         * @param in storage_hdr frames carry a storage header
+         * @param out out block, at least bound(raw_len) bytes
+         * @param in out_size size of out
+         * @return returns block length or -1 on failure
+         */
+        static int encode(const uint8_t *raw, size_t raw_len, bool storage_hdr, uint8_t *out, size_t out_size);
+
+        /**
+         * @brief validate a block header
+         *
+         * @param in buff buffer starting with a block
+         * @param in len length of the buffer
+         * @param out hdr block header
+         * @param out need total bytes needed if the block is incomplete
+         * @return returns block length, 0 if incomplete, -1 if malformed
+         */
+        static int parse(const uint8_t *buff, size_t len, dlt_block_hdr &hdr, size_t &need);
+
+        /**
+         * @brief decompress a complete block
+         *
+         * @param in buff block
+         * @param in hdr header returned by parse
+         * @param out raw output, at least hdr.raw_len bytes
+         * @return returns raw length or -1 if the block is malformed
+         */
+        static int decode(const uint8_t *buff, const dlt_block_hdr &hdr, uint8_t *raw);
+};
+
+}
+
+#endif
@@ -15,6 +15,7 @@
 #include <memory>
 #include <auto_lib.h>
 #include <dlt_enc_dec.h>
+#include <dlt_compress.h>
 
 namespace auto_os::middleware {
 
@@ -53,13 +54,22 @@ int dlt_header::encode(uint8_t *payload, uint16_t payload_len, uint8_t *buff, si
      */
 
     uint16_t len;
+    int frame_len;
 
-    memset(buff, 0, buff_size);
+    // strings are sent with the null terminator
+    if (msg_type_info == DLT_MSG_TYPEINFO_STRG) {
+        frame_len = get_length(payload_len + 1);
+    } else {
+        frame_len = get_length(payload_len);
+    }
+    if ((frame_len < 0) || ((size_t)frame_len > buff_size - off)) {
+        return -1;
+    }
 
     SET_BYTE(std_hdr.header_type, buff, off);
     SET_BYTE(std_hdr.msg_counter, buff, off);
 
-    len = auto_os::lib::bswap16b(get_length(payload_len + 1));
+    len = auto_os::lib::bswap16b(frame_len);
     SET_BYTES(len, 2, buff, off);
 
     if (std_hdr.has_ecu_id()) {
@@ -69,7 +79,9 @@ int dlt_header::encode(uint8_t *payload, uint16_t payload_len, uint8_t *buff, si
         COPY_BYTES(std_hdr.session_id, 4, buff, off);
     }
     if (std_hdr.has_timestamp()) {
-        SET_BYTES(std_hdr.timestamp, 4, buff, off);
+        uint32_t timestamp = auto_os::lib::bswap32b(std_hdr.timestamp);
+
+        SET_BYTES(timestamp, 4, buff, off);
     }
 
     // encode ext header
@@ -77,8 +89,12 @@ int dlt_header::encode(uint8_t *payload, uint16_t payload_len, uint8_t *buff, si
         SET_BYTE(ext_hdr.message_info, buff, off);
 
         if (ext_hdr.has_verbose()) {
-            // set number of args - 1 for now
-            SET_BYTE(1, buff, off);
+            // a string is one argument, preencoded arguments carry their count
+            if (msg_type_info == DLT_MSG_TYPEINFO_ARGS) {
+                SET_BYTE(ext_hdr.number_of_args, buff, off);
+            } else {
+                SET_BYTE(1, buff, off);
+            }
         } else {
             // no of args are 0
             SET_BYTE(0, buff, off);
@@ -96,6 +112,10 @@ int dlt_header::encode(uint8_t *payload, uint16_t payload_len, uint8_t *buff, si
             typeinfo |= DLT_MSG_TYPEINFO_STR_VAL_BITS;
             payload_len_total = payload_len + 1;
         break;
+        case DLT_MSG_TYPEINFO_ARGS:
+            // arguments are already encoded
+            COPY_BYTES(payload, payload_len, buff, off);
+        return off;
         default:
             return -1;
     }
@@ -107,14 +127,614 @@ int dlt_header::encode(uint8_t *payload, uint16_t payload_len, uint8_t *buff, si
     SET_BYTES(payload_len_total, 2, buff, off);
 
     COPY_BYTES(payload, payload_len, buff, off);
-    off ++;
+    SET_BYTE(0, buff, off);
 
     return off;
 }
 
+int dlt_header_template::init(dlt_header &h)
+{
+    // room for the largest header and the null of the empty string
+    uint8_t buf[DLT_HDR_MAX_LEN + 1];
+    uint8_t payload = 0;
+    size_t off = 0;
+    int ret;
+
+    if (h.msg_type_info != DLT_MSG_TYPEINFO_STRG) {
+        return -1;
+    }
+
+    // encode an empty string once, the trailing null is not part of the template
+    ret = h.encode(&payload, 0, buf, sizeof(buf), off);
+    if ((ret < 1) || (ret - 1 > (int)sizeof(hdr))) {
+        return -1;
+    }
+    hdr_len = ret - 1;
+    memcpy(hdr, buf, hdr_len);
+    base_len = hdr_len - DLT_ARG_TYPEINFO_LEN - DLT_ARG_STRG_LEN_LEN;
+
+    // walk the header in the same order as dlt_header::encode
+    off = DLT_STD_HDR_HTYPE_LEN + DLT_STD_HDR_MSG_COUNTER_LEN;
+    length_off = off;
+    off += DLT_STD_HDR_LENGTH_LEN;
+
+    if (h.std_hdr.has_ecu_id()) {
+        off += DLT_STD_HDR_ECU_ID_LEN;
+    }
+    session_id_off = -1;
+    if (h.std_hdr.has_session_id()) {
+        session_id_off = off;
+        off += DLT_STD_HDR_SESSION_ID_LEN;
+    }
+    timestamp_off = -1;
+    if (h.std_hdr.has_timestamp()) {
+        timestamp_off = off;
+        off += DLT_STD_HDR_TIMESTAMP_LEN;
+    }
+    msg_info_off = noar_off = app_id_off = ctx_id_off = -1;
+    if (h.std_hdr.has_ext_hdr()) {
+        msg_info_off = off;
+        off += DLT_EXT_HDR_MSIN_LEN;
+        noar_off = off;
+        off += DLT_EXT_HDR_NO_ARGS_LEN;
+        app_id_off = off;
+        off += DLT_EXT_HDR_APP_ID_LEN;
+        ctx_id_off = off;
+        off += DLT_EXT_HDR_CTX_ID_LEN;
+    }
+    off += DLT_ARG_TYPEINFO_LEN;
+    arg_len_off = off;
+
+    return 0;
+}
+
+static inline uint16_t get_u16(const uint8_t *p, bool msb_first)
+{
+    if (msb_first) {
+        return (p[0] << 8) | p[1];
+    }
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t *p, bool msb_first)
+{
+    if (msb_first) {
+        return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t get_uint(const uint8_t *p, int len, bool msb_first)
+{
+    uint64_t val = 0;
+    int i;
+
+    for (i = 0; i < len; i ++) {
+        int idx = msb_first ? i : (len - 1 - i);
+        val = (val << 8) | p[idx];
+    }
+
+    return val;
+}
+
+int dlt_decoder::parse(const uint8_t *buff, size_t len, bool storage_hdr,
+                       dlt_msg_view &msg, size_t &need)
+{
+    size_t off = 0;
+    size_t hdr_len;
+    size_t frame_off;
+
+    need = (storage_hdr ? DLT_STORAGE_HDR_LEN : 0) + DLT_STD_HDR_MIN_LEN;
+    if (len < need) {
+        return 0;
+    }
+
+    msg.storage_sec = 0;
+    msg.storage_usec = 0;
+    msg.storage_ecu_id = nullptr;
+
+    if (storage_hdr) {
+        if (memcmp(buff, DLT_STORAGE_HDR_PATTERN, DLT_STORAGE_HDR_PATTERN_LEN) != 0) {
+            return -1;
+        }
+        msg.storage_sec = get_u32(buff + 4, false);
+        msg.storage_usec = get_u32(buff + 8, false);
+        msg.storage_ecu_id = buff + 12;
+        off = DLT_STORAGE_HDR_LEN;
+    }
+
+    frame_off = off;
+    msg.header_type = buff[off];
+    msg.msg_counter = buff[off + 1];
+    // standard header fields are always big endian
+    msg.length = get_u16(buff + off + 2, true);
+
+    if (((msg.header_type >> 5) & 0x07) != DLT_HDR_VERSION) {
+        return -1;
+    }
+
+    hdr_len = DLT_STD_HDR_MIN_LEN;
+    if (msg.header_type & DLT_HDR_TYPE_WITH_ECU_ID) {
+        hdr_len += DLT_STD_HDR_ECU_ID_LEN;
+    }
+    if (msg.header_type & DLT_HDR_TYPE_WITH_SESSION_ID) {
+        hdr_len += DLT_STD_HDR_SESSION_ID_LEN;
+    }
+    if (msg.header_type & DLT_HDR_TYPE_WITH_TIMESTAMP) {
+        hdr_len += DLT_STD_HDR_TIMESTAMP_LEN;
+    }
+    msg.has_ext_hdr = !!(msg.header_type & DLT_HDR_TYPE_USE_EXT_HEADER);
+    if (msg.has_ext_hdr) {
+        hdr_len += DLT_EXT_HDR_LEN;
+    }
+
+    if (msg.length < hdr_len) {
+        return -1;
+    }
+
+    need = frame_off + msg.length;
+    if (len < need) {
+        return 0;
+    }
+
+    off += DLT_STD_HDR_MIN_LEN;
+
+    msg.ecu_id = nullptr;
+    if (msg.header_type & DLT_HDR_TYPE_WITH_ECU_ID) {
+        msg.ecu_id = buff + off;
+        off += DLT_STD_HDR_ECU_ID_LEN;
+    }
+    msg.session_id = nullptr;
+    if (msg.header_type & DLT_HDR_TYPE_WITH_SESSION_ID) {
+        msg.session_id = buff + off;
+        off += DLT_STD_HDR_SESSION_ID_LEN;
+    }
+    msg.timestamp = 0;
+    if (msg.header_type & DLT_HDR_TYPE_WITH_TIMESTAMP) {
+        msg.timestamp = get_u32(buff + off, true);
+        off += DLT_STD_HDR_TIMESTAMP_LEN;
+    }
+
+    msg.message_info = 0;
+    msg.number_of_args = 0;
+    msg.app_id = nullptr;
+    msg.ctx_id = nullptr;
+    if (msg.has_ext_hdr) {
+        msg.message_info = buff[off];
+        msg.number_of_args = buff[off + 1];
+        msg.app_id = buff + off + 2;
+        msg.ctx_id = buff + off + 6;
+        off += DLT_EXT_HDR_LEN;
+    }
+
+    msg.payload = buff + off;
+    msg.payload_len = msg.length - hdr_len;
+
+    return need;
+}
+
+uint32_t dlt_msg_view::get_message_id()
+{
+    if (payload_len < 4) {
+        return 0;
+    }
+
+    return get_u32(payload, is_msb_first());
+}
+
+dlt_decoder::dlt_decoder(bool storage_hdr) :
+                    storage_hdr_(storage_hdr),
+                    in_(nullptr),
+                    in_len_(0),
+                    in_off_(0),
+                    carry_done_(false),
+                    block_len_(0),
+                    block_off_(0),
+                    block_storage_hdr_(false),
+                    errors_(0)
+{
+}
+
+void dlt_decoder::feed(const uint8_t *data, size_t len)
+{
+    in_ = data;
+    in_len_ = len;
+    in_off_ = 0;
+}
+
+size_t dlt_decoder::resync(const uint8_t *buff, size_t len)
+{
+    const uint8_t *end = buff + len;
+    const uint8_t *p = buff + 1;
+    const void *pos;
+
+    errors_ ++;
+
+    if (!storage_hdr_ || len <= 1) {
+        return len > 0 ? 1 : 0;
+    }
+
+    // in a file every frame starts with the storage header pattern or the
+    // block magic, both "DL?\x01"
+    while ((pos = memmem(p, end - p, "DL", 2)) != nullptr) {
+        p = (const uint8_t *)pos;
+        // keep a possible partial pattern at the end
+        if ((end - p < DLT_STORAGE_HDR_PATTERN_LEN) ||
+            (((p[2] == DLT_STORAGE_HDR_PATTERN[2]) || (p[2] == DLT_BLOCK_MAGIC[2])) && (p[3] == 0x01))) {
+            return p - buff;
+        }
+        p ++;
+    }
+
+    return end[-1] == 'D' ? len - 1 : len;
+}
+
+int dlt_decoder::parse_frame(const uint8_t *buff, size_t len, dlt_msg_view &msg, size_t &need, bool &is_msg)
+{
+    dlt_block_hdr hdr;
+    int ret;
+
+    is_msg = true;
+    if (!dlt_block::is_block(buff, len)) {
+        return parse(buff, len, storage_hdr_, msg, need);
+    }
+
+    is_msg = false;
+    ret = dlt_block::parse(buff, len, hdr, need);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    if (block_.size() < hdr.raw_len) {
+        block_.resize(hdr.raw_len);
+    }
+    if (dlt_block::decode(buff, hdr, block_.data()) < 0) {
+        return -1;
+    }
+    block_len_ = hdr.raw_len;
+    block_off_ = 0;
+    block_storage_hdr_ = !!(hdr.flags & DLT_BLOCK_FLAG_STORAGE_HDR);
+
+    return ret;
+}
+
+bool dlt_decoder::next_block_frame(dlt_msg_view &msg)
+{
+    size_t need;
+    int ret;
+
+    if (block_off_ >= block_len_) {
+        return false;
+    }
+
+    ret = parse(block_.data() + block_off_, block_len_ - block_off_, block_storage_hdr_, msg, need);
+    if (ret <= 0) {
+        // a block holds whole frames, the rest of it is unusable
+        errors_ ++;
+        block_off_ = block_len_;
+        return false;
+    }
+    block_off_ += ret;
+
+    return true;
+}
+
+int dlt_decoder::next(dlt_msg_view &msg)
+{
+    size_t need;
+    bool is_msg;
+    int ret;
+
+    if (carry_done_) {
+        carry_.clear();
+        carry_done_ = false;
+    }
+
+    while (1) {
+        if (next_block_frame(msg)) {
+            return 1;
+        }
+
+        // finish the frame split across the previous buffer and this one
+        if (!carry_.empty()) {
+            ret = parse_frame(carry_.data(), carry_.size(), msg, need, is_msg);
+            if (ret > 0) {
+                if (!is_msg) {
+                    // the block was copied out, its frames come next
+                    carry_.clear();
+                    continue;
+                }
+                // frame is complete, the view points into carry_
+                carry_done_ = true;
+                return 1;
+            }
+            if (ret < 0) {
+                carry_.erase(carry_.begin(), carry_.begin() + resync(carry_.data(), carry_.size()));
+                continue;
+            }
+
+            size_t take = std::min(need - carry_.size(), in_len_ - in_off_);
+            carry_.insert(carry_.end(), in_ + in_off_, in_ + in_off_ + take);
+            in_off_ += take;
+
+            if (carry_.size() < need) {
+                return 0;
+            }
+            continue;
+        }
+
+        if (in_off_ >= in_len_) {
+            return 0;
+        }
+
+        ret = parse_frame(in_ + in_off_, in_len_ - in_off_, msg, need, is_msg);
+        if (ret > 0) {
+            in_off_ += ret;
+            if (is_msg) {
+                return 1;
+            }
+            continue;
+        }
+        if (ret == 0) {
+            // keep the partial frame for the next feed
+            carry_.assign(in_ + in_off_, in_ + in_len_);
+            in_off_ = in_len_;
+            return 0;
+        }
+        in_off_ += resync(in_ + in_off_, in_len_ - in_off_);
+    }
+}
+
+int dlt_arg_view::type_len(uint32_t type_info)
+{
+    switch (type_info & DLT_TYPEINFO_TYLE_MASK) {
+        case 1:
+            return 1;
+        case 2:
+            return 2;
+        case 3:
+            return 4;
+        case 4:
+            return 8;
+        case 5:
+            return 16;
+        default:
+            return -1;
+    }
+}
+
+uint64_t dlt_arg_view::as_uint()
+{
+    if (data_len > 8) {
+        return 0;
+    }
+
+    return get_uint(data, data_len, msb_first);
+}
+
+int64_t dlt_arg_view::as_int()
+{
+    uint64_t val = as_uint();
+    int shift;
+
+    if (data_len == 0 || data_len >= 8) {
+        return (int64_t)val;
+    }
+
+    // sign extend
+    shift = 64 - (data_len * 8);
+    return ((int64_t)(val << shift)) >> shift;
+}
+
+double dlt_arg_view::as_float()
+{
+    uint64_t val = as_uint();
+
+    if (data_len == 4) {
+        uint32_t bits = val;
+        float f;
+
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    } else if (data_len == 8) {
+        double d;
+
+        memcpy(&d, &val, sizeof(d));
+        return d;
+    }
+
+    return 0;
+}
+
+dlt_arg_reader::dlt_arg_reader(const dlt_msg_view &msg) :
+                    payload_(msg.payload),
+                    len_(msg.payload_len),
+                    off_(0),
+                    msb_first_(!!(msg.header_type & DLT_HDR_TYPE_MSB_FIRST))
+{
+}
+
+#define ARG_NEED(__len) {\
+    if ((uint64_t)(len_ - off_) < (uint64_t)(__len)) {\
+        return -1;\
+    }\
+}
+
+int dlt_arg_reader::next(dlt_arg_view &arg)
+{
+    uint32_t type_info;
+    uint16_t len;
+    int tyle;
+
+    if (off_ == len_) {
+        return 0;
+    }
+
+    memset(&arg, 0, sizeof(arg));
+    arg.msb_first = msb_first_;
+
+    ARG_NEED(DLT_ARG_TYPEINFO_LEN);
+    type_info = get_u32(payload_ + off_, msb_first_);
+    off_ += DLT_ARG_TYPEINFO_LEN;
+    arg.type_info = type_info;
+
+    if (type_info & (DLT_TYPEINFO_STRG | DLT_TYPEINFO_RAWD | DLT_TYPEINFO_TRAI)) {
+        ARG_NEED(2);
+        len = get_u16(payload_ + off_, msb_first_);
+        off_ += 2;
+
+        if ((type_info & DLT_TYPEINFO_VARI) && !(type_info & DLT_TYPEINFO_TRAI)) {
+            ARG_NEED(2);
+            arg.name_len = get_u16(payload_ + off_, msb_first_);
+            off_ += 2;
+            ARG_NEED(arg.name_len);
+            arg.name = (const char *)payload_ + off_;
+            off_ += arg.name_len;
+        }
+
+        ARG_NEED(len);
+        arg.data = payload_ + off_;
+        arg.data_len = len;
+        off_ += len;
+
+        return 1;
+    }
+
+    if (type_info & DLT_TYPEINFO_STRU) {
+        // the entries follow as ordinary arguments
+        ARG_NEED(2);
+        arg.n_dims = get_u16(payload_ + off_, msb_first_);
+        off_ += 2;
+        if (type_info & DLT_TYPEINFO_VARI) {
+            ARG_NEED(2);
+            arg.name_len = get_u16(payload_ + off_, msb_first_);
+            off_ += 2;
+            ARG_NEED(arg.name_len);
+            arg.name = (const char *)payload_ + off_;
+            off_ += arg.name_len;
+        }
+        return 1;
+    }
+
+    if (!(type_info & (DLT_TYPEINFO_BOOL | DLT_TYPEINFO_SINT |
+                       DLT_TYPEINFO_UINT | DLT_TYPEINFO_FLOA))) {
+        return -1;
+    }
+
+    tyle = dlt_arg_view::type_len(type_info);
+    if (tyle < 0) {
+        return -1;
+    }
+
+    uint64_t n_elems = 1;
+
+    if (type_info & DLT_TYPEINFO_ARAY) {
+        ARG_NEED(2);
+        arg.n_dims = get_u16(payload_ + off_, msb_first_);
+        off_ += 2;
+        ARG_NEED(arg.n_dims * 2);
+        arg.dims = payload_ + off_;
+        for (int i = 0; i < arg.n_dims; i ++) {
+            n_elems *= get_u16(payload_ + off_, msb_first_);
+            off_ += 2;
+            // stop before the product can wrap, it cannot fit anyway
+            ARG_NEED(n_elems);
+        }
+    }
+
+    if (type_info & DLT_TYPEINFO_VARI) {
+        uint16_t unit_len = 0;
+
+        ARG_NEED(2);
+        arg.name_len = get_u16(payload_ + off_, msb_first_);
+        off_ += 2;
+        if (!(type_info & DLT_TYPEINFO_BOOL)) {
+            ARG_NEED(2);
+            unit_len = get_u16(payload_ + off_, msb_first_);
+            off_ += 2;
+        }
+        ARG_NEED(arg.name_len);
+        arg.name = (const char *)payload_ + off_;
+        off_ += arg.name_len;
+        ARG_NEED(unit_len);
+        arg.unit = (const char *)payload_ + off_;
+        arg.unit_len = unit_len;
+        off_ += unit_len;
+    }
+
+    if (type_info & DLT_TYPEINFO_FIXP) {
+        uint32_t bits;
+        int offset_len = tyle > 4 ? tyle : 4;
+
+        ARG_NEED(4 + offset_len);
+        bits = get_u32(payload_ + off_, msb_first_);
+        memcpy(&arg.quantization, &bits, sizeof(bits));
+        off_ += 4;
+        arg.offset = payload_ + off_;
+        off_ += offset_len;
+    }
+
+    ARG_NEED((uint64_t)tyle * n_elems);
+    arg.data = payload_ + off_;
+    arg.data_len = tyle * n_elems;
+    off_ += arg.data_len;
+
+    return 1;
+}
+
 int dlt_header::decode(uint8_t *payload, uint16_t &payload_len, uint8_t *buff, size_t buff_size, size_t &off)
 {
-    return -1;
+    dlt_msg_view msg;
+    dlt_arg_view arg;
+    size_t need;
+    int ret;
+
+    ret = dlt_decoder::parse(buff + off, buff_size - off, false, msg, need);
+    if (ret <= 0) {
+        return -1;
+    }
+
+    std_hdr.header_type = msg.header_type;
+    std_hdr.msg_counter = msg.msg_counter;
+    std_hdr.length = msg.length;
+    if (msg.ecu_id) {
+        memcpy(std_hdr.ecu_id, msg.ecu_id, DLT_STD_HDR_ECU_ID_LEN);
+    }
+    if (msg.session_id) {
+        memcpy(std_hdr.session_id, msg.session_id, DLT_STD_HDR_SESSION_ID_LEN);
+    }
+    std_hdr.timestamp = msg.timestamp;
+
+    if (msg.has_ext_hdr) {
+        ext_hdr.message_info = msg.message_info;
+        ext_hdr.number_of_args = msg.number_of_args;
+        memcpy(ext_hdr.app_id, msg.app_id, DLT_EXT_HDR_APP_ID_LEN);
+        memcpy(ext_hdr.context_id, msg.ctx_id, DLT_EXT_HDR_CTX_ID_LEN);
+    }
+
+    // a single string argument is returned as the string itself, the
+    // inverse of encode, anything else as the raw payload
+    dlt_arg_reader args(msg);
+    if (msg.is_verbose() && (msg.number_of_args == 1) &&
+        (args.next(arg) == 1) && arg.is_type(DLT_TYPEINFO_STRG)) {
+        msg_type_info = DLT_MSG_TYPEINFO_STRG;
+        std::string str = arg.as_string();
+        if (str.length() > payload_len) {
+            return -1;
+        }
+        memcpy(payload, str.data(), str.length());
+        payload_len = str.length();
+    } else {
+        if (msg.payload_len > payload_len) {
+            return -1;
+        }
+        memcpy(payload, msg.payload, msg.payload_len);
+        payload_len = msg.payload_len;
+    }
+
+    off += ret;
+
+    return off;
 }
 
 }
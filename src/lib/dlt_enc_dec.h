@@ -11,6 +11,9 @@
 #ifndef __AUTO_OS_MIDDLEWARE_DLT_ENCDEC_H__
 #define __AUTO_OS_MIDDLEWARE_DLT_ENCDEC_H__
 
+#include <string.h>
+#include <string>
+#include <vector>
 #include <dlt_msg_if.h>
 
 namespace auto_os::middleware {
@@ -349,6 +352,25 @@ struct dlt_extended_header {
 #define DLT_EXT_HDR_APP_ID_LEN          4
 #define DLT_EXT_HDR_CTX_ID_LEN          4
 
+#define DLT_ARG_TYPEINFO_LEN            4
+#define DLT_ARG_STRG_LEN_LEN            2
+
+// minimum header lengths
+#define DLT_STD_HDR_MIN_LEN             4
+#define DLT_EXT_HDR_LEN                 10
+
+// dlt protocol version carried in the header type
+#define DLT_HDR_VERSION                 1
+
+// storage header in front of every message in a .dlt file
+#define DLT_STORAGE_HDR_LEN             16
+#define DLT_STORAGE_HDR_PATTERN         "DLT\x01"
+#define DLT_STORAGE_HDR_PATTERN_LEN     4
+
+// largest header in front of a string payload, standard header with all
+// optional fields, extended header and the string argument type / length
+#define DLT_HDR_MAX_LEN                 32
+
 struct dlt_header {
     dlt_standard_header std_hdr;
     dlt_extended_header ext_hdr;
@@ -381,15 +403,15 @@ struct dlt_header {
         }
 
         switch (msg_type_info) {
-            case DLT_MSG_TYPEINFO_STRG: // 4 bytes is the length of typeinfo
-                len += 4;
+            case DLT_MSG_TYPEINFO_STRG: // 4 bytes typeinfo, 2 bytes string length
+                len += 4 + 2;
+            break;
+            case DLT_MSG_TYPEINFO_ARGS: // payload carries the encoded arguments
             break;
             default:
                 return -1;
         }
 
-        // payload len
-        len += 2;
         len += payload_len;
 
         return len;
@@ -398,6 +420,343 @@ struct dlt_header {
     int decode(uint8_t *payload, uint16_t &payload_len, uint8_t *buff, size_t buff_size, size_t &off);
 };
 
+/**
+ * @brief prebuilt header bytes for string messages
+ *
+ * The bytes that only depend on configuration are encoded once by init,
+ * per message only the counter, length, session id, timestamp, message
+ * info and app / context ids are patched in.
+ */
+struct dlt_header_template {
+    uint8_t hdr[DLT_HDR_MAX_LEN];
+    // standard + extended header + string type info and length
+    int hdr_len;
+    // standard + extended header only
+    int base_len;
+    int length_off;
+    int session_id_off;
+    int timestamp_off;
+    int msg_info_off;
+    int noar_off;
+    int app_id_off;
+    int ctx_id_off;
+    int arg_len_off;
+
+    /**
+     * @brief build the template
+     * 
+     * @param in h header with the configured standard / extended header
+     *             flags, ecu id and string type info
+     * @return returns 0 on success -1 on failure
+     */
+    int init(dlt_header &h);
+
+    /**
+     * @brief encode a message in place
+     * 
+     * The header is written into the hdr_len bytes in front of payload and
+     * a null terminator right after it, the payload itself is not copied.
+     *
+     * @param in payload string payload with hdr_len bytes of headroom
+     * @param in payload_len length of the string
+     * @param in msg_counter message counter
+     * @param in session_id session id, used if the template has one
+     * @param in timestamp timestamp in 0.1 ms, used if the template has one
+     * @param in msg_info extended header message info
+     * @param in app_id application id
+     * @param in ctx_id context id
+     * @return returns start of the encoded message, its length is
+     *         hdr_len + payload_len + 1
+     */
+    inline uint8_t *encode(uint8_t *payload,
+                           uint16_t payload_len,
+                           uint8_t msg_counter,
+                           const uint8_t *session_id,
+                           uint32_t timestamp,
+                           uint8_t msg_info,
+                           const uint8_t *app_id,
+                           const uint8_t *ctx_id) const
+    {
+        uint8_t *buff = payload - hdr_len;
+        uint16_t len = hdr_len + payload_len + 1;
+        uint16_t arg_len = payload_len + 1;
+
+        memcpy(buff, hdr, hdr_len);
+
+        buff[1] = msg_counter;
+        buff[length_off] = len >> 8;
+        buff[length_off + 1] = len & 0xff;
+        if (session_id_off >= 0) {
+            memcpy(buff + session_id_off, session_id, DLT_STD_HDR_SESSION_ID_LEN);
+        }
+        if (timestamp_off >= 0) {
+            buff[timestamp_off] = timestamp >> 24;
+            buff[timestamp_off + 1] = (timestamp >> 16) & 0xff;
+            buff[timestamp_off + 2] = (timestamp >> 8) & 0xff;
+            buff[timestamp_off + 3] = timestamp & 0xff;
+        }
+        if (msg_info_off >= 0) {
+            buff[msg_info_off] = msg_info;
+            memcpy(buff + app_id_off, app_id, DLT_EXT_HDR_APP_ID_LEN);
+            memcpy(buff + ctx_id_off, ctx_id, DLT_EXT_HDR_CTX_ID_LEN);
+        }
+        // string length is not network endian, see dlt_header::encode
+        memcpy(buff + arg_len_off, &arg_len, DLT_ARG_STRG_LEN_LEN);
+
+        payload[payload_len] = '\0';
+
+        return buff;
+    }
+
+    /**
+     * @brief encode a message of preencoded verbose arguments in place
+     * 
+     * The header is written into the base_len bytes in front of args.
+     *
+     * @param in args encoded arguments with base_len bytes of headroom
+     * @param in args_len length of the arguments
+     * @param in n_args number of arguments
+     * @return returns start of the encoded message, its length is
+     *         base_len + args_len
+     */
+    inline uint8_t *encode_args(uint8_t *args,
+                                uint16_t args_len,
+                                uint8_t n_args,
+                                uint8_t msg_counter,
+                                const uint8_t *session_id,
+                                uint32_t timestamp,
+                                uint8_t msg_info,
+                                const uint8_t *app_id,
+                                const uint8_t *ctx_id) const
+    {
+        uint8_t *buff = args - base_len;
+        uint16_t len = base_len + args_len;
+
+        memcpy(buff, hdr, base_len);
+
+        buff[1] = msg_counter;
+        buff[length_off] = len >> 8;
+        buff[length_off + 1] = len & 0xff;
+        if (session_id_off >= 0) {
+            memcpy(buff + session_id_off, session_id, DLT_STD_HDR_SESSION_ID_LEN);
+        }
+        if (timestamp_off >= 0) {
+            buff[timestamp_off] = timestamp >> 24;
+            buff[timestamp_off + 1] = (timestamp >> 16) & 0xff;
+            buff[timestamp_off + 2] = (timestamp >> 8) & 0xff;
+            buff[timestamp_off + 3] = timestamp & 0xff;
+        }
+        if (msg_info_off >= 0) {
+            buff[msg_info_off] = msg_info;
+            buff[noar_off] = n_args;
+            memcpy(buff + app_id_off, app_id, DLT_EXT_HDR_APP_ID_LEN);
+            memcpy(buff + ctx_id_off, ctx_id, DLT_EXT_HDR_CTX_ID_LEN);
+        }
+
+        return buff;
+    }
+};
+
+/**
+ * @brief decoded message, all pointers refer into the decoded buffer
+ */
+struct dlt_msg_view {
+    // storage header, only set when decoding a .dlt file
+    uint32_t storage_sec;
+    int32_t storage_usec;
+    const uint8_t *storage_ecu_id;
+
+    uint8_t header_type;
+    uint8_t msg_counter;
+    uint16_t length;
+    // nullptr if not present
+    const uint8_t *ecu_id;
+    const uint8_t *session_id;
+    uint32_t timestamp;
+
+    bool has_ext_hdr;
+    uint8_t message_info;
+    uint8_t number_of_args;
+    const uint8_t *app_id;
+    const uint8_t *ctx_id;
+
+    const uint8_t *payload;
+    uint16_t payload_len;
+
+    inline bool is_msb_first() { return !!(header_type & DLT_HDR_TYPE_MSB_FIRST); }
+    inline bool is_verbose() { return has_ext_hdr && !!(message_info & DLT_EXT_HDR_MSG_INFO_VERBOSE); }
+    inline int get_msg_type() { return (message_info >> 1) & 0x07; }
+    inline int get_msg_type_info() { return (message_info >> 4) & 0x0f; }
+
+    /**
+     * @brief message id of a non verbose message
+     * 
+     * @return returns message id or 0 if payload is too short
+     */
+    uint32_t get_message_id();
+};
+
+/**
+ * @brief one verbose argument, pointers refer into the message payload
+ */
+struct dlt_arg_view {
+    uint32_t type_info;
+    const char *name;
+    uint16_t name_len;
+    const char *unit;
+    uint16_t unit_len;
+    // FIXP quantization and raw offset bytes
+    float quantization;
+    const uint8_t *offset;
+    // ARAY dimensions
+    uint16_t n_dims;
+    const uint8_t *dims;
+    // value bytes, in message endianness for numbers, the string / raw
+    // bytes otherwise (string length includes the null terminator)
+    const uint8_t *data;
+    uint32_t data_len;
+    bool msb_first;
+
+    inline bool is_type(uint32_t type) { return !!(type_info & type); }
+
+    /**
+     * @brief size of a numeric value in bytes from the type length bits
+     */
+    static int type_len(uint32_t type_info);
+
+    uint64_t as_uint();
+    int64_t as_int();
+    double as_float();
+    inline bool as_bool() { return data_len > 0 && data[0] != 0; }
+    inline std::string as_string()
+    {
+        uint32_t len = data_len;
+
+        if (len > 0 && data[len - 1] == '\0') {
+            len --;
+        }
+        return std::string((const char *)data, len);
+    }
+};
+
+/**
+ * @brief walk the verbose arguments of a message
+ */
+class dlt_arg_reader {
+    public:
+        explicit dlt_arg_reader(const dlt_msg_view &msg);
+        ~dlt_arg_reader() { }
+
+        /**
+         * @brief read next argument
+         * 
+         * @param out arg argument
+         * @return returns 1 if an argument was read, 0 at the end of the
+         *         payload and -1 on a malformed argument
+         */
+        int next(dlt_arg_view &arg);
+
+    private:
+        const uint8_t *payload_;
+        uint32_t len_;
+        uint32_t off_;
+        bool msb_first_;
+};
+
+/**
+ * @brief streaming dlt parser
+ *
+ * Buffers of any size are fed in, frames split across buffers are
+ * reassembled and several frames per buffer are returned one by one.
+ * A returned view points into the fed buffer, or into an internal buffer
+ * for a reassembled frame, and is valid until the next call to next()
+ * or until the fed buffer is released. Malformed data is skipped until
+ * a valid frame is found and counted as an error. Compressed blocks
+ * (see dlt_compress.h) are decompressed and their frames returned in
+ * order, a view into a block stays valid the same way.
+ */
+class dlt_decoder {
+    public:
+        /**
+         * @brief create decoder
+         * 
+         * @param in storage_hdr frames are prefixed with a storage header
+         */
+        explicit dlt_decoder(bool storage_hdr = false);
+        ~dlt_decoder() { }
+
+        /**
+         * @brief set the next buffer to decode
+         * 
+         * the previous buffer must be fully consumed, i.e. next() returned 0.
+         *
+         * @param in data buffer
+         * @param in len length of the buffer
+         */
+        void feed(const uint8_t *data, size_t len);
+
+        /**
+         * @brief get next complete frame
+         * 
+         * @param out msg decoded message
+         * @return returns 1 if a message is decoded, 0 if more data is needed
+         */
+        int next(dlt_msg_view &msg);
+
+        /**
+         * @brief decode one frame
+         * 
+         * @param in buff buffer starting with a frame
+         * @param in len length of the buffer
+         * @param in storage_hdr frame is prefixed with a storage header
+         * @param out msg decoded message
+         * @param out need total bytes needed if the frame is incomplete
+         * @return returns frame length, 0 if incomplete, -1 if malformed
+         */
+        static int parse(const uint8_t *buff, size_t len, bool storage_hdr,
+                         dlt_msg_view &msg, size_t &need);
+
+        /**
+         * @brief number of times malformed data was skipped
+         */
+        inline uint64_t get_errors() { return errors_; }
+
+    private:
+        /**
+         * @brief skip to the next possible frame start after a malformed one
+         */
+        size_t resync(const uint8_t *buff, size_t len);
+
+        /**
+         * @brief parse a frame or load a compressed block
+         *
+         * @param out is_msg false if a block was loaded instead of a frame
+         * @return returns same as parse
+         */
+        int parse_frame(const uint8_t *buff, size_t len, dlt_msg_view &msg, size_t &need, bool &is_msg);
+
+        /**
+         * @brief get next frame of the loaded block
+         *
+         * @return returns true if a frame is returned
+         */
+        bool next_block_frame(dlt_msg_view &msg);
+
+        bool storage_hdr_;
+        const uint8_t *in_;
+        size_t in_len_;
+        size_t in_off_;
+        // partial frame carried over between feeds
+        std::vector<uint8_t> carry_;
+        bool carry_done_;
+        // frames of the last decompressed block
+        std::vector<uint8_t> block_;
+        size_t block_len_;
+        size_t block_off_;
+        bool block_storage_hdr_;
+        uint64_t errors_;
+};
+
 }
 
 #endif
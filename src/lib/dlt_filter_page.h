@@ -0,0 +1,172 @@
+/**
+ * @file dlt_filter_page.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief log level thresholds published by dlt_service to its clients
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_FILTER_PAGE_H__
+#define __AUTO_MIDDLEWARE_DLT_FILTER_PAGE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+
+// posix shared memory object of the published thresholds
+#define DLT_FILTER_PAGE_NAME "/dlt_filters"
+
+// hash slots in the page, at most half of them are used
+#define DLT_FILTER_PAGE_SLOTS 1024
+#define DLT_FILTER_PAGE_SLOTS_SHIFT (64 - 10)
+
+// page was closed by dlt_service, clients pass everything and look for a new one
+#define DLT_FILTER_PAGE_CLOSED 0
+#define DLT_FILTER_PAGE_LIVE 1
+// more rules than slots, clients pass everything and leave it to dlt_service
+#define DLT_FILTER_PAGE_OVERFLOW 2
+
+// mask bit marking a used slot
+#define DLT_FILTER_PAGE_SLOT_USED 0x100
+
+namespace auto_os::middleware {
+
+/**
+ * @brief shared memory layout of the thresholds
+ *
+ * the same (app_id, ctx_id) key and level masks as the filter table of
+ * dlt_service. it is written by dlt_service only and mapped read only by
+ * the clients, updates are guarded by a sequence lock: seq is odd while
+ * the page is rewritten and readers retry if it changed under them.
+ */
+struct dlt_filter_page {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> state;
+    std::atomic<uint32_t> default_mask;
+    std::atomic<uint32_t> n_rules;
+    struct {
+        std::atomic<uint64_t> key;
+        // level mask and DLT_FILTER_PAGE_SLOT_USED
+        std::atomic<uint32_t> mask;
+    } slots[DLT_FILTER_PAGE_SLOTS];
+
+    static inline uint32_t pack_id(const std::string &id)
+    {
+        uint8_t bytes[4] = {0, 0, 0, 0};
+        uint32_t packed;
+
+        // ids shorter than 4 characters are padded with 0, as on the wire
+        memcpy(bytes, id.data(), id.length() < sizeof(bytes) ? id.length() : sizeof(bytes));
+        memcpy(&packed, bytes, sizeof(packed));
+
+        return packed;
+    }
+
+    static inline uint64_t make_key(uint32_t app, uint32_t ctx)
+    {
+        return ((uint64_t)app << 32) | ctx;
+    }
+
+    static inline size_t hash(uint64_t key)
+    {
+        return (key * 0x9e3779b97f4a7c15ULL) >> DLT_FILTER_PAGE_SLOTS_SHIFT;
+    }
+
+    /**
+     * @brief rewrite the page, called by dlt_service only
+     * 
+     * @param in default_mask mask of messages without a rule
+     * @param in for_each_rule called with a callback(key, mask) to add every rule
+     */
+    template <typename ForEach>
+    void publish(uint32_t default_mask_val, ForEach for_each_rule)
+    {
+        uint32_t n = 0;
+        bool overflow = false;
+
+        seq.fetch_add(1, std::memory_order_acq_rel);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (auto &s : slots) {
+            s.mask.store(0, std::memory_order_relaxed);
+        }
+
+        for_each_rule([&](uint64_t key, uint32_t mask) {
+            size_t i;
+
+            if ((n + 1) * 2 > DLT_FILTER_PAGE_SLOTS) {
+                overflow = true;
+                return;
+            }
+            for (i = hash(key); slots[i].mask.load(std::memory_order_relaxed);
+                 i = (i + 1) & (DLT_FILTER_PAGE_SLOTS - 1));
+            slots[i].key.store(key, std::memory_order_relaxed);
+            slots[i].mask.store(mask | DLT_FILTER_PAGE_SLOT_USED, std::memory_order_relaxed);
+            n ++;
+        });
+
+        default_mask.store(default_mask_val, std::memory_order_relaxed);
+        n_rules.store(n, std::memory_order_relaxed);
+        state.store(overflow ? DLT_FILTER_PAGE_OVERFLOW : DLT_FILTER_PAGE_LIVE,
+                    std::memory_order_relaxed);
+
+        seq.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief get the passing levels of an application and context
+     * 
+     * @param in app packed application id
+     * @param in ctx packed context id
+     * @param in any_ctx packed id of the rule for all contexts
+     * @param out mask passing levels
+     * @return returns page state, the mask is only valid if DLT_FILTER_PAGE_LIVE
+     */
+    inline uint32_t lookup(uint32_t app, uint32_t ctx, uint32_t any_ctx, uint32_t &mask)
+    {
+        uint32_t s1;
+        uint32_t st;
+
+        do {
+            s1 = seq.load(std::memory_order_acquire);
+            st = state.load(std::memory_order_relaxed);
+            mask = default_mask.load(std::memory_order_relaxed);
+
+            if ((st == DLT_FILTER_PAGE_LIVE) && (n_rules.load(std::memory_order_relaxed) > 0)) {
+                if (!find(make_key(app, ctx), mask)) {
+                    find(make_key(app, any_ctx), mask);
+                }
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((s1 & 1) || (s1 != seq.load(std::memory_order_relaxed)));
+
+        return st;
+    }
+
+    private:
+        inline bool find(uint64_t key, uint32_t &mask)
+        {
+            // bounded so a torn read can not loop forever
+            for (size_t i = hash(key), n = 0; n < DLT_FILTER_PAGE_SLOTS;
+                 i = (i + 1) & (DLT_FILTER_PAGE_SLOTS - 1), n ++) {
+                uint32_t m = slots[i].mask.load(std::memory_order_relaxed);
+
+                if (!m) {
+                    return false;
+                }
+                if (slots[i].key.load(std::memory_order_relaxed) == key) {
+                    mask = m & ~DLT_FILTER_PAGE_SLOT_USED;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+};
+
+}
+
+#endif
@@ -1,7 +1,30 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #include <dlt_lib.hpp>
 
 namespace auto_os::middleware {
 
+// ring of the calling thread, closed when the thread exits
+struct dlt_async_thread_ring {
+    std::shared_ptr<dlt_async_ring> ring;
+
+    ~dlt_async_thread_ring()
+    {
+        if (ring) {
+            ring->close();
+        }
+    }
+};
+
+static thread_local dlt_async_thread_ring thread_ring;
+
 int dlt_lib::connect(const std::string dlt_server_addr, uint8_t *session_id)
 {
     std::unique_ptr<auto_os::lib::random_generator> rg;
@@ -21,24 +44,474 @@ int dlt_lib::connect(const std::string dlt_server_addr, uint8_t *session_id)
                                                 rand_val);
     client_path_ = std::string(client_path);
     client_ = std::make_unique<auto_os::lib::unix_udp_client>(client_path_);
+    // synchronous sends only carry the timestamp of the call once
+    // dlt_service acknowledged that it reads it
+    wire_version_ = probe_wire_version();
+
+    open_filter_page(true);
 
     return 0;
 }
 
+void dlt_lib::open_filter_page(bool now)
+{
+    std::unique_lock<std::mutex> lock(filter_page_lock_, std::defer_lock);
+    void *mem;
+    int fd;
+
+    // dlt_service may not be up yet or restarted, look for its page every
+    // DLT_FILTER_PAGE_RETRY calls rather than on every call
+    if (!now && (filter_page_retry_.fetch_add(1, std::memory_order_relaxed) % DLT_FILTER_PAGE_RETRY)) {
+        return;
+    }
+    if (!lock.try_lock()) {
+        return;
+    }
+
+    fd = shm_open(DLT_FILTER_PAGE_NAME, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st;
+
+    if ((fstat(fd, &st) < 0) || (st.st_size != sizeof(dlt_filter_page))) {
+        close(fd);
+        return;
+    }
+
+    mem = mmap(nullptr, sizeof(dlt_filter_page), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return;
+    }
+
+    // a replaced page stays mapped, other threads may still be reading it
+    filter_page_.store((dlt_filter_page *)mem, std::memory_order_release);
+}
+
 dlt_lib::~dlt_lib()
 {
+    stop_async();
+    stop_shm();
     remove(client_path_.c_str());
 }
 
 void dlt_lib::disconnect()
 {
+    stop_async();
+    stop_shm();
     remove(client_path_.c_str());
 }
 
+int dlt_lib::enable_shm(const std::string shm_server_addr, size_t ring_size)
+{
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    struct sockaddr_un addr;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    uint8_t hello = 0;
+    size_t size = DLT_SHM_RING_MIN_SIZE;
+    int ring_fd;
+    int ret;
+
+    if (shm_ring_ || (shm_server_addr.length() >= sizeof(addr.sun_path))) {
+        return -1;
+    }
+
+    while (size < ring_size) {
+        size <<= 1;
+    }
+
+    ring_fd = memfd_create("dlt_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (ring_fd < 0) {
+        return -1;
+    }
+
+    try {
+        shm_ring_ = std::make_unique<dlt_shm_ring>(ring_fd, size);
+    } catch (std::exception &e) {
+        close(ring_fd);
+        return -1;
+    }
+
+    // dlt_service only maps a ring whose size can not change under it
+    if (fcntl(ring_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        shm_ring_.reset();
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, shm_server_addr.c_str());
+
+    shm_sock_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if ((shm_sock_ < 0) ||
+        (::connect(shm_sock_, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+        stop_shm();
+        return -1;
+    }
+
+    // hand the ring over
+    memset(&msg, 0, sizeof(msg));
+    memset(ctrl, 0, sizeof(ctrl));
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &ring_fd, sizeof(int));
+
+    if (sendmsg(shm_sock_, &msg, MSG_NOSIGNAL) < 0) {
+        stop_shm();
+        return -1;
+    }
+
+    // and get the eventfd that wakes up dlt_service
+    msg.msg_controllen = sizeof(ctrl);
+    ret = recvmsg(shm_sock_, &msg, MSG_CMSG_CLOEXEC);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if ((ret <= 0) || !cmsg || (cmsg->cmsg_level != SOL_SOCKET) ||
+        (cmsg->cmsg_type != SCM_RIGHTS) || (cmsg->cmsg_len != CMSG_LEN(sizeof(int)))) {
+        stop_shm();
+        return -1;
+    }
+    memcpy(&shm_evt_fd_, CMSG_DATA(cmsg), sizeof(int));
+
+    // the reply byte is the wire version of dlt_service, older releases
+    // send back the DLT_WIRE_VERSION_LEGACY we sent
+    shm_wire_version_ = std::min((int)hello, DLT_WIRE_VERSION);
+
+    return 0;
+}
+
+void dlt_lib::stop_shm()
+{
+    // closing the connection tells dlt_service to drain and unmap the ring
+    if (shm_sock_ >= 0) {
+        close(shm_sock_);
+        shm_sock_ = -1;
+    }
+    if (shm_evt_fd_ >= 0) {
+        close(shm_evt_fd_);
+        shm_evt_fd_ = -1;
+    }
+    shm_ring_.reset();
+    shm_wire_version_ = DLT_WIRE_VERSION_LEGACY;
+}
+
+uint64_t dlt_lib::get_shm_dropped()
+{
+    return shm_ring_ ? shm_ring_->get_dropped() : 0;
+}
+
+int dlt_lib::enable_async(size_t ring_size, dlt_async_overflow overflow)
+{
+    size_t size = 1;
+
+    if (async_) {
+        return -1;
+    }
+
+    // every record must fit, round up to a power of 2 for the ring
+    if (ring_size < 2 * DLT_MSG_MAX_LEN) {
+        ring_size = 2 * DLT_MSG_MAX_LEN;
+    }
+    while (size < ring_size) {
+        size <<= 1;
+    }
+
+    async_fd_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (async_fd_ < 0) {
+        return -1;
+    }
+
+    async_ring_size_ = size;
+    async_overflow_ = overflow;
+    async_stop_ = false;
+    async_thr_ = std::thread(&dlt_lib::async_flusher, this);
+    async_ = true;
+
+    return 0;
+}
+
+void dlt_lib::stop_async()
+{
+    if (!async_) {
+        return;
+    }
+
+    async_ = false;
+    async_stop_ = true;
+    async_thr_.join();
+
+    close(async_fd_);
+    async_fd_ = -1;
+}
+
+int dlt_lib::get_wire_version()
+{
+    if (!async_) {
+        return DLT_WIRE_VERSION_LEGACY;
+    }
+
+    return shm_ring_ ? shm_wire_version_ : wire_version_.load();
+}
+
+int dlt_lib::probe_wire_version()
+{
+    dlt_msg_envelope hello;
+    struct pollfd pfd;
+    int fd = client_->get_socket();
+    int ret;
+
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = DLT_WIRE_MAGIC;
+    hello.version = DLT_WIRE_VERSION;
+    hello.flags = DLT_WIRE_HELLO;
+    SET_4_BYTES(hello.session_id, session_id_);
+
+    // older releases of dlt_service drop the hello as too short
+    if (client_->send_msg(server_path_, (uint8_t *)&hello, sizeof(hello)) < 0) {
+        return DLT_WIRE_VERSION_LEGACY;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while ((ret = poll(&pfd, 1, DLT_WIRE_HELLO_TIMEOUT_MS)) > 0) {
+        dlt_msg_envelope ack;
+
+        if (recv(fd, &ack, sizeof(ack), MSG_DONTWAIT) != sizeof(ack)) {
+            continue;
+        }
+        if ((ack.magic == DLT_WIRE_MAGIC) && (ack.flags & DLT_WIRE_HELLO_ACK)) {
+            return std::min((int)ack.version, DLT_WIRE_VERSION);
+        }
+    }
+
+    return DLT_WIRE_VERSION_LEGACY;
+}
+
+void dlt_lib::get_async_stats(dlt_async_stats &stats)
+{
+    std::unique_lock<std::mutex> lock(async_lock_);
+
+    stats.sent = async_sent_;
+    stats.send_errors = async_send_errors_;
+    stats.dropped_newest = retired_dropped_newest_;
+    stats.dropped_oldest = retired_dropped_oldest_;
+    stats.blocked = retired_blocked_;
+
+    for (auto &ring : async_rings_) {
+        stats.dropped_newest += ring->get_dropped_newest();
+        stats.dropped_oldest += ring->get_dropped_oldest();
+        stats.blocked += ring->get_blocked();
+    }
+}
+
+dlt_async_ring *dlt_lib::get_thread_ring()
+{
+    if (!thread_ring.ring) {
+        std::unique_lock<std::mutex> lock(async_lock_);
+
+        thread_ring.ring = std::make_shared<dlt_async_ring>(async_ring_size_);
+        async_rings_.push_back(thread_ring.ring);
+    }
+
+    return thread_ring.ring.get();
+}
+
+void dlt_lib::async_flusher()
+{
+    std::vector<uint8_t> bufs(DLT_ASYNC_BATCH_SIZE * DLT_MSG_MAX_LEN);
+    uint8_t rec_buf[DLT_MSG_MAX_LEN];
+    struct mmsghdr msgs[DLT_ASYNC_BATCH_SIZE];
+    struct iovec iovs[DLT_ASYNC_BATCH_SIZE];
+    // messages in each datagram, more than one in an envelope
+    int n_recs[DLT_ASYNC_BATCH_SIZE];
+    struct sockaddr_un addr;
+    bool stopping = false;
+    int n_msgs = 0;
+    // length of the envelope being filled in iovs[n_msgs], 0 if none
+    int env_len = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, server_path_.c_str(), sizeof(addr.sun_path) - 1);
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < DLT_ASYNC_BATCH_SIZE; i ++) {
+        iovs[i].iov_base = bufs.data() + i * DLT_MSG_MAX_LEN;
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // the rings fill up meanwhile, the first batch goes out in the
+    // negotiated format
+    wire_version_ = probe_wire_version();
+
+    auto send_batch = [&]() {
+        int sent = 0;
+
+        while (sent < n_msgs) {
+            int ret = sendmmsg(async_fd_, msgs + sent, n_msgs - sent, 0);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // drop the rest of the batch, the daemon is not there
+                for (; sent < n_msgs; sent ++) {
+                    async_send_errors_ += n_recs[sent];
+                }
+                break;
+            }
+            for (int i = sent; i < sent + ret; i ++) {
+                async_sent_ += n_recs[i];
+            }
+            sent += ret;
+        }
+        n_msgs = 0;
+    };
+
+    // queue the datagram in iovs[n_msgs]
+    auto queue_msg = [&](int len, int n_records) {
+        // nothing to batch, the shared memory ring takes it as is
+        if (shm_ring_) {
+            send_direct((uint8_t *)iovs[n_msgs].iov_base, len);
+            async_sent_ += n_records;
+            return;
+        }
+        iovs[n_msgs].iov_len = len;
+        n_recs[n_msgs] = n_records;
+        n_msgs ++;
+        if (n_msgs == DLT_ASYNC_BATCH_SIZE) {
+            send_batch();
+        }
+    };
+
+    auto close_envelope = [&]() {
+        if (env_len > 0) {
+            int len = env_len;
+
+            env_len = 0;
+            queue_msg(len, ((dlt_msg_envelope *)iovs[n_msgs].iov_base)->n_records);
+        }
+    };
+
+    // append a message, as send_msg_if formatted it, to the envelope
+    auto pack_record = [&](const uint8_t *data, int len) {
+        const dlt_msg_if *msg = (const dlt_msg_if *)data;
+        int payload_len = len - sizeof(dlt_msg_if) - DLT_MSG_IF_TIMESTAMP_LEN;
+        int rec_len = sizeof(dlt_msg_record) + payload_len;
+        dlt_msg_envelope *env;
+        dlt_msg_record *rec;
+
+        if (env_len + rec_len > DLT_MSG_MAX_LEN) {
+            close_envelope();
+        }
+
+        env = (dlt_msg_envelope *)iovs[n_msgs].iov_base;
+        if (env_len == 0) {
+            env->magic = DLT_WIRE_MAGIC;
+            env->version = DLT_WIRE_VERSION;
+            env->flags = 0;
+            SET_4_BYTES(env->session_id, session_id_);
+            env->n_records = 0;
+            env_len = sizeof(dlt_msg_envelope);
+        }
+
+        rec = (dlt_msg_record *)((uint8_t *)env + env_len);
+        rec->len = payload_len;
+        SET_4_BYTES(rec->app_id, msg->app_id);
+        SET_4_BYTES(rec->ctx_id, msg->ctx_id);
+        rec->dlt_log_lvl = msg->dlt_log_lvl;
+        rec->dlt_msg_type_info = msg->dlt_msg_type_info & ~DLT_MSG_IF_TIMESTAMP;
+        memcpy(&rec->timestamp, data + len - DLT_MSG_IF_TIMESTAMP_LEN, sizeof(rec->timestamp));
+        memcpy(rec->dlt_msg, msg->dlt_msg, payload_len);
+
+        env->n_records ++;
+        env_len += rec_len;
+    };
+
+    while (1) {
+        int version = shm_ring_ ? shm_wire_version_ : wire_version_.load();
+        bool idle = true;
+
+        // stop is checked before draining so the last round sends everything
+        if (async_stop_) {
+            stopping = true;
+        }
+
+        std::unique_lock<std::mutex> lock(async_lock_);
+
+        for (auto it = async_rings_.begin(); it != async_rings_.end(); ) {
+            auto &ring = *it;
+
+            while (1) {
+                // a message of its own is read straight into the datagram
+                uint8_t *data = (version == DLT_WIRE_VERSION_LEGACY) ?
+                                    (uint8_t *)iovs[n_msgs].iov_base : rec_buf;
+                int len = ring->pop(data, DLT_MSG_MAX_LEN);
+
+                if (len < 0) {
+                    break;
+                }
+                idle = false;
+
+                if (version == DLT_WIRE_VERSION_LEGACY) {
+                    // version 0 has no timestamp, dlt_service takes the
+                    // arrival time
+                    ((dlt_msg_if *)data)->dlt_msg_type_info &= ~DLT_MSG_IF_TIMESTAMP;
+                    queue_msg(len - DLT_MSG_IF_TIMESTAMP_LEN, 1);
+                } else {
+                    pack_record(data, len);
+                }
+            }
+
+            // owning thread has exited and the ring is drained
+            if (ring->is_closed() && ring->empty()) {
+                retired_dropped_newest_ += ring->get_dropped_newest();
+                retired_dropped_oldest_ += ring->get_dropped_oldest();
+                retired_blocked_ += ring->get_blocked();
+                it = async_rings_.erase(it);
+            } else {
+                it ++;
+            }
+        }
+
+        lock.unlock();
+
+        close_envelope();
+        if (n_msgs > 0) {
+            send_batch();
+        }
+
+        if (stopping && idle) {
+            break;
+        }
+
+        if (idle) {
+            usleep(DLT_ASYNC_IDLE_SLEEP_US);
+        }
+    }
+}
+
 void dlt_lib::fatal(const std::string app_id, const std::string ctx_id, const char *fmt, ...)
 {
     va_list ap;
 
+    if (!is_enabled(DLT_MSG_LOG_LVL_FATAL, app_id, ctx_id)) {
+        return;
+    }
+
     va_start(ap, fmt);
     send_dlt_msg(app_id, ctx_id, DLT_MSG_LOG_LVL_FATAL, fmt, ap);
     va_end(ap);
@@ -48,6 +521,10 @@ void dlt_lib::error(const std::string app_id, const std::string ctx_id, const ch
 {
     va_list ap;
 
+    if (!is_enabled(DLT_MSG_LOG_LVL_ERROR, app_id, ctx_id)) {
+        return;
+    }
+
     va_start(ap, fmt);
     send_dlt_msg(app_id, ctx_id, DLT_MSG_LOG_LVL_ERROR, fmt, ap);
     va_end(ap);
@@ -57,6 +534,10 @@ void dlt_lib::verbose(const std::string app_id, const std::string ctx_id, const
 {
     va_list ap;
 
+    if (!is_enabled(DLT_MSG_LOG_LVL_VERBOSE, app_id, ctx_id)) {
+        return;
+    }
+
     va_start(ap, fmt);
     send_dlt_msg(app_id, ctx_id, DLT_MSG_LOG_LVL_VERBOSE, fmt, ap);
     va_end(ap);
@@ -66,6 +547,10 @@ void dlt_lib::warning(const std::string app_id, const std::string ctx_id, const
 {
     va_list ap;
 
+    if (!is_enabled(DLT_MSG_LOG_LVL_WARNING, app_id, ctx_id)) {
+        return;
+    }
+
     va_start(ap, fmt);
     send_dlt_msg(app_id, ctx_id, DLT_MSG_LOG_LVL_WARNING, fmt, ap);
     va_end(ap);
@@ -75,6 +560,10 @@ void dlt_lib::info(const std::string app_id, const std::string ctx_id, const cha
 {
     va_list ap;
 
+    if (!is_enabled(DLT_MSG_LOG_LVL_INFO, app_id, ctx_id)) {
+        return;
+    }
+
     va_start(ap, fmt);
     send_dlt_msg(app_id, ctx_id, DLT_MSG_LOG_LVL_INFO, fmt, ap);
     va_end(ap);
@@ -86,7 +575,7 @@ void dlt_lib::send_dlt_msg(const std::string app_id,
                            const char *fmt,
                            va_list ap)
 {
-    char *data[4096];
+    char data[DLT_MSG_MAX_LEN];
     dlt_msg_if *msg = (dlt_msg_if *)data;
     int len;
 
@@ -96,9 +585,58 @@ void dlt_lib::send_dlt_msg(const std::string app_id,
     msg->dlt_log_lvl = log_lvl;
     msg->dlt_msg_type_info = DLT_MSG_TYPEINFO_STRG;
 
-    len = vsnprintf(msg->dlt_msg, sizeof(data) - sizeof(dlt_msg_if), fmt, ap);
+    // room is left for the timestamp
+    len = vsnprintf(msg->dlt_msg, sizeof(data) - sizeof(dlt_msg_if) - DLT_MSG_IF_TIMESTAMP_LEN, fmt, ap);
+    if (len < 0) {
+        return;
+    }
+    // vsnprintf returns the untruncated length
+    if (len >= (int)(sizeof(data) - sizeof(dlt_msg_if) - DLT_MSG_IF_TIMESTAMP_LEN)) {
+        len = sizeof(data) - sizeof(dlt_msg_if) - DLT_MSG_IF_TIMESTAMP_LEN - 1;
+    }
+
+    send_msg_if((uint8_t *)data, sizeof(dlt_msg_if) + len);
+}
+
+void dlt_lib::send_msg_if(uint8_t *data, int len)
+{
+    bool async = async_;
+
+    // the time of the call, not of the send. async rings always carry it,
+    // the flusher removes it again for a version 0 daemon. a synchronous
+    // message is only timestamped when dlt_service acknowledged version 1
+    // in connect or enable_shm, older releases drop messages with
+    // DLT_MSG_IF_TIMESTAMP set
+    if (async || ((shm_ring_ ? shm_wire_version_ : wire_version_.load()) > DLT_WIRE_VERSION_LEGACY)) {
+        uint32_t timestamp = clock_->now();
+
+        memcpy(data + len, &timestamp, DLT_MSG_IF_TIMESTAMP_LEN);
+        ((dlt_msg_if *)data)->dlt_msg_type_info |= DLT_MSG_IF_TIMESTAMP;
+        len += DLT_MSG_IF_TIMESTAMP_LEN;
+    }
+
+    if (async) {
+        get_thread_ring()->push(data, len, async_overflow_);
+        return;
+    }
+
+    send_direct(data, len);
+}
+
+void dlt_lib::send_direct(uint8_t *data, int len)
+{
+    if (shm_ring_) {
+        bool wake;
+
+        if (shm_ring_->push(data, len, wake) && wake) {
+            uint64_t val = 1;
+
+            write(shm_evt_fd_, &val, sizeof(val));
+        }
+        return;
+    }
 
-    client_->send_msg(server_path_, (uint8_t *)data, sizeof(dlt_msg_if) + len);
+    client_->send_msg(server_path_, data, len);
 }
 
 }
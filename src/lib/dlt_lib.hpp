@@ -5,11 +5,57 @@
 #include <string>
 #include <stdarg.h>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <dlt_msg_if.h>
+#include <dlt_args.h>
+#include <dlt_async_ring.h>
+#include <dlt_shm_ring.h>
+#include <dlt_filter_page.h>
+#include <dlt_clock.h>
 #include <auto_lib.h>
 
 namespace auto_os::middleware {
 
+/**
+ * @brief log a non verbose message
+ *
+ * only a message id computed from the format at compile time and the raw
+ * argument values are sent, the format itself goes into the message
+ * catalog generated by dlt_catalog_gen. the format must be a string literal.
+ */
+#define DLT_LOG_NV(__log_lvl, __app_id, __ctx_id, __fmt, ...) do {\
+    constexpr uint32_t __dlt_msg_id = auto_os::middleware::dlt_msg_id(__fmt);\
+    if (0) {\
+        auto_os::middleware::dlt_nv_format_check(__fmt, ##__VA_ARGS__);\
+    }\
+    auto_os::middleware::dlt_lib::instance()->log_nv(__log_lvl, __app_id, __ctx_id,\
+                                                     __dlt_msg_id, ##__VA_ARGS__);\
+} while (0)
+
+// logging calls between looks for the filter page of dlt_service
+#define DLT_FILTER_PAGE_RETRY 4096
+
+// flusher batch, one sendmmsg call
+#define DLT_ASYNC_BATCH_SIZE 32
+// flusher sleep when all rings are empty
+#define DLT_ASYNC_IDLE_SLEEP_US 500
+// flusher wait for dlt_service to acknowledge the wire version
+#define DLT_WIRE_HELLO_TIMEOUT_MS 100
+
+/**
+ * @brief counters of the asynchronous mode, summed over all threads
+ */
+struct dlt_async_stats {
+    uint64_t sent;
+    uint64_t send_errors;
+    uint64_t dropped_newest;
+    uint64_t dropped_oldest;
+    uint64_t blocked;
+};
+
 #define SET_4_BYTES(__left, __right) {\
     __left[0] = __right[0];\
     __left[1] = __right[1];\
@@ -32,6 +78,16 @@ class dlt_lib {
             return &lib;
         }
 
+        /**
+         * @brief connect to dlt_service
+         *
+         * asks dlt_service for its wire version, waiting up to
+         * DLT_WIRE_HELLO_TIMEOUT_MS for an older release that does not reply.
+         *
+         * @param in dlt_server_addr unix socket of dlt_service
+         * @param in session_id 4 byte session id
+         * @return returns 0 on success
+         */
         int connect(const std::string dlt_server_addr,
                     uint8_t *session_id);
         int connect(const std::string dlt_server_addr,
@@ -40,23 +96,239 @@ class dlt_lib {
 
         void disconnect();
 
+        /**
+         * @brief switch to asynchronous logging
+         *
+         * a logging call then only appends the message to a ring owned by
+         * the calling thread, a background thread sends the rings to the
+         * daemon in batches. call after connect.
+         * 
+         * @param in ring_size size of each per thread ring in bytes, rounded up to a power of 2
+         * @param in overflow what a logging call does when its ring is full
+         * @return returns 0 on success -1 on failure
+         */
+        int enable_async(size_t ring_size, dlt_async_overflow overflow);
+
+        /**
+         * @brief send messages through a shared memory ring instead of the socket
+         *
+         * the ring is a memfd handed to dlt_service over its control socket,
+         * messages are copied in without a system call and dlt_service is
+         * only woken when the ring goes from empty to non empty. messages
+         * are dropped when the ring is full. call after connect.
+         * 
+         * @param in shm_server_addr control socket of dlt_service
+         * @param in ring_size size of the ring in bytes, rounded up to a power of 2
+         * @return returns 0 on success -1 on failure
+         */
+        int enable_shm(const std::string shm_server_addr, size_t ring_size);
+
+        /**
+         * @brief number of messages dropped on a full shared memory ring
+         */
+        uint64_t get_shm_dropped();
+
+        /**
+         * @brief wire format version the messages are sent in
+         *
+         * the asynchronous mode packs the messages into envelopes of
+         * DLT_WIRE_VERSION once dlt_service acknowledged it, otherwise and
+         * in the synchronous mode each message is sent on its own.
+         *
+         * @return returns DLT_WIRE_VERSION_LEGACY or DLT_WIRE_VERSION
+         */
+        int get_wire_version();
+
+        /**
+         * @brief get counters of the asynchronous mode
+         * 
+         * @param out stats counters
+         */
+        void get_async_stats(dlt_async_stats &stats);
+
+        /**
+         * @brief check if dlt_service would keep a message
+         *
+         * looks up the thresholds dlt_service publishes in shared memory,
+         * every level passes while no thresholds are published. the logging
+         * calls check this before formatting.
+         * 
+         * @param in log_lvl log level
+         * @param in app_id application id
+         * @param in ctx_id context id
+         * @return true if the message is to be sent
+         */
+        inline bool is_enabled(dlt_msg_log_lvl log_lvl,
+                               const std::string &app_id,
+                               const std::string &ctx_id)
+        {
+            dlt_filter_page *page = filter_page_.load(std::memory_order_acquire);
+            uint32_t mask;
+
+            if (!page) {
+                open_filter_page(false);
+                return true;
+            }
+
+            switch (page->lookup(dlt_filter_page::pack_id(app_id),
+                                 dlt_filter_page::pack_id(ctx_id),
+                                 any_ctx_, mask)) {
+                case DLT_FILTER_PAGE_LIVE:
+                return mask & (1 << log_lvl);
+                case DLT_FILTER_PAGE_CLOSED:
+                    open_filter_page(false);
+                return true;
+                default:
+                return true;
+            }
+        }
+
         void info(const std::string app_id, const std::string ctx_id, const char *fmt, ...);
         void warning(const std::string app_id, const std::string ctx_id, const char *fmt, ...);
         void verbose(const std::string app_id, const std::string ctx_id, const char *fmt, ...);
         void error(const std::string app_id, const std::string ctx_id, const char *fmt, ...);
         void fatal(const std::string app_id, const std::string ctx_id, const char *fmt, ...);
 
+        /**
+         * @brief log typed values as dlt verbose arguments without formatting
+         * 
+         * supports bool, integers, float, double, const char *, std::string
+         * and dlt_raw. arguments that do not fit in one message are dropped.
+         *
+         * @param in log_lvl log level
+         * @param in app_id application id
+         * @param in ctx_id context id
+         * @param in args values to log
+         */
+        template <typename... Args>
+        void log(dlt_msg_log_lvl log_lvl,
+                 const std::string &app_id,
+                 const std::string &ctx_id,
+                 const Args &... args)
+        {
+            uint8_t data[DLT_MSG_MAX_LEN];
+            dlt_msg_if *msg = (dlt_msg_if *)data;
+
+            if (!is_enabled(log_lvl, app_id, ctx_id)) {
+                return;
+            }
+
+            dlt_arg_writer writer((uint8_t *)msg->dlt_msg,
+                                  sizeof(data) - sizeof(dlt_msg_if) - DLT_MSG_IF_TIMESTAMP_LEN);
+
+            SET_4_BYTES(msg->app_id, app_id);
+            SET_4_BYTES(msg->ctx_id, ctx_id);
+            SET_4_BYTES(msg->session_id, session_id_);
+            msg->dlt_log_lvl = log_lvl;
+            msg->dlt_msg_type_info = DLT_MSG_TYPEINFO_ARGS;
+
+            (writer.put(args), ...);
+
+            send_msg_if(data, sizeof(dlt_msg_if) + writer.get_len());
+        }
+
+        /**
+         * @brief log a non verbose message, use DLT_LOG_NV instead
+         * 
+         * @param in log_lvl log level
+         * @param in app_id application id
+         * @param in ctx_id context id
+         * @param in msg_id message id of the format in the catalog
+         * @param in args values to log
+         */
+        template <typename... Args>
+        void log_nv(dlt_msg_log_lvl log_lvl,
+                    const std::string &app_id,
+                    const std::string &ctx_id,
+                    uint32_t msg_id,
+                    const Args &... args)
+        {
+            uint8_t data[DLT_MSG_MAX_LEN];
+            dlt_msg_if *msg = (dlt_msg_if *)data;
+
+            if (!is_enabled(log_lvl, app_id, ctx_id)) {
+                return;
+            }
+
+            dlt_nv_arg_writer writer((uint8_t *)msg->dlt_msg,
+                                     sizeof(data) - sizeof(dlt_msg_if) - DLT_MSG_IF_TIMESTAMP_LEN, msg_id);
+
+            SET_4_BYTES(msg->app_id, app_id);
+            SET_4_BYTES(msg->ctx_id, ctx_id);
+            SET_4_BYTES(msg->session_id, session_id_);
+            msg->dlt_log_lvl = log_lvl;
+            msg->dlt_msg_type_info = DLT_MSG_TYPEINFO_NONVERBOSE;
+
+            (writer.put(args), ...);
+
+            send_msg_if(data, sizeof(dlt_msg_if) + writer.get_len());
+        }
+
     private:
-        explicit dlt_lib() { }
+        explicit dlt_lib() : clock_(dlt_clock::instance()),
+                             filter_page_(nullptr),
+                             filter_page_retry_(0),
+                             any_ctx_(dlt_filter_page::pack_id("*")),
+                             shm_sock_(-1),
+                             shm_evt_fd_(-1),
+                             shm_wire_version_(DLT_WIRE_VERSION_LEGACY),
+                             wire_version_(DLT_WIRE_VERSION_LEGACY),
+                             async_(false),
+                             async_stop_(false),
+                             async_fd_(-1),
+                             async_sent_(0),
+                             async_send_errors_(0),
+                             retired_dropped_newest_(0),
+                             retired_dropped_oldest_(0),
+                             retired_blocked_(0)
+        { }
+
+        // timestamps the messages when they are logged
+        dlt_clock *clock_;
         uint8_t session_id_[4];
         std::string server_path_;
         std::string client_path_;
         std::unique_ptr<auto_os::lib::unix_udp_client> client_;
+
+        std::atomic<dlt_filter_page *> filter_page_;
+        std::atomic<uint32_t> filter_page_retry_;
+        std::mutex filter_page_lock_;
+        uint32_t any_ctx_;
+
+        std::unique_ptr<dlt_shm_ring> shm_ring_;
+        int shm_sock_;
+        int shm_evt_fd_;
+        // versions dlt_service acknowledged on the shm and the unix socket
+        int shm_wire_version_;
+        std::atomic<int> wire_version_;
+
+        std::atomic<bool> async_;
+        std::atomic<bool> async_stop_;
+        size_t async_ring_size_;
+        dlt_async_overflow async_overflow_;
+        int async_fd_;
+        std::thread async_thr_;
+        std::mutex async_lock_;
+        std::vector<std::shared_ptr<dlt_async_ring>> async_rings_;
+        std::atomic<uint64_t> async_sent_;
+        std::atomic<uint64_t> async_send_errors_;
+        uint64_t retired_dropped_newest_;
+        uint64_t retired_dropped_oldest_;
+        uint64_t retired_blocked_;
+
+        dlt_async_ring *get_thread_ring();
+        void async_flusher();
+        int probe_wire_version();
+        void stop_async();
+        void open_filter_page(bool now);
+        void stop_shm();
+        void send_direct(uint8_t *data, int len);
         void send_dlt_msg(const std::string app_id,
                           const std::string ctx_id,
                           dlt_msg_log_lvl log_lvl,
                           const char *fmt,
                           va_list ap);
+        void send_msg_if(uint8_t *data, int len);
 };
 
 }
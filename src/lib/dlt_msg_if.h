@@ -23,8 +23,46 @@ enum dlt_msg_typeinfo {
     DLT_MSG_TYPEINFO_FIXP,
     DLT_MSG_TYPEINFO_TRAI,
     DLT_MSG_TYPEINFO_STRU,
+    // dlt_msg is a sequence of verbose arguments, each a DLT_TYPEINFO_*
+    // type info followed by its value, in host byte order
+    DLT_MSG_TYPEINFO_ARGS,
+    // dlt_msg is a 32 bit message id followed by the packed argument
+    // values, the format is looked up in the message catalog
+    DLT_MSG_TYPEINFO_NONVERBOSE,
 };
 
+// type info of a verbose argument
+#define DLT_TYPEINFO_TYLE_MASK          0x0000000f
+#define DLT_TYPEINFO_BOOL               0x00000010
+#define DLT_TYPEINFO_SINT               0x00000020
+#define DLT_TYPEINFO_UINT               0x00000040
+#define DLT_TYPEINFO_FLOA               0x00000080
+#define DLT_TYPEINFO_ARAY               0x00000100
+#define DLT_TYPEINFO_STRG               0x00000200
+#define DLT_TYPEINFO_RAWD               0x00000400
+#define DLT_TYPEINFO_VARI               0x00000800
+#define DLT_TYPEINFO_FIXP               0x00001000
+#define DLT_TYPEINFO_TRAI               0x00002000
+#define DLT_TYPEINFO_STRU               0x00004000
+#define DLT_TYPEINFO_SCOD_MASK          0x00038000
+
+// TYLE values for 8, 16, 32, 64 and 128 bit values
+#define DLT_TYPEINFO_TYLE_8BIT          0x00000001
+#define DLT_TYPEINFO_TYLE_16BIT         0x00000002
+#define DLT_TYPEINFO_TYLE_32BIT         0x00000003
+#define DLT_TYPEINFO_TYLE_64BIT         0x00000004
+#define DLT_TYPEINFO_TYLE_128BIT        0x00000005
+
+// largest message a client sends, fits a dlt_service receive buffer
+#define DLT_MSG_MAX_LEN 4000
+
+// set in dlt_msg_type_info when the message ends with the uint32_t time
+// of the logging call in 0.1 ms of CLOCK_MONOTONIC, in host byte order.
+// only sent once dlt_service acknowledged a wire version above 0, it
+// timestamps messages without it on arrival.
+#define DLT_MSG_IF_TIMESTAMP 0x80
+#define DLT_MSG_IF_TIMESTAMP_LEN 4
+
 struct dlt_msg_if {
     uint8_t app_id[4];
     uint8_t ctx_id[4];
@@ -32,7 +70,61 @@ struct dlt_msg_if {
 
     // dlt_msg_log_lvl
     uint8_t dlt_log_lvl;
+    // dlt_msg_typeinfo, may be ored with DLT_MSG_IF_TIMESTAMP
+    uint8_t dlt_msg_type_info;
+    char dlt_msg[0];
+} __attribute__ ((__packed__));
+
+// wire format versions. version 0 is one dlt_msg_if per datagram or ring
+// entry, later versions send a dlt_msg_envelope of records. a client only
+// sends envelopes once dlt_service acknowledged a version, so a client
+// and a daemon of different releases fall back to version 0.
+#define DLT_WIRE_VERSION_LEGACY 0
+#define DLT_WIRE_VERSION 1
+
+// first byte of an envelope, it is not a printable app id character and
+// so never the first byte of a dlt_msg_if
+#define DLT_WIRE_MAGIC 0xff
+
+// envelope without records asking for the highest common version,
+// sent to the unix socket of dlt_service from the socket the client
+// binds. the reply is an envelope with DLT_WIRE_HELLO_ACK set.
+#define DLT_WIRE_HELLO 0x01
+#define DLT_WIRE_HELLO_ACK 0x02
+
+/**
+ * @brief header of a datagram or ring entry carrying many messages
+ *
+ * followed by n_records dlt_msg_record, in host byte order like dlt_msg_if.
+ */
+struct dlt_msg_envelope {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint8_t session_id[4];
+    uint16_t n_records;
+    uint8_t records[0];
+
+    static inline bool is_envelope(const uint8_t *data, int len)
+    {
+        return (len > 0) && (data[0] == DLT_WIRE_MAGIC);
+    }
+} __attribute__ ((__packed__));
+
+/**
+ * @brief one message of an envelope
+ */
+struct dlt_msg_record {
+    // length of dlt_msg
+    uint16_t len;
+    uint8_t app_id[4];
+    uint8_t ctx_id[4];
+    // dlt_msg_log_lvl
+    uint8_t dlt_log_lvl;
+    // dlt_msg_typeinfo
     uint8_t dlt_msg_type_info;
+    // time of the logging call in 0.1 ms of CLOCK_MONOTONIC
+    uint32_t timestamp;
     char dlt_msg[0];
 } __attribute__ ((__packed__));
 
@@ -0,0 +1,264 @@
+/**
+ * @file dlt_shm_ring.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief shared memory ring between dlt_lib and dlt_service
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ * 
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_SHM_RING_H__
+#define __AUTO_MIDDLEWARE_DLT_SHM_RING_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <stdexcept>
+
+// control socket of dlt_service where clients hand over their rings
+#define DLT_SHM_SERVER_ADDRESS "/tmp/dlt_shm.sock"
+
+#define DLT_SHM_RING_MAGIC 0x444c5452
+#define DLT_SHM_RING_HDR_SIZE 256
+#define DLT_SHM_RING_MIN_SIZE (64 * 1024)
+
+namespace auto_os::middleware {
+
+/**
+ * @brief ring control block at the start of the shared memory
+ */
+struct dlt_shm_ring_hdr {
+    uint32_t magic;
+    uint32_t size;
+    // reserved by the producers
+    alignas(64) std::atomic<uint64_t> tail;
+    // consumed by dlt_service
+    alignas(64) std::atomic<uint64_t> head;
+    // set by dlt_service when it found the ring empty and waits on the eventfd
+    alignas(64) std::atomic<uint32_t> waiting;
+    std::atomic<uint64_t> dropped;
+};
+
+static_assert(sizeof(dlt_shm_ring_hdr) <= DLT_SHM_RING_HDR_SIZE, "ring header too large");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+/**
+ * @brief multi producer single consumer ring in a memfd
+ *
+ * records are a 32 bit word followed by the message, padded to 8 bytes.
+ * a producer reserves space by moving tail with a compare and swap, copies
+ * the message and then publishes the word with the committed bit. the
+ * consumer zeroes every record it takes before moving head so that space
+ * not yet committed always reads as zero. a record never wraps, the end of
+ * the buffer is skipped with a padding record.
+ */
+class dlt_shm_ring {
+    public:
+        /**
+         * @brief map a ring
+         * 
+         * @param in fd memfd of the ring
+         * @param in size size of the data area, power of 2, 0 attaches to
+         *           an existing ring and takes the size from it
+         */
+        explicit dlt_shm_ring(int fd, uint32_t size) : fd_(fd)
+        {
+            struct stat st;
+
+            if (size == 0) {
+                if ((fstat(fd, &st) < 0) ||
+                    (st.st_size <= DLT_SHM_RING_HDR_SIZE + DLT_SHM_RING_MIN_SIZE)) {
+                    throw std::runtime_error("invalid shared memory ring");
+                }
+                map_len_ = st.st_size;
+            } else {
+                map_len_ = DLT_SHM_RING_HDR_SIZE + size;
+                if (ftruncate(fd, map_len_) < 0) {
+                    throw std::runtime_error("failed to size shared memory ring");
+                }
+            }
+
+            mem_ = (uint8_t *)mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mem_ == MAP_FAILED) {
+                throw std::runtime_error("failed to map shared memory ring");
+            }
+
+            hdr_ = (dlt_shm_ring_hdr *)mem_;
+            data_ = mem_ + DLT_SHM_RING_HDR_SIZE;
+
+            if (size != 0) {
+                // memfd pages start zeroed
+                hdr_->size = size;
+                hdr_->magic = DLT_SHM_RING_MAGIC;
+            } else if ((hdr_->magic != DLT_SHM_RING_MAGIC) ||
+                       (hdr_->size != map_len_ - DLT_SHM_RING_HDR_SIZE) ||
+                       (hdr_->size & (hdr_->size - 1))) {
+                munmap(mem_, map_len_);
+                throw std::runtime_error("invalid shared memory ring");
+            }
+            size_ = hdr_->size;
+        }
+        ~dlt_shm_ring()
+        {
+            munmap(mem_, map_len_);
+            close(fd_);
+        }
+
+        dlt_shm_ring(const dlt_shm_ring &) = delete;
+        const dlt_shm_ring &operator=(const dlt_shm_ring &) = delete;
+        dlt_shm_ring(const dlt_shm_ring &&) = delete;
+        const dlt_shm_ring &&operator=(const dlt_shm_ring &&) = delete;
+
+        /**
+         * @brief append a record, safe from any thread of the client
+         * 
+         * @param in msg message
+         * @param in len length of the message
+         * @param out wake set if dlt_service must be woken up
+         * @return true if queued
+         * @return false if the ring is full, the message is dropped and counted
+         */
+        bool push(const uint8_t *msg, uint32_t len, bool &wake)
+        {
+            uint64_t rec = record_size(len);
+            uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+            uint64_t pad;
+
+            wake = false;
+
+            if (rec > size_ / 2) {
+                hdr_->dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            do {
+                size_t off = tail & (size_ - 1);
+
+                pad = (size_ - off < rec) ? size_ - off : 0;
+                if (tail + pad + rec - hdr_->head.load(std::memory_order_acquire) > size_) {
+                    hdr_->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+            } while (!hdr_->tail.compare_exchange_weak(tail, tail + pad + rec,
+                                                       std::memory_order_relaxed));
+
+            if (pad) {
+                word(tail)->store(COMMITTED | PADDING | (uint32_t)(pad - WORD_LEN),
+                                  std::memory_order_release);
+                tail += pad;
+            }
+
+            memcpy(data_ + (tail & (size_ - 1)) + WORD_LEN, msg, len);
+            word(tail)->store(COMMITTED | len, std::memory_order_release);
+
+            // pairs with the fence in set_waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (hdr_->waiting.load(std::memory_order_relaxed) &&
+                hdr_->waiting.exchange(0)) {
+                wake = true;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief take the committed records in order, called by dlt_service
+         * 
+         * @param in cb called with each message, the message is only valid in the
+         *           call. returning false leaves the message in the ring and stops
+         * @param in max_msgs maximum number of records to take
+         * @return returns number of messages taken
+         */
+        template <typename Cb>
+        int pop(Cb cb, int max_msgs)
+        {
+            uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+            int n_msgs = 0;
+
+            while (n_msgs < max_msgs) {
+                uint32_t w = word(head)->load(std::memory_order_acquire);
+                uint64_t rec;
+
+                if (!(w & COMMITTED)) {
+                    break;
+                }
+
+                rec = (w & PADDING) ? WORD_LEN + (w & LEN_MASK) : record_size(w & LEN_MASK);
+                // the ring is writable by the client, never trust a length
+                if (rec > size_ - (head & (size_ - 1))) {
+                    break;
+                }
+
+                if (!(w & PADDING)) {
+                    if (!cb(data_ + (head & (size_ - 1)) + WORD_LEN, w & LEN_MASK)) {
+                        break;
+                    }
+                    n_msgs ++;
+                }
+
+                memset(data_ + (head & (size_ - 1)), 0, rec);
+                head += rec;
+                hdr_->head.store(head, std::memory_order_release);
+            }
+
+            return n_msgs;
+        }
+
+        /**
+         * @brief arm the wakeup before sleeping on the eventfd
+         * 
+         * @return true if the ring is still empty
+         * @return false if a record arrived in between, pop again
+         */
+        bool set_waiting()
+        {
+            hdr_->waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!empty()) {
+                hdr_->waiting.store(0, std::memory_order_relaxed);
+                return false;
+            }
+
+            return true;
+        }
+
+        inline bool empty()
+        {
+            return !(word(hdr_->head.load(std::memory_order_relaxed))->load(std::memory_order_acquire) & COMMITTED);
+        }
+
+        inline uint64_t get_dropped() { return hdr_->dropped.load(std::memory_order_relaxed); }
+        inline uint32_t get_size() { return size_; }
+
+    private:
+        static constexpr uint32_t WORD_LEN = sizeof(uint32_t);
+        static constexpr uint32_t COMMITTED = 0x80000000;
+        static constexpr uint32_t PADDING = 0x40000000;
+        static constexpr uint32_t LEN_MASK = 0x3fffffff;
+
+        static inline uint64_t record_size(uint32_t len)
+        {
+            return (WORD_LEN + len + 7) & ~7ULL;
+        }
+
+        inline std::atomic<uint32_t> *word(uint64_t pos)
+        {
+            return (std::atomic<uint32_t> *)(data_ + (pos & (size_ - 1)));
+        }
+
+        int fd_;
+        size_t map_len_;
+        uint8_t *mem_;
+        dlt_shm_ring_hdr *hdr_;
+        uint8_t *data_;
+        uint32_t size_;
+};
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * @file dlt_buf_pool.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief preallocated buffer pool for received messages
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_BUF_POOL_H__
+#define __AUTO_MIDDLEWARE_DLT_BUF_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <dlt_mpsc_ring.h>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief fixed number of equally sized buffers carved out of one slab
+ *
+ * Buffers are allocated by one thread and released by any of the process
+ * workers, the free indexes go back through a mpsc ring so no side takes
+ * a lock.
+ */
+class dlt_buf_pool {
+    public:
+        /**
+         * @brief create buffer pool
+         * 
+         * @param in n_bufs number of buffers, must be a power of 2
+         * @param in buf_size size of each buffer
+         */
+        explicit dlt_buf_pool(size_t n_bufs, size_t buf_size) :
+                            slab_(new uint8_t[n_bufs * buf_size]),
+                            n_bufs_(n_bufs),
+                            buf_size_(buf_size),
+                            free_list_(n_bufs),
+                            exhausted_(0)
+        {
+            for (size_t i = 0; i < n_bufs; i ++) {
+                free_list_.push(i);
+            }
+        }
+        ~dlt_buf_pool() { }
+
+        dlt_buf_pool(const dlt_buf_pool &) = delete;
+        const dlt_buf_pool &operator=(const dlt_buf_pool &) = delete;
+        dlt_buf_pool(const dlt_buf_pool &&) = delete;
+        const dlt_buf_pool &&operator=(const dlt_buf_pool &&) = delete;
+
+        /**
+         * @brief allocate a buffer
+         * 
+         * @param out idx index of the allocated buffer
+         * @return returns buffer or nullptr if all buffers are in use
+         */
+        inline uint8_t *alloc(uint32_t &idx)
+        {
+            if (!free_list_.pop(idx)) {
+                return nullptr;
+            }
+
+            return get(idx);
+        }
+
+        /**
+         * @brief return buffer to the pool
+         * 
+         * @param in idx index of the buffer
+         */
+        inline void free(uint32_t idx)
+        {
+            free_list_.push(idx);
+        }
+
+        /**
+         * @brief get buffer at index
+         * 
+         * @param in idx index of the buffer
+         */
+        inline uint8_t *get(uint32_t idx)
+        {
+            return slab_.get() + (idx * buf_size_);
+        }
+
+        inline size_t get_n_bufs() { return n_bufs_; }
+        inline size_t get_buf_size() { return buf_size_; }
+
+        /**
+         * @brief count messages dropped because the pool was empty
+         */
+        inline void set_exhausted(uint64_t n = 1) { exhausted_.fetch_add(n, std::memory_order_relaxed); }
+
+        /**
+         * @brief number of messages dropped because the pool was empty
+         */
+        inline uint64_t get_exhausted() { return exhausted_.load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<uint8_t[]> slab_;
+        size_t n_bufs_;
+        size_t buf_size_;
+        dlt_mpsc_ring<uint32_t> free_list_;
+        std::atomic<uint64_t> exhausted_;
+};
+
+}
+
+#endif
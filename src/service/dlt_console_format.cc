@@ -0,0 +1,252 @@
+/**
+ * @file dlt_console_format.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief renders encoded dlt messages as console lines written with writev
+ * @version 0.1
+ * @date 2022-01-02
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <dlt_console_format.h>
+
+namespace auto_os::middleware {
+
+// "[ecu] [counter] [app][ctx] [level] " is at most 36 bytes
+#define DLT_CONSOLE_PREFIX_MAX 64
+
+static const struct {
+    const char *str;
+    size_t len;
+} level_names[] = {
+    {"[unknown] ", 10},
+    {"[fatal] ", 8},
+    {"[error] ", 8},
+    {"[warning] ", 10},
+    {"[info] ", 7},
+    {"[debug] ", 8},
+    {"[verbose] ", 10},
+};
+
+dlt_console_formatter::dlt_console_formatter(int fd, const uint8_t *ecu_id, dlt_catalog *catalog) :
+                                fd_(fd),
+                                catalog_(catalog),
+                                out_len_(0),
+                                n_iov_(0),
+                                writes_(0),
+                                write_errors_(0)
+{
+    set_ecu_id(ecu_id);
+    for (int i = 0; i < 256; i ++) {
+        counter_lens_[i] = snprintf(counters_[i], sizeof(counters_[i]), "[%d] ", i);
+    }
+    text_.reserve(DLT_CONSOLE_LINE_MAX);
+}
+
+void dlt_console_formatter::add_out(size_t len)
+{
+    // text written right after the previous piece of the buffer extends it
+    if ((n_iov_ > 0) && ((char *)iov_[n_iov_ - 1].iov_base + iov_[n_iov_ - 1].iov_len == out_ptr())) {
+        iov_[n_iov_ - 1].iov_len += len;
+    } else {
+        iov_[n_iov_].iov_base = out_ptr();
+        iov_[n_iov_].iov_len = len;
+        n_iov_ ++;
+    }
+    out_len_ += len;
+}
+
+void dlt_console_formatter::add_ref(const void *data, size_t len)
+{
+    iov_[n_iov_].iov_base = (void *)data;
+    iov_[n_iov_].iov_len = len;
+    n_iov_ ++;
+}
+
+int dlt_console_formatter::format_args(dlt_msg_view &msg, char *str, int str_len)
+{
+    dlt_arg_reader reader(msg);
+    dlt_arg_view arg;
+    int n_args = 0;
+    int off = 0;
+
+    while ((reader.next(arg) == 1) && (off < str_len - 1)) {
+        const char *sep = off > 0 ? " " : "";
+        int ret = 0;
+
+        if (arg.is_type(DLT_TYPEINFO_BOOL)) {
+            ret = snprintf(str + off, str_len - off, "%s%s", sep, arg.as_bool() ? "true" : "false");
+        } else if (arg.is_type(DLT_TYPEINFO_SINT)) {
+            ret = snprintf(str + off, str_len - off, "%s%lld", sep, (long long)arg.as_int());
+        } else if (arg.is_type(DLT_TYPEINFO_UINT)) {
+            ret = snprintf(str + off, str_len - off, "%s%llu", sep, (unsigned long long)arg.as_uint());
+        } else if (arg.is_type(DLT_TYPEINFO_FLOA)) {
+            ret = snprintf(str + off, str_len - off, "%s%g", sep, arg.as_float());
+        } else if (arg.is_type(DLT_TYPEINFO_STRG)) {
+            ret = snprintf(str + off, str_len - off, "%s%.*s", sep,
+                           (int)strnlen((const char *)arg.data, arg.data_len), (const char *)arg.data);
+        } else if (arg.is_type(DLT_TYPEINFO_RAWD)) {
+            ret = snprintf(str + off, str_len - off, "%s", sep);
+            for (uint32_t i = 0; (i < arg.data_len) && (off + ret < str_len - 3); i ++) {
+                ret += snprintf(str + off + ret, str_len - off - ret, "%02x", arg.data[i]);
+            }
+        }
+        off += std::min(ret, str_len - 1 - off);
+        n_args ++;
+    }
+
+    // console output is line based, string arguments usually carry the
+    // newline already
+    if ((off == 0) || (str[off - 1] != '\n')) {
+        str[off ++] = '\n';
+    }
+
+    return n_args > 0 ? off : -1;
+}
+
+int dlt_console_formatter::format(const uint8_t *data, int len)
+{
+    static const uint8_t no_id[4] = {'-', '-', '-', '-'};
+    uint32_t own_id = ecu_id_.load(std::memory_order_relaxed);
+    const uint8_t *ecu_id = (const uint8_t *)&own_id;
+    const uint8_t *app_id = no_id;
+    const uint8_t *ctx_id = no_id;
+    int lvl = 0;
+    dlt_msg_view msg;
+    size_t need;
+    char *p;
+
+    if (dlt_decoder::parse(data, len, false, msg, need) <= 0) {
+        return -1;
+    }
+
+    if ((out_len_ + DLT_CONSOLE_PREFIX_MAX + DLT_CONSOLE_LINE_MAX > sizeof(out_)) ||
+        (n_iov_ + 3 > DLT_CONSOLE_IOV_MAX)) {
+        flush();
+    }
+
+    if (msg.ecu_id) {
+        ecu_id = msg.ecu_id;
+    }
+    if (msg.has_ext_hdr) {
+        app_id = msg.app_id;
+        ctx_id = msg.ctx_id;
+        lvl = msg.get_msg_type_info();
+        if (lvl >= (int)(sizeof(level_names) / sizeof(level_names[0]))) {
+            lvl = 0;
+        }
+    }
+
+    p = out_ptr();
+    *p ++ = '[';
+    memcpy(p, ecu_id, 4);
+    p += 4;
+    *p ++ = ']';
+    *p ++ = ' ';
+    memcpy(p, counters_[msg.msg_counter], sizeof(counters_[0]));
+    p += counter_lens_[msg.msg_counter];
+    *p ++ = '[';
+    memcpy(p, app_id, 4);
+    p += 4;
+    *p ++ = ']';
+    *p ++ = '[';
+    memcpy(p, ctx_id, 4);
+    p += 4;
+    *p ++ = ']';
+    *p ++ = ' ';
+    memcpy(p, level_names[lvl].str, level_names[lvl].len);
+    p += level_names[lvl].len;
+    add_out(p - out_ptr());
+
+    // arguments stay in the byte order of the client, little endian
+    msg.header_type &= ~DLT_HDR_TYPE_MSB_FIRST;
+
+    // with verbose mode off string and argument messages are not flagged
+    // verbose either, so a message the catalog does not know is tried as
+    // arguments before it is printed as a bare message id
+    if (msg.has_ext_hdr && !msg.is_verbose() && catalog_ &&
+        (catalog_->expand(msg.payload, msg.payload_len, text_) >= 0)) {
+        size_t text_len = std::min(text_.length(), (size_t)DLT_CONSOLE_LINE_MAX);
+
+        memcpy(out_ptr(), text_.data(), text_len);
+        add_out(text_len);
+        return 0;
+    }
+
+    // a single string, the common case, without formatting
+    {
+        dlt_arg_reader reader(msg);
+        dlt_arg_view arg;
+        dlt_arg_view end;
+
+        if ((reader.next(arg) == 1) && arg.is_type(DLT_TYPEINFO_STRG) && (reader.next(end) == 0)) {
+            size_t str_len = strnlen((const char *)arg.data, std::min(arg.data_len, (uint32_t)DLT_CONSOLE_LINE_MAX));
+
+            if (str_len <= DLT_CONSOLE_COPY_MAX) {
+                memcpy(out_ptr(), arg.data, str_len);
+                add_out(str_len);
+            } else {
+                add_ref(arg.data, str_len);
+            }
+            if ((str_len == 0) || (arg.data[str_len - 1] != '\n')) {
+                *out_ptr() = '\n';
+                add_out(1);
+            }
+            return 0;
+        }
+    }
+
+    int ret = format_args(msg, out_ptr(), DLT_CONSOLE_LINE_MAX);
+
+    if ((ret < 0) && !msg.is_verbose()) {
+        uint32_t msg_id = 0;
+
+        // the message id is in the byte order of the client
+        memcpy(&msg_id, msg.payload, std::min(sizeof(msg_id), (size_t)msg.payload_len));
+        ret = snprintf(out_ptr(), DLT_CONSOLE_LINE_MAX, "[non verbose %u]\n", msg_id);
+    }
+    add_out(ret < 0 ? 1 : ret);
+
+    return 0;
+}
+
+int dlt_console_formatter::flush()
+{
+    struct iovec *iov = iov_;
+    int n = n_iov_;
+
+    while (n > 0) {
+        ssize_t ret = writev(fd_, iov, n);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errors_ ++;
+            break;
+        }
+        writes_ ++;
+
+        // partial write, continue from the first byte not written
+        while ((n > 0) && ((size_t)ret >= iov->iov_len)) {
+            ret -= iov->iov_len;
+            iov ++;
+            n --;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+
+    out_len_ = 0;
+    n_iov_ = 0;
+
+    return n > 0 ? -1 : 0;
+}
+
+}
@@ -0,0 +1,118 @@
+/**
+ * @file dlt_console_format.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief renders encoded dlt messages as console lines written with writev
+ * @version 0.1
+ * @date 2022-01-02
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_CONSOLE_FORMAT_H__
+#define __AUTO_MIDDLEWARE_DLT_CONSOLE_FORMAT_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <atomic>
+#include <sys/uio.h>
+#include <dlt_enc_dec.h>
+#include <dlt_catalog.h>
+
+namespace auto_os::middleware {
+
+// bytes of rendered text kept until the next flush
+#define DLT_CONSOLE_OUT_SIZE (64 * 1024)
+
+// maximum length of the text of one message
+#define DLT_CONSOLE_LINE_MAX 4096
+
+// iovecs passed to one writev
+#define DLT_CONSOLE_IOV_MAX 512
+
+// strings up to this length are copied, longer ones are written in place
+#define DLT_CONSOLE_COPY_MAX 256
+
+/**
+ * @brief console line renderer
+ *
+ * A line is "[ecu] [counter] [app][ctx] [level] text". The prefix is
+ * built from pre rendered counters and level names into a reusable
+ * output buffer. A short string is copied after it, so consecutive lines
+ * share one iovec. The text of a long string message is not copied, an
+ * iovec points into the message itself, so the messages must stay valid
+ * until flush. A whole batch of lines goes out with one writev.
+ */
+class dlt_console_formatter {
+    public:
+        /**
+         * @brief create formatter
+         *
+         * @param in fd file descriptor lines are written to
+         * @param in ecu_id ecu id printed when a message carries none
+         * @param in catalog formats of non verbose messages, may be nullptr
+         */
+        explicit dlt_console_formatter(int fd, const uint8_t *ecu_id, dlt_catalog *catalog);
+        ~dlt_console_formatter() { }
+
+        dlt_console_formatter(const dlt_console_formatter &) = delete;
+        const dlt_console_formatter &operator=(const dlt_console_formatter &) = delete;
+        dlt_console_formatter(const dlt_console_formatter &&) = delete;
+        const dlt_console_formatter &&operator=(const dlt_console_formatter &&) = delete;
+
+        /**
+         * @brief render one encoded message, flushes first if the buffers are full
+         *
+         * @param in msg encoded dlt message, must stay valid until flush
+         * @param in len length of the message
+         * @return returns 0 on success -1 if it is not a dlt message
+         */
+        int format(const uint8_t *msg, int len);
+
+        /**
+         * @brief write the rendered lines
+         *
+         * @return returns 0 on success -1 if the lines could not be written
+         */
+        int flush();
+
+        /**
+         * @brief change the ecu id printed when a message carries none
+         */
+        inline void set_ecu_id(const uint8_t *ecu_id)
+        {
+            uint32_t id;
+
+            memcpy(&id, ecu_id, sizeof(id));
+            ecu_id_.store(id, std::memory_order_relaxed);
+        }
+
+        inline uint64_t get_writes() { return writes_; }
+        inline uint64_t get_write_errors() { return write_errors_; }
+
+    private:
+        inline char *out_ptr() { return out_ + out_len_; }
+        void add_out(size_t len);
+        void add_ref(const void *data, size_t len);
+        int format_args(dlt_msg_view &msg, char *str, int str_len);
+
+        int fd_;
+        // changed by a configuration reload
+        std::atomic<uint32_t> ecu_id_;
+        dlt_catalog *catalog_;
+        // "[n] " for every counter value
+        char counters_[256][8];
+        uint8_t counter_lens_[256];
+        std::string text_;
+
+        char out_[DLT_CONSOLE_OUT_SIZE];
+        size_t out_len_;
+        struct iovec iov_[DLT_CONSOLE_IOV_MAX];
+        int n_iov_;
+
+        uint64_t writes_;
+        uint64_t write_errors_;
+};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * @file dlt_console_sink.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief prints encoded dlt messages to the console from a thread of its own
+ * @version 0.1
+ * @date 2022-01-01
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <unistd.h>
+#include <dlt_console_sink.h>
+
+namespace auto_os::middleware {
+
+#define DLT_CONSOLE_LEN_FIELD 2
+
+dlt_console_sink::dlt_console_sink(size_t queue_size, const uint8_t *ecu_id, dlt_catalog *catalog) :
+                                queue_size_(queue_size),
+                                formatter_(STDERR_FILENO, ecu_id, catalog),
+                                stop_(false),
+                                dropped_(0)
+{
+    // both buffers keep their capacity when swapped
+    pending_.reserve(queue_size_);
+    drain_.reserve(queue_size_);
+
+    thr_ = std::thread(&dlt_console_sink::run, this);
+}
+
+dlt_console_sink::~dlt_console_sink()
+{
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+
+        stop_ = true;
+    }
+    cond_.notify_one();
+    thr_.join();
+}
+
+int dlt_console_sink::write(const uint8_t *msg, int len)
+{
+    uint16_t msg_len = len;
+    bool wake;
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+
+        if (pending_.size() + DLT_CONSOLE_LEN_FIELD + len > queue_size_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        wake = pending_.empty();
+        pending_.insert(pending_.end(), (uint8_t *)&msg_len, (uint8_t *)&msg_len + DLT_CONSOLE_LEN_FIELD);
+        pending_.insert(pending_.end(), msg, msg + len);
+    }
+
+    if (wake) {
+        cond_.notify_one();
+    }
+
+    return 0;
+}
+
+void dlt_console_sink::run()
+{
+    while (1) {
+        size_t off = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+
+            cond_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+            // messages queued before the stop are still printed
+            if (pending_.empty()) {
+                break;
+            }
+            drain_.swap(pending_);
+        }
+
+        while (off + DLT_CONSOLE_LEN_FIELD <= drain_.size()) {
+            uint16_t msg_len;
+
+            memcpy(&msg_len, drain_.data() + off, DLT_CONSOLE_LEN_FIELD);
+            formatter_.format(drain_.data() + off + DLT_CONSOLE_LEN_FIELD, msg_len);
+            off += DLT_CONSOLE_LEN_FIELD + msg_len;
+        }
+        // the lines refer to the messages, write them before the buffer
+        // is reused
+        formatter_.flush();
+        drain_.clear();
+    }
+}
+
+}
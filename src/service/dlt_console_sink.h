@@ -0,0 +1,82 @@
+/**
+ * @file dlt_console_sink.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief prints encoded dlt messages to the console from a thread of its own
+ * @version 0.1
+ * @date 2022-01-01
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_CONSOLE_SINK_H__
+#define __AUTO_MIDDLEWARE_DLT_CONSOLE_SINK_H__
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <dlt_catalog.h>
+#include <dlt_console_format.h>
+#include <dlt_sink.h>
+
+namespace auto_os::middleware {
+
+// default bytes of messages waiting to be printed
+#define DLT_CONSOLE_QUEUE_SIZE (256 * 1024)
+
+/**
+ * @brief console output of the service
+ *
+ * write appends the message with a 2 byte length to a pending buffer.
+ * the printing thread swaps it with its own buffer and renders the
+ * messages with dlt_console_formatter without holding the lock, one
+ * writev per batch, so the workers never wait for the terminal. when
+ * the pending buffer is full the message is dropped.
+ */
+class dlt_console_sink : public dlt_sink {
+    public:
+        /**
+         * @brief create sink and start the printing thread
+         *
+         * @param in queue_size bytes of messages waiting to be printed
+         * @param in ecu_id ecu id printed when a message carries none
+         * @param in catalog formats of non verbose messages
+         */
+        explicit dlt_console_sink(size_t queue_size, const uint8_t *ecu_id, dlt_catalog *catalog);
+        ~dlt_console_sink();
+
+        dlt_console_sink(const dlt_console_sink &) = delete;
+        const dlt_console_sink &operator=(const dlt_console_sink &) = delete;
+        dlt_console_sink(const dlt_console_sink &&) = delete;
+        const dlt_console_sink &&operator=(const dlt_console_sink &&) = delete;
+
+        int write(const uint8_t *msg, int len) override;
+
+        inline void set_ecu_id(const uint8_t *ecu_id) { formatter_.set_ecu_id(ecu_id); }
+
+        inline const char *get_name() override { return "console"; }
+        inline uint64_t get_dropped() override { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        void run();
+
+        size_t queue_size_;
+        // formats on the printing thread, set_ecu_id comes from the
+        // event_manager thread and the ecu id is read atomically
+        dlt_console_formatter formatter_;
+
+        std::mutex lock_;
+        std::condition_variable cond_;
+        // filled by the workers under lock_
+        std::vector<uint8_t> pending_;
+        // only touched by the printing thread
+        std::vector<uint8_t> drain_;
+        bool stop_;
+        std::atomic<uint64_t> dropped_;
+        std::thread thr_;
+};
+
+}
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * @file dlt_filter.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief log level filter by application and context id
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <dlt_filter.h>
+
+namespace auto_os::middleware {
+
+int dlt_filter_table::load(const std::string &default_level, const std::vector<dlt_filter_rule> &rules)
+{
+    uint8_t mask;
+
+    if (level_mask(default_level, mask) < 0) {
+        return -1;
+    }
+    default_mask_ = mask;
+
+    for (auto &rule : rules) {
+        if ((rule.app_id.length() == 0) || (rule.app_id.length() > 4) ||
+            (rule.ctx_id.length() == 0) || (rule.ctx_id.length() > 4) ||
+            (level_mask(rule.level, mask) < 0)) {
+            return -1;
+        }
+        set(rule.app_id, rule.ctx_id, mask);
+    }
+
+    return 0;
+}
+
+void dlt_filter_table::set(const std::string &app_id, const std::string &ctx_id, uint8_t mask)
+{
+    uint64_t key = make_key(pack_id(app_id), pack_id(ctx_id));
+    uint8_t old;
+
+    if (find(key, old)) {
+        insert(key, mask);
+        return;
+    }
+
+    // keep the table at most half full so probes stay short
+    if ((n_rules_ + 1) * 2 > slots_.size()) {
+        std::vector<slot> old_slots(slots_.size() * 2);
+
+        old_slots.swap(slots_);
+        shift_ --;
+        for (auto &s : old_slots) {
+            if (s.used) {
+                insert(s.key, s.mask);
+            }
+        }
+    }
+
+    insert(key, mask);
+    n_rules_ ++;
+}
+
+void dlt_filter_table::insert(uint64_t key, uint8_t mask)
+{
+    size_t n = slots_.size() - 1;
+    size_t i;
+
+    for (i = hash(key); slots_[i].used; i = (i + 1) & n) {
+        if (slots_[i].key == key) {
+            break;
+        }
+    }
+
+    slots_[i].key = key;
+    slots_[i].mask = mask;
+    slots_[i].used = true;
+}
+
+int dlt_filter_table::level_mask(const std::string &level, uint8_t &mask)
+{
+    // in order of severity
+    static const struct {
+        const char *name;
+        dlt_msg_log_lvl lvl;
+    } levels[] = {
+        {"verbose", DLT_MSG_LOG_LVL_VERBOSE},
+        {"info", DLT_MSG_LOG_LVL_INFO},
+        {"warning", DLT_MSG_LOG_LVL_WARNING},
+        {"error", DLT_MSG_LOG_LVL_ERROR},
+        {"fatal", DLT_MSG_LOG_LVL_FATAL},
+    };
+    size_t i;
+
+    if (level == "off") {
+        mask = 0;
+        return 0;
+    }
+
+    for (i = 0; i < sizeof(levels) / sizeof(levels[0]); i ++) {
+        if (level == levels[i].name) {
+            break;
+        }
+    }
+    if (i == sizeof(levels) / sizeof(levels[0])) {
+        return -1;
+    }
+
+    mask = 0;
+    for (; i < sizeof(levels) / sizeof(levels[0]); i ++) {
+        mask |= 1 << levels[i].lvl;
+    }
+
+    return 0;
+}
+
+uint32_t dlt_filter_table::pack_id(const std::string &id)
+{
+    uint8_t bytes[4] = {0, 0, 0, 0};
+    uint32_t packed;
+
+    // ids shorter than 4 characters are padded with 0, as on the wire
+    memcpy(bytes, id.data(), std::min(id.length(), sizeof(bytes)));
+    memcpy(&packed, bytes, sizeof(packed));
+
+    return packed;
+}
+
+}
@@ -0,0 +1,183 @@
+/**
+ * @file dlt_filter.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief log level filter by application and context id
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_FILTER_H__
+#define __AUTO_MIDDLEWARE_DLT_FILTER_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <dlt_msg_if.h>
+
+namespace auto_os::middleware {
+
+// context id of a rule that applies to all contexts of an application
+#define DLT_FILTER_ANY_CTX "*"
+
+// passes every level
+#define DLT_FILTER_MASK_ALL 0x3e
+
+/**
+ * @brief one filter rule from the configuration
+ */
+struct dlt_filter_rule {
+    std::string app_id;
+    std::string ctx_id;
+    std::string level;
+
+    inline bool operator==(const dlt_filter_rule &rule) const
+    {
+        return (app_id == rule.app_id) && (ctx_id == rule.ctx_id) && (level == rule.level);
+    }
+};
+
+/**
+ * @brief minimum log level per (app_id, ctx_id)
+ *
+ * the two ids are packed into one 64 bit key of an open addressing hash
+ * table, so a lookup is one multiply and usually one probe. the value is
+ * a bit mask of the passing dlt_msg_log_lvl values, the levels are not
+ * numbered by severity. a message is checked against its exact key, then
+ * against the DLT_FILTER_ANY_CTX rule of its application and at last the
+ * default.
+ */
+class dlt_filter_table {
+    public:
+        explicit dlt_filter_table() :
+                            default_mask_(DLT_FILTER_MASK_ALL),
+                            n_rules_(0),
+                            slots_(DLT_FILTER_MIN_SLOTS),
+                            shift_(64 - 4),
+                            any_ctx_(pack_id(DLT_FILTER_ANY_CTX))
+        { }
+        ~dlt_filter_table() { }
+
+        /**
+         * @brief build the table from the configured rules
+         * 
+         * @param in default_level minimum level of messages without a rule
+         * @param in rules filter rules
+         * @return returns 0 on success -1 if a level or id is invalid
+         */
+        int load(const std::string &default_level, const std::vector<dlt_filter_rule> &rules);
+
+        /**
+         * @brief set minimum level of an application and context
+         * 
+         * @param in app_id application id
+         * @param in ctx_id context id or DLT_FILTER_ANY_CTX
+         * @param in mask passing levels, see level_mask
+         */
+        void set(const std::string &app_id, const std::string &ctx_id, uint8_t mask);
+
+        inline void set_default(uint8_t mask) { default_mask_ = mask; }
+
+        /**
+         * @brief check if a message passes the filter
+         * 
+         * @param in app_id application id
+         * @param in ctx_id context id
+         * @param in log_lvl log level
+         * @return true if the message is to be processed
+         */
+        inline bool pass(const uint8_t *app_id, const uint8_t *ctx_id, uint8_t log_lvl)
+        {
+            uint8_t mask = default_mask_;
+
+            if (n_rules_ > 0) {
+                uint32_t app;
+                uint32_t ctx;
+
+                memcpy(&app, app_id, sizeof(app));
+                memcpy(&ctx, ctx_id, sizeof(ctx));
+
+                if (!find(make_key(app, ctx), mask)) {
+                    find(make_key(app, any_ctx_), mask);
+                }
+            }
+
+            return (log_lvl < 8) && (mask & (1 << log_lvl));
+        }
+
+        /**
+         * @brief get the mask of the levels at or above a level
+         * 
+         * @param in level verbose, info, warning, error, fatal or off
+         * @param out mask passing levels
+         * @return returns 0 on success -1 if the level is unknown
+         */
+        static int level_mask(const std::string &level, uint8_t &mask);
+
+        inline size_t size() { return n_rules_; }
+        inline uint8_t get_default() { return default_mask_; }
+
+        /**
+         * @brief call cb(key, mask) for every rule
+         */
+        template <typename Cb>
+        void for_each(Cb cb)
+        {
+            for (auto &s : slots_) {
+                if (s.used) {
+                    cb(s.key, s.mask);
+                }
+            }
+        }
+
+    private:
+        static constexpr size_t DLT_FILTER_MIN_SLOTS = 16;
+
+        struct slot {
+            uint64_t key;
+            uint8_t mask;
+            bool used;
+        };
+
+        static inline uint64_t make_key(uint32_t app, uint32_t ctx)
+        {
+            return ((uint64_t)app << 32) | ctx;
+        }
+
+        // top bits of the product, they depend on every bit of the key
+        inline size_t hash(uint64_t key)
+        {
+            return (key * 0x9e3779b97f4a7c15ULL) >> shift_;
+        }
+
+        inline bool find(uint64_t key, uint8_t &mask)
+        {
+            size_t n = slots_.size() - 1;
+
+            for (size_t i = hash(key); slots_[i].used; i = (i + 1) & n) {
+                if (slots_[i].key == key) {
+                    mask = slots_[i].mask;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void insert(uint64_t key, uint8_t mask);
+
+        static uint32_t pack_id(const std::string &id);
+
+        uint8_t default_mask_;
+        size_t n_rules_;
+        std::vector<slot> slots_;
+        // 64 - log2 of the number of slots
+        int shift_;
+        uint32_t any_ctx_;
+};
+
+}
+
+#endif
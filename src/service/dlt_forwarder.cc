@@ -0,0 +1,237 @@
+/**
+ * @file dlt_forwarder.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief batches encoded dlt messages towards the storage server
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <algorithm>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <dlt_compress.h>
+#include <dlt_forwarder.h>
+
+namespace auto_os::middleware {
+
+dlt_forwarder::dlt_forwarder(const std::string addr,
+                             int port,
+                             int batch_size,
+                             bool pack,
+                             int mtu,
+                             int compress_size,
+                             std::function<void(uint32_t tag)> release) :
+                        batch_size_(0),
+                        pack_(false),
+                        mtu_(0),
+                        release_(release),
+                        n_dgrams_(0),
+                        n_iovs_(0),
+                        cur_iov_(0),
+                        cur_len_(0),
+                        compress_size_(0),
+                        raw_len_(0),
+                        raw_bytes_(0),
+                        compressed_bytes_(0),
+                        send_errors_(0)
+{
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error("failed to create storage socket");
+    }
+
+    if (configure(addr, port, batch_size, pack, mtu, compress_size) < 0) {
+        close(fd_);
+        throw std::runtime_error("invalid storage server address");
+    }
+}
+
+int dlt_forwarder::configure(const std::string addr,
+                             int port,
+                             int batch_size,
+                             bool pack,
+                             int mtu,
+                             int compress_size)
+{
+    struct sockaddr_in dest;
+
+    // resolve the destination once instead of on every send
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr.c_str(), &dest.sin_addr) != 1) {
+        return -1;
+    }
+
+    // the queued datagrams point into the buffers resized below
+    flush();
+
+    dest_ = dest;
+    batch_size_ = std::max(batch_size, 1);
+    pack_ = pack;
+    mtu_ = mtu;
+    compress_size_ = compress_size;
+
+    msgs_.resize(batch_size_);
+    iovs_.resize(batch_size_ * (pack_ ? DLT_FWD_MAX_MSGS_PER_DGRAM : 1));
+    tags_.resize(iovs_.size());
+
+    if (compress_size_ > 0) {
+        raw_.resize(compress_size_);
+        blocks_.resize(batch_size_);
+        for (auto &block : blocks_) {
+            if (block.size() < dlt_block::bound(compress_size_)) {
+                block.resize(dlt_block::bound(compress_size_));
+            }
+        }
+    }
+
+    return 0;
+}
+
+dlt_forwarder::~dlt_forwarder()
+{
+    flush();
+    close(fd_);
+}
+
+void dlt_forwarder::queue(uint8_t *msg, int len, uint32_t tag)
+{
+    if (compress_size_ > 0) {
+        if (raw_len_ + len > compress_size_) {
+            close_block();
+            if (n_dgrams_ == batch_size_) {
+                flush();
+            }
+        }
+        // a message larger than the block goes alone
+        if (len > compress_size_) {
+            raw_.resize(len);
+        }
+        memcpy(raw_.data() + raw_len_, msg, len);
+        raw_len_ += len;
+        release_(tag);
+
+        if (raw_len_ >= compress_size_) {
+            close_block();
+            if (n_dgrams_ == batch_size_) {
+                flush();
+            }
+        }
+        return;
+    }
+
+    // message does not fit behind the ones already packed
+    if ((cur_len_ > 0) &&
+        ((cur_len_ + len > mtu_) || (n_iovs_ - cur_iov_ == DLT_FWD_MAX_MSGS_PER_DGRAM))) {
+        close_dgram();
+    }
+
+    if (n_dgrams_ == batch_size_) {
+        flush();
+    }
+
+    iovs_[n_iovs_].iov_base = msg;
+    iovs_[n_iovs_].iov_len = len;
+    tags_[n_iovs_] = tag;
+    n_iovs_ ++;
+    cur_len_ += len;
+
+    if (!pack_) {
+        close_dgram();
+    }
+
+    if (n_dgrams_ == batch_size_) {
+        flush();
+    }
+}
+
+void dlt_forwarder::close_dgram()
+{
+    struct msghdr *hdr = &msgs_[n_dgrams_].msg_hdr;
+
+    memset(&msgs_[n_dgrams_], 0, sizeof(struct mmsghdr));
+    hdr->msg_name = &dest_;
+    hdr->msg_namelen = sizeof(dest_);
+    hdr->msg_iov = &iovs_[cur_iov_];
+    hdr->msg_iovlen = n_iovs_ - cur_iov_;
+
+    n_dgrams_ ++;
+    cur_iov_ = n_iovs_;
+    cur_len_ = 0;
+}
+
+void dlt_forwarder::close_block()
+{
+    std::vector<uint8_t> &block = blocks_[n_dgrams_];
+    int len;
+
+    if (raw_len_ == 0) {
+        return;
+    }
+
+    if (block.size() < dlt_block::bound(raw_len_)) {
+        block.resize(dlt_block::bound(raw_len_));
+    }
+    len = dlt_block::encode(raw_.data(), raw_len_, false, block.data(), block.size());
+    raw_bytes_.fetch_add(raw_len_, std::memory_order_relaxed);
+    raw_len_ = 0;
+    if (len < 0) {
+        send_errors_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    compressed_bytes_.fetch_add(len, std::memory_order_relaxed);
+
+    iovs_[n_iovs_].iov_base = block.data();
+    iovs_[n_iovs_].iov_len = len;
+    n_iovs_ ++;
+    close_dgram();
+}
+
+int dlt_forwarder::flush()
+{
+    int sent = 0;
+    int ret;
+    int i;
+
+    if (raw_len_ > 0) {
+        close_block();
+    }
+
+    if (cur_len_ > 0) {
+        close_dgram();
+    }
+
+    if (n_dgrams_ == 0) {
+        return 0;
+    }
+
+    while (sent < n_dgrams_) {
+        ret = sendmmsg(fd_, msgs_.data() + sent, n_dgrams_ - sent, 0);
+        if (ret <= 0) {
+            // skip the datagram that failed and carry on with the rest
+            send_errors_.fetch_add(1, std::memory_order_relaxed);
+            sent ++;
+            continue;
+        }
+        sent += ret;
+    }
+
+    // compressed messages were released when they were copied
+    for (i = 0; (i < n_iovs_) && (compress_size_ == 0); i ++) {
+        release_(tags_[i]);
+    }
+
+    ret = n_dgrams_;
+    n_dgrams_ = 0;
+    n_iovs_ = 0;
+    cur_iov_ = 0;
+
+    return ret;
+}
+
+}
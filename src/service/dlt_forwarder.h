@@ -0,0 +1,150 @@
+/**
+ * @file dlt_forwarder.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief batches encoded dlt messages towards the storage server
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_FORWARDER_H__
+#define __AUTO_MIDDLEWARE_DLT_FORWARDER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace auto_os::middleware {
+
+// maximum number of packed messages in one datagram
+#define DLT_FWD_MAX_MSGS_PER_DGRAM 64
+
+/**
+ * @brief collects encoded messages and sends them with one sendmmsg
+ *
+ * Messages are not copied, each one is referenced by an iovec until the
+ * batch is flushed and then handed back through the release callback.
+ * Each datagram carries one message, or with packing enabled as many
+ * whole messages as fit in the mtu. With compression the messages are
+ * copied into a block of up to compress_size bytes and released right
+ * away, and each datagram carries one compressed dlt_block. Only called
+ * from the process thread.
+ */
+class dlt_forwarder {
+    public:
+        /**
+         * @brief create forwarder
+         * 
+         * @param in addr ipv4 address of the storage server
+         * @param in port port of the storage server
+         * @param in batch_size number of datagrams that triggers a flush
+         * @param in pack pack several messages in one datagram
+         * @param in mtu maximum datagram size when packing
+         * @param in compress_size messages per compressed datagram in bytes, 0 disables compression
+         * @param in release called with the tag of every message once sent
+         */
+        explicit dlt_forwarder(const std::string addr,
+                               int port,
+                               int batch_size,
+                               bool pack,
+                               int mtu,
+                               int compress_size,
+                               std::function<void(uint32_t tag)> release);
+        ~dlt_forwarder();
+
+        dlt_forwarder(const dlt_forwarder &) = delete;
+        const dlt_forwarder &operator=(const dlt_forwarder &) = delete;
+        dlt_forwarder(const dlt_forwarder &&) = delete;
+        const dlt_forwarder &&operator=(const dlt_forwarder &&) = delete;
+
+        /**
+         * @brief send what is queued and continue with other settings
+         *
+         * parameters are the same as for the constructor.
+         *
+         * @return returns 0 on success -1 if the address is invalid, the
+         *         settings are unchanged then
+         */
+        int configure(const std::string addr,
+                      int port,
+                      int batch_size,
+                      bool pack,
+                      int mtu,
+                      int compress_size);
+
+        /**
+         * @brief queue an encoded message, may flush the batch
+         * 
+         * @param in msg encoded message, must stay valid until released
+         * @param in len length of the message
+         * @param in tag passed to the release callback
+         */
+        void queue(uint8_t *msg, int len, uint32_t tag);
+
+        /**
+         * @brief send all queued datagrams and release their messages
+         * 
+         * @return returns number of datagrams flushed
+         */
+        int flush();
+
+        /**
+         * @brief check if messages are waiting for flush
+         */
+        inline bool has_pending() { return (n_iovs_ > 0) || (raw_len_ > 0); }
+
+        /**
+         * @brief number of datagrams that failed to send
+         */
+        inline uint64_t get_send_errors() { return send_errors_.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief bytes of messages and bytes sent for them when compressing
+         */
+        inline uint64_t get_raw_bytes() { return raw_bytes_.load(std::memory_order_relaxed); }
+        inline uint64_t get_compressed_bytes() { return compressed_bytes_.load(std::memory_order_relaxed); }
+
+    private:
+        /**
+         * @brief close the datagram currently being packed
+         */
+        void close_dgram();
+
+        /**
+         * @brief compress the collected messages into the next datagram
+         */
+        void close_block();
+
+        int fd_;
+        struct sockaddr_in dest_;
+        int batch_size_;
+        bool pack_;
+        int mtu_;
+        std::function<void(uint32_t tag)> release_;
+        std::vector<struct mmsghdr> msgs_;
+        // one iovec and tag per queued message
+        std::vector<struct iovec> iovs_;
+        std::vector<uint32_t> tags_;
+        int n_dgrams_;
+        int n_iovs_;
+        // first iovec and byte count of the datagram being packed
+        int cur_iov_;
+        int cur_len_;
+        // messages waiting for compression and one block per datagram
+        int compress_size_;
+        std::vector<uint8_t> raw_;
+        int raw_len_;
+        std::vector<std::vector<uint8_t>> blocks_;
+        // written by the worker, read by the stats endpoint
+        std::atomic<uint64_t> raw_bytes_;
+        std::atomic<uint64_t> compressed_bytes_;
+        std::atomic<uint64_t> send_errors_;
+};
+
+}
+
+#endif
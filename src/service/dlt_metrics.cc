@@ -0,0 +1,118 @@
+/**
+ * @file dlt_metrics.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief counters and latency histograms of the service threads
+ * @version 0.1
+ * @date 2022-01-03
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <dlt_metrics.h>
+
+namespace auto_os::middleware {
+
+uint64_t dlt_histogram_snapshot::count() const
+{
+    uint64_t n = 0;
+
+    for (int i = 0; i < DLT_METRICS_HIST_BUCKETS; i ++) {
+        n += buckets[i];
+    }
+
+    return n;
+}
+
+uint64_t dlt_histogram_snapshot::percentile(double p) const
+{
+    uint64_t n = count();
+    uint64_t seen = 0;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < DLT_METRICS_HIST_BUCKETS; i ++) {
+        seen += buckets[i];
+        if (seen >= p * n) {
+            return 2ULL << i;
+        }
+    }
+
+    return 2ULL << (DLT_METRICS_HIST_BUCKETS - 1);
+}
+
+dlt_histogram_snapshot dlt_histogram_snapshot::since(const dlt_histogram_snapshot &prev) const
+{
+    dlt_histogram_snapshot snap;
+
+    for (int i = 0; i < DLT_METRICS_HIST_BUCKETS; i ++) {
+        snap.buckets[i] = buckets[i] - prev.buckets[i];
+    }
+    snap.sum = sum - prev.sum;
+
+    return snap;
+}
+
+void dlt_histogram::merge(dlt_histogram_snapshot &snap) const
+{
+    for (int i = 0; i < DLT_METRICS_HIST_BUCKETS; i ++) {
+        snap.buckets[i] += buckets_[i].get();
+    }
+    snap.sum += sum_.get();
+}
+
+void dlt_metrics_snapshot::add(const dlt_thread_metrics &metrics)
+{
+    rx_msgs += metrics.rx_msgs.get();
+    rx_bytes += metrics.rx_bytes.get();
+    for (int i = 0; i < DLT_DROP_REASONS; i ++) {
+        drops[i] += metrics.drops[i].get();
+    }
+    encoded += metrics.encoded.get();
+    metrics.encode_ns.merge(encode_ns);
+    metrics.sink_ns.merge(sink_ns);
+    metrics.forward_ns.merge(forward_ns);
+}
+
+void dlt_app_counters::add(const uint8_t *app_id)
+{
+    uint32_t id;
+    uint64_t key;
+
+    memcpy(&id, app_id, sizeof(id));
+    key = id | (1ULL << 32);
+
+    for (uint32_t i = 0; i < DLT_METRICS_MAX_APPS; i ++) {
+        slot *s = &slots_[((id * 0x9e3779b1) + i) % DLT_METRICS_MAX_APPS];
+        uint64_t cur = s->key.load(std::memory_order_relaxed);
+
+        if (cur == 0) {
+            s->key.store(key, std::memory_order_release);
+            cur = key;
+        }
+        if (cur == key) {
+            s->count.add();
+            return;
+        }
+    }
+
+    other_.add();
+}
+
+void dlt_app_counters::for_each(const std::function<void(const uint8_t *app_id, uint64_t count)> &cb) const
+{
+    for (uint32_t i = 0; i < DLT_METRICS_MAX_APPS; i ++) {
+        uint64_t key = slots_[i].key.load(std::memory_order_acquire);
+        uint32_t id = (uint32_t)key;
+
+        if (key != 0) {
+            cb((const uint8_t *)&id, slots_[i].count.get());
+        }
+    }
+    if (other_.get() > 0) {
+        cb(nullptr, other_.get());
+    }
+}
+
+}
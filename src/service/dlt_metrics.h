@@ -0,0 +1,194 @@
+/**
+ * @file dlt_metrics.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief counters and latency histograms of the service threads
+ * @version 0.1
+ * @date 2022-01-03
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_METRICS_H__
+#define __AUTO_MIDDLEWARE_DLT_METRICS_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <functional>
+
+namespace auto_os::middleware {
+
+// latency buckets, bucket i counts values of [2^i, 2^(i + 1)) ns
+#define DLT_METRICS_HIST_BUCKETS 32
+
+// one message in this many is timed, reading the clock costs more than
+// the rest of the metrics together
+#define DLT_METRICS_SAMPLE_RATE 32
+
+// applications counted separately, the rest are counted as one
+#define DLT_METRICS_MAX_APPS 256
+
+static inline uint64_t dlt_metrics_now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief counter written by one thread and read by any
+ *
+ * a relaxed load and store instead of an atomic add, the writer never
+ * races with another writer.
+ */
+class dlt_counter {
+    public:
+        dlt_counter() : val_(0) { }
+
+        inline void add(uint64_t n = 1)
+        {
+            val_.store(val_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        inline void set_max(uint64_t n)
+        {
+            if (n > val_.load(std::memory_order_relaxed)) {
+                val_.store(n, std::memory_order_relaxed);
+            }
+        }
+
+        inline uint64_t get() const { return val_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> val_;
+};
+
+/**
+ * @brief merged buckets of one or more histograms
+ */
+struct dlt_histogram_snapshot {
+    uint64_t buckets[DLT_METRICS_HIST_BUCKETS] = {};
+    uint64_t sum = 0;
+
+    uint64_t count() const;
+
+    /**
+     * @brief upper bound of the bucket holding the given percentile
+     *
+     * @param in p percentile between 0 and 1
+     * @return returns ns, 0 if there are no samples
+     */
+    uint64_t percentile(double p) const;
+
+    /**
+     * @brief samples recorded after an earlier snapshot was taken
+     */
+    dlt_histogram_snapshot since(const dlt_histogram_snapshot &prev) const;
+};
+
+/**
+ * @brief log2 latency histogram written by one thread
+ */
+class dlt_histogram {
+    public:
+        inline void record(uint64_t ns)
+        {
+            int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+
+            if (bucket >= DLT_METRICS_HIST_BUCKETS) {
+                bucket = DLT_METRICS_HIST_BUCKETS - 1;
+            }
+            buckets_[bucket].add();
+            sum_.add(ns);
+        }
+
+        void merge(dlt_histogram_snapshot &snap) const;
+
+    private:
+        dlt_counter buckets_[DLT_METRICS_HIST_BUCKETS];
+        dlt_counter sum_;
+};
+
+/**
+ * @brief why a received message was dropped
+ */
+enum class dlt_drop_reason {
+    // too short, too long or with an unknown level
+    INVALID,
+    // below the level of its filter rule
+    FILTERED,
+    // arguments that do not parse or an unknown type
+    MALFORMED,
+    COUNT,
+};
+
+#define DLT_DROP_REASONS static_cast<int>(dlt_drop_reason::COUNT)
+
+/**
+ * @brief metrics of one thread, the receive thread or a worker
+ *
+ * each thread only writes its own block, so nothing is locked or shared
+ * on the hot path. readers sum the blocks of all threads.
+ */
+struct alignas(64) dlt_thread_metrics {
+    dlt_counter rx_msgs;
+    dlt_counter rx_bytes;
+    dlt_counter drops[DLT_DROP_REASONS];
+    dlt_counter encoded;
+    dlt_histogram encode_ns;
+    dlt_histogram sink_ns;
+    dlt_histogram forward_ns;
+
+    inline void drop(dlt_drop_reason reason)
+    {
+        drops[static_cast<int>(reason)].add();
+    }
+};
+
+/**
+ * @brief sum of the metrics of several threads
+ */
+struct dlt_metrics_snapshot {
+    uint64_t rx_msgs = 0;
+    uint64_t rx_bytes = 0;
+    uint64_t drops[DLT_DROP_REASONS] = {};
+    uint64_t encoded = 0;
+    dlt_histogram_snapshot encode_ns;
+    dlt_histogram_snapshot sink_ns;
+    dlt_histogram_snapshot forward_ns;
+
+    void add(const dlt_thread_metrics &metrics);
+};
+
+/**
+ * @brief message counts by application id, written by one thread
+ *
+ * open addressing on the 4 byte id, a slot is claimed once and never
+ * freed. readers see a slot once its key is published.
+ */
+class dlt_app_counters {
+    public:
+        void add(const uint8_t *app_id);
+
+        /**
+         * @brief call cb for every application counted so far
+         *
+         * @param in cb receives the id, nullptr for the applications that
+         *              did not get a slot, and the count
+         */
+        void for_each(const std::function<void(const uint8_t *app_id, uint64_t count)> &cb) const;
+
+    private:
+        struct slot {
+            // app id with bit 32 set, 0 if the slot is free
+            std::atomic<uint64_t> key{0};
+            dlt_counter count;
+        };
+
+        slot slots_[DLT_METRICS_MAX_APPS];
+        dlt_counter other_;
+};
+
+}
+
+#endif
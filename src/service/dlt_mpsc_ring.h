@@ -0,0 +1,122 @@
+/**
+ * @file dlt_mpsc_ring.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief bounded lock free multi producer single consumer ring
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_MPSC_RING_H__
+#define __AUTO_MIDDLEWARE_DLT_MPSC_RING_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief lock free ring between any number of producers and one consumer
+ *
+ * every slot carries a sequence number. a producer claims a slot by moving
+ * tail_ with a compare and swap and marks it full by bumping the sequence,
+ * the consumer marks it free again by moving the sequence a lap ahead.
+ */
+template <typename T>
+class dlt_mpsc_ring {
+    public:
+        /**
+         * @brief create ring
+         * 
+         * @param in capacity number of slots, must be a power of 2
+         */
+        explicit dlt_mpsc_ring(size_t capacity) :
+                            slots_(new slot[capacity]),
+                            capacity_(capacity),
+                            head_(0),
+                            tail_(0)
+        {
+            if ((capacity == 0) || ((capacity & (capacity - 1)) != 0)) {
+                throw std::runtime_error("ring capacity must be a power of 2");
+            }
+            for (size_t i = 0; i < capacity; i ++) {
+                slots_[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+        ~dlt_mpsc_ring() { }
+
+        dlt_mpsc_ring(const dlt_mpsc_ring &) = delete;
+        const dlt_mpsc_ring &operator=(const dlt_mpsc_ring &) = delete;
+        dlt_mpsc_ring(const dlt_mpsc_ring &&) = delete;
+        const dlt_mpsc_ring &&operator=(const dlt_mpsc_ring &&) = delete;
+
+        /**
+         * @brief add an element, called from any producer
+         * 
+         * @param in val element
+         * @return true if added
+         * @return false if the ring is full
+         */
+        inline bool push(const T &val)
+        {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+
+            while (1) {
+                slot *s = &slots_[tail & (capacity_ - 1)];
+                size_t seq = s->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)tail;
+
+                if (diff == 0) {
+                    if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                        s->val = val;
+                        s->seq.store(tail + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    tail = tail_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        /**
+         * @brief take the oldest element, called from the consumer
+         * 
+         * @param out val element
+         * @return true if an element was taken
+         * @return false if the ring is empty
+         */
+        inline bool pop(T &val)
+        {
+            slot *s = &slots_[head_ & (capacity_ - 1)];
+
+            if (s->seq.load(std::memory_order_acquire) != head_ + 1) {
+                return false;
+            }
+
+            val = s->val;
+            s->seq.store(head_ + capacity_, std::memory_order_release);
+            head_ ++;
+
+            return true;
+        }
+
+    private:
+        struct slot {
+            std::atomic<size_t> seq;
+            T val;
+        };
+
+        std::unique_ptr<slot[]> slots_;
+        size_t capacity_;
+        // only touched by the consumer
+        alignas(64) size_t head_;
+        alignas(64) std::atomic<size_t> tail_;
+};
+
+}
+
+#endif
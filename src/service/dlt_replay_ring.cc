@@ -0,0 +1,114 @@
+/**
+ * @file dlt_replay_ring.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief byte bounded history of recently encoded dlt messages
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <vector>
+#include <dlt_replay_ring.h>
+
+namespace auto_os::middleware {
+
+#define DLT_REPLAY_LEN_FIELD 2
+
+dlt_replay_ring::dlt_replay_ring(size_t size) :
+                        buf_(new uint8_t[size]),
+                        size_(size),
+                        head_(0),
+                        tail_(0)
+{
+}
+
+void dlt_replay_ring::write_bytes(uint64_t pos, const uint8_t *data, size_t len)
+{
+    size_t off = pos % size_;
+    size_t first = std::min(len, size_ - off);
+
+    memcpy(buf_.get() + off, data, first);
+    memcpy(buf_.get(), data + first, len - first);
+}
+
+void dlt_replay_ring::read_bytes(uint64_t pos, uint8_t *data, size_t len)
+{
+    size_t off = pos % size_;
+    size_t first = std::min(len, size_ - off);
+
+    memcpy(data, buf_.get() + off, first);
+    memcpy(data + first, buf_.get(), len - first);
+}
+
+uint16_t dlt_replay_ring::read_len(uint64_t pos)
+{
+    uint16_t len;
+
+    read_bytes(pos, (uint8_t *)&len, sizeof(len));
+
+    return len;
+}
+
+void dlt_replay_ring::push(const uint8_t *msg, uint16_t msg_len)
+{
+    size_t need = DLT_REPLAY_LEN_FIELD + msg_len;
+
+    // never going to fit
+    if (need > size_) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(lock_);
+
+    // drop the oldest messages until there is room
+    while (tail_ + need - head_ > size_) {
+        head_ += DLT_REPLAY_LEN_FIELD + read_len(head_);
+    }
+
+    write_bytes(tail_, (uint8_t *)&msg_len, DLT_REPLAY_LEN_FIELD);
+    write_bytes(tail_ + DLT_REPLAY_LEN_FIELD, msg, msg_len);
+    tail_ += need;
+}
+
+int dlt_replay_ring::replay(std::function<void(const uint8_t *msg, uint16_t msg_len)> cb,
+                            uint64_t *pos)
+{
+    std::vector<uint8_t> copy;
+    size_t off = 0;
+    int count = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        // an offset already evicted starts at the oldest message
+        uint64_t start = (pos && (*pos > head_)) ? *pos : head_;
+
+        copy.resize(tail_ - start);
+        read_bytes(start, copy.data(), copy.size());
+        if (pos) {
+            *pos = tail_;
+        }
+    }
+
+    while (off + DLT_REPLAY_LEN_FIELD <= copy.size()) {
+        uint16_t len;
+
+        memcpy(&len, copy.data() + off, DLT_REPLAY_LEN_FIELD);
+        off += DLT_REPLAY_LEN_FIELD;
+
+        cb(copy.data() + off, len);
+        off += len;
+        count ++;
+    }
+
+    return count;
+}
+
+size_t dlt_replay_ring::get_used()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+
+    return tail_ - head_;
+}
+
+}
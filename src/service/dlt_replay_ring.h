@@ -0,0 +1,95 @@
+/**
+ * @file dlt_replay_ring.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief byte bounded history of recently encoded dlt messages
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_REPLAY_RING_H__
+#define __AUTO_MIDDLEWARE_DLT_REPLAY_RING_H__
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <dlt_sink.h>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief ring of encoded messages stored back to back at their actual size
+ *
+ * each entry is a 2 byte length followed by the encoded message, entries may
+ * wrap around the end of the buffer. when a new message does not fit, the
+ * oldest ones are dropped.
+ */
+class dlt_replay_ring : public dlt_sink {
+    public:
+        /**
+         * @brief create ring
+         * 
+         * @param in size byte budget of the ring
+         */
+        explicit dlt_replay_ring(size_t size);
+        ~dlt_replay_ring() { }
+
+        dlt_replay_ring(const dlt_replay_ring &) = delete;
+        const dlt_replay_ring &operator=(const dlt_replay_ring &) = delete;
+        dlt_replay_ring(const dlt_replay_ring &&) = delete;
+        const dlt_replay_ring &&operator=(const dlt_replay_ring &&) = delete;
+
+        /**
+         * @brief add an encoded message, evicting the oldest ones if needed
+         * 
+         * @param in msg encoded message
+         * @param in msg_len length of the message
+         */
+        void push(const uint8_t *msg, uint16_t msg_len);
+
+        inline int write(const uint8_t *msg, int len) override
+        {
+            push(msg, len);
+            return 0;
+        }
+
+        inline const char *get_name() override { return "replay"; }
+        // the oldest messages make room, a new one is never dropped
+        inline uint64_t get_dropped() override { return 0; }
+
+        /**
+         * @brief call cb for every stored message from oldest to newest
+         * 
+         * the messages are copied out under the lock and cb is called
+         * without holding it, so cb may block on I/O.
+         *
+         * @param in cb callback receiving message and length
+         * @param in,out pos if not nullptr, only the messages added after this
+         *        offset are replayed, the offset reached is stored back
+         * @return returns number of messages replayed
+         */
+        int replay(std::function<void(const uint8_t *msg, uint16_t msg_len)> cb,
+                   uint64_t *pos = nullptr);
+
+        /**
+         * @brief bytes currently in use including the length fields
+         */
+        size_t get_used();
+
+    private:
+        void write_bytes(uint64_t pos, const uint8_t *data, size_t len);
+        void read_bytes(uint64_t pos, uint8_t *data, size_t len);
+        uint16_t read_len(uint64_t pos);
+
+        std::unique_ptr<uint8_t[]> buf_;
+        size_t size_;
+        // running byte offsets, the position in buf_ is offset % size_
+        uint64_t head_;
+        uint64_t tail_;
+        std::mutex lock_;
+};
+
+}
+
+#endif
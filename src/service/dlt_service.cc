@@ -10,44 +10,175 @@
 #include <getopt.h>
 #include <fstream>
 #include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <poll.h>
+#include <stdarg.h>
 #include <functional>
+#include <algorithm>
 #include <jsoncpp/json/json.h>
 #include <dlt_msg_if.h>
 #include <dlt_service.h>
 
 namespace auto_os::middleware {
 
+static const char *drop_reason_names[DLT_DROP_REASONS] = {
+    "invalid",
+    "filtered",
+    "malformed",
+};
+
+static void parse_filter_section(const Json::Value &filters,
+                                 std::string &default_level,
+                                 std::vector<dlt_filter_rule> &rules)
+{
+    default_level = filters.get("default_level", "verbose").asString();
+
+    rules.clear();
+    for (auto &rule : filters["rules"]) {
+        rules.push_back({rule["app_id"].asString(),
+                         rule.get("ctx_id", DLT_FILTER_ANY_CTX).asString(),
+                         rule["level"].asString()});
+    }
+}
+
 int dlt_config::parse(const std::string config_file)
 {
     Json::Value root;
     std::ifstream conf(config_file, std::ifstream::binary);
 
-    conf >> root;
+    // a file that is still being written does not parse and a value of
+    // the wrong type does not convert, the caller keeps the configuration
+    // it has
+    try {
+        conf >> root;
+
+        use_ext_hdr = root["htype_use_extended_hdr"].asBool();
+        use_msb_first = root["htype_msb_first"].asBool();
+        send_ecu_id = root["htype_send_ecu_id"].asBool();
+        send_timestamp = root["htype_send_timestamp"].asBool();
+        client_timestamps = root.get("htype_timestamp_source", "client").asString() != "daemon";
+        version = root["htype_version"].asInt();
+        verbose_mode = root["ext_hdr_verbose_mode"].asBool();
+        ecu_id = root["htype_ecu_id"].asString();
+        auto socket_type = root["network"]["socket_type"].asString();
+        if (socket_type == "unix") {
+            conn_type = network_conn_type::UNIX;
+        } else if (socket_type == "udpv4") {
+            conn_type = network_conn_type::UDP;
+        }
+
+        unix_server_path = root["network"]["unix_socket"]["server_path"].asString();
+        shm_server_path = root["network"]["unix_socket"].get("shm_server_path", "").asString();
+        shm_max_ring_size = std::max(1, root["network"]["unix_socket"].get("shm_max_ring_size_kb",
+                                            DLT_SHM_MAX_RING_SIZE_KB).asInt()) * 1024UL;
+        storage_service_addr = root["network"]["storage_server"]["server_address"].asString();
+        storage_service_port = root["network"]["storage_server"]["server_port"].asInt();
+        storage_batch_size = root["network"]["storage_server"].get("batch_size",
+                                            DLT_STORAGE_BATCH_SIZE).asInt();
+        storage_flush_interval_ms = root["network"]["storage_server"].get("flush_interval_ms",
+                                            DLT_STORAGE_FLUSH_INTERVAL_MS).asInt();
+        storage_pack_msgs = root["network"]["storage_server"].get("pack_messages", false).asBool();
+        storage_mtu = root["network"]["storage_server"].get("mtu", DLT_STORAGE_MTU).asInt();
+        storage_compress = root["network"]["storage_server"].get("compress", false).asBool();
+        storage_compress_size = std::max(1, root["network"]["storage_server"].get("compress_size",
+                                            DLT_STORAGE_COMPRESS_SIZE).asInt());
+
+        auto &viewer = root["network"]["viewer_server"];
+
+        viewer_server = viewer.get("enabled", false).asBool();
+        viewer_address = viewer.get("address", DLT_VIEWER_ADDRESS).asString();
+        viewer_port = viewer.get("port", DLT_VIEWER_PORT).asInt();
+        viewer_queue_size = std::max(1, viewer.get("queue_size_kb", DLT_VIEWER_QUEUE_SIZE_KB).asInt()) * 1024;
+        viewer_max_clients = std::min(std::max(1, viewer.get("max_clients", DLT_VIEWER_MAX_CLIENTS).asInt()),
+                                      DLT_VIEWER_MAX_CLIENTS);
+        log_to_console = root["log_to_console"].asBool();
+        console_queue_size = std::max(1, root.get("console_queue_size_kb",
+                                        DLT_CONSOLE_QUEUE_SIZE / 1024).asInt()) * 1024;
+        rx_buffer_pool_size = root.get("rx_buffer_pool_size", DLT_RX_POOL_SIZE).asInt();
+        rx_batch_size = root.get("rx_batch_size", DLT_RX_BATCH_SIZE).asInt();
+        process_workers = root.get("process_workers", DLT_PROCESS_WORKERS).asInt();
+        replay_buffer_size = root.get("replay_buffer_size", DLT_REPLAY_BUFFER_SIZE).asInt();
+        nonverbose_catalog = root.get("nonverbose_catalog", "").asString();
+        publish_filters = root["filters"].get("publish", true).asBool();
+
+        auto &storage = root["storage"];
+        auto fsync = storage.get("fsync", "segment").asString();
+
+        file_storage = storage.get("enabled", false).asBool();
+        file_storage_config.directory = storage.get("directory", DLT_FILE_STORAGE_DIRECTORY).asString();
+        file_storage_config.prefix = storage.get("prefix", DLT_FILE_STORAGE_PREFIX).asString();
+        file_storage_config.segment_size = storage.get("segment_size_mb",
+                                            DLT_FILE_STORAGE_SEGMENT_SIZE_MB).asUInt64() * 1024 * 1024;
+        file_storage_config.segment_duration_s = storage.get("segment_duration_s", 0).asInt();
+        file_storage_config.max_segments = storage.get("max_segments", DLT_FILE_STORAGE_MAX_SEGMENTS).asInt();
+        file_storage_config.block_size = storage.get("block_size_kb",
+                                            DLT_FILE_STORAGE_BLOCK_SIZE_KB).asUInt64() * 1024;
+        file_storage_config.flush_interval_ms = std::max(1, storage.get("flush_interval_ms",
+                                            DLT_FILE_STORAGE_FLUSH_INTERVAL_MS).asInt());
+        file_storage_config.fsync_interval_ms = storage.get("fsync_interval_ms",
+                                            DLT_FILE_STORAGE_FSYNC_INTERVAL_MS).asInt();
+        file_storage_config.direct_io = storage.get("direct_io", true).asBool();
+        file_storage_config.index = storage.get("index", true).asBool();
+        file_storage_config.compress = storage.get("compress", false).asBool();
+        if (fsync == "none") {
+            file_storage_config.fsync = dlt_fsync_policy::NONE;
+        } else if (fsync == "interval") {
+            file_storage_config.fsync = dlt_fsync_policy::INTERVAL;
+        } else if (fsync == "batch") {
+            file_storage_config.fsync = dlt_fsync_policy::BATCH;
+        } else {
+            file_storage_config.fsync = dlt_fsync_policy::SEGMENT;
+        }
+        parse_filter_section(root["filters"], filter_default_level, filter_rules);
+
+        auto &metrics_conf = root["metrics"];
 
-    use_ext_hdr = root["htype_use_extended_hdr"].asBool();
-    use_msb_first = root["htype_msb_first"].asBool();
-    send_ecu_id = root["htype_send_ecu_id"].asBool();
-    send_timestamp = root["htype_send_timestamp"].asBool();
-    version = root["htype_version"].asInt();
-    verbose_mode = root["ext_hdr_verbose_mode"].asBool();
-    ecu_id = root["htype_ecu_id"].asString();
-    auto socket_type = root["network"]["socket_type"].asString();
-    if (socket_type == "unix") {
-        conn_type = network_conn_type::UNIX;
-    } else if (socket_type == "udpv4") {
-        conn_type = network_conn_type::UDP;
+        metrics = metrics_conf.get("enabled", true).asBool();
+        metrics_socket_path = metrics_conf.get("socket_path", DLT_METRICS_SOCKET_PATH).asString();
+        metrics_interval_ms = metrics_conf.get("interval_ms", DLT_METRICS_INTERVAL_MS).asInt();
+    } catch (std::exception &e) {
+        return -1;
     }
 
-    unix_server_path = root["network"]["unix_socket"]["server_path"].asString();
-    storage_service_addr = root["network"]["storage_server"]["server_address"].asString();
-    storage_service_port = root["network"]["storage_server"]["server_port"].asInt();
-    log_to_console = root["log_to_console"].asBool();
+    if (rx_batch_size < 1) {
+        rx_batch_size = 1;
+    } else if (rx_batch_size > DLT_RX_BATCH_SIZE_MAX) {
+        rx_batch_size = DLT_RX_BATCH_SIZE_MAX;
+    }
+    if (process_workers < 1) {
+        process_workers = 1;
+    } else if (process_workers > DLT_PROCESS_WORKERS_MAX) {
+        process_workers = DLT_PROCESS_WORKERS_MAX;
+    }
 
     return 0;
 }
 
-dlt_service::dlt_service(std::string &filename)
+dlt_service::dlt_service(std::string &filename) :
+                            config_(nullptr),
+                            config_watch_fd_(-1),
+                            filter_page_(nullptr),
+                            rx_pool_empty_(false),
+                            shm_stalled_(false),
+                            metrics_(false),
+                            stats_fd_(-1),
+                            stats_timer_fd_(-1),
+                            stats_at_ns_(0),
+                            stats_pool_empty_(0)
 {
+    std::unique_ptr<dlt_config> parsed = std::make_unique<dlt_config>();
+    std::unique_ptr<dlt_config_snapshot> snap;
     dlt_config *config;
     int ret;
 
@@ -56,8 +187,7 @@ dlt_service::dlt_service(std::string &filename)
     }
 
     // parse configuration
-    config = dlt_config::instance();
-    ret = config->parse(filename);
+    ret = parsed->parse(filename);
     if (ret < 0) {
         throw std::runtime_error("failed to parse dlt config file");
     }
@@ -73,24 +203,147 @@ dlt_service::dlt_service(std::string &filename)
     // (MCNT) shall be set to ‘0’. ⌋()
     log_->debug("starting dlt_service\n");
     msg_counter_ = 0;
+    start_time_ = std::chrono::steady_clock::now();
+    clock_ = dlt_clock::instance();
+
+    // ecu id, header template and message info
+    snap = make_config(std::move(parsed), nullptr);
+    if (!snap) {
+        throw std::runtime_error("failed to build dlt header template");
+    }
+    config = snap->config.get();
+    client_timestamps_ = config->client_timestamps;
+
+    config_file_ = filename;
+    if (config->publish_filters) {
+        setup_filter_page();
+    }
+    if (load_filters(config) < 0) {
+        throw std::runtime_error("invalid filters in dlt config file");
+    }
+
+    // SIGHUP reloads the configuration, blocked before any thread is
+    // created so that it is only seen through the signalfd
+    sigset_t sig_mask;
+
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &sig_mask, nullptr);
+    sig_fd_ = signalfd(-1, &sig_mask, SFD_CLOEXEC);
+    if (sig_fd_ < 0) {
+        throw std::runtime_error("failed to create signalfd");
+    }
+    evt_mgr_->create_socket_event(sig_fd_, std::bind(&dlt_service::receive_signal, this, std::placeholders::_1));
+
+    // non verbose messages are forwarded as is, the catalog only expands
+    // them for the console
+    if (!config->nonverbose_catalog.empty()) {
+        if (catalog_.load(config->nonverbose_catalog) < 0) {
+            log_->error("failed to load catalog [%s]\n", config->nonverbose_catalog.c_str());
+        } else {
+            log_->debug("loaded %zu formats from catalog [%s]\n", catalog_.size(),
+                                                               config->nonverbose_catalog.c_str());
+        }
+    }
 
-    // setup ecu id
-    fill_ecu_id();
+    // receive buffers, each worker ring holds at most one entry per
+    // buffer so it can never overflow
+    size_t pool_size = 1;
+    while (pool_size < (size_t)config->rx_buffer_pool_size) {
+        pool_size <<= 1;
+    }
+    rx_buf_pool_ = std::make_unique<dlt_buf_pool>(pool_size, DLT_RX_BUF_SIZE);
+    log_->debug("created rx buffer pool of %zu x %d bytes\n", pool_size, DLT_RX_BUF_SIZE);
+
+    if (config->file_storage) {
+        file_storage_ = std::make_unique<dlt_file_storage>(config->file_storage_config, snap->ecu_id);
+        log_->debug("storing messages in [%s]\n", config->file_storage_config.directory.c_str());
+    }
+
+    if (config->replay_buffer_size > 0) {
+        enc_msg_list_ = std::make_unique<dlt_replay_ring>(config->replay_buffer_size);
+        log_->debug("created replay buffer of %d bytes\n", config->replay_buffer_size);
+    }
+
+    if (config->viewer_server) {
+        viewer_server_ = std::make_unique<dlt_viewer_server>(config->viewer_address,
+                                                             config->viewer_port,
+                                                             config->viewer_queue_size,
+                                                             config->viewer_max_clients,
+                                                             enc_msg_list_.get());
+        log_->debug("viewer server on [%s:%d]\n", config->viewer_address.c_str(), config->viewer_port);
+    }
+
+    setup_sinks(snap.get());
+
+    // workers sleep on their eventfd until the receive callback queues messages,
+    // each one forwards on its own socket
+    for (int i = 0; i < config->process_workers; i ++) {
+        auto worker = std::make_unique<dlt_worker>();
+
+        worker->rx_msg_list = std::make_unique<dlt_spsc_ring<dlt_rx_msg>>(pool_size);
+        worker->rx_pending = false;
+        worker->metrics_sample = DLT_METRICS_SAMPLE_RATE;
+        worker->storage_generation = snap->storage_generation;
+        worker->config_in_use = nullptr;
+        worker->rx_evt_fd = eventfd(0, EFD_CLOEXEC);
+        if (worker->rx_evt_fd < 0) {
+            throw std::runtime_error("failed to create rx eventfd");
+        }
+        worker->storage_client = std::make_unique<dlt_forwarder>(config->storage_service_addr,
+                                                                 config->storage_service_port,
+                                                                 config->storage_batch_size,
+                                                                 config->storage_pack_msgs,
+                                                                 config->storage_mtu,
+                                                                 config->storage_compress ?
+                                                                    config->storage_compress_size : 0,
+                                                                 [this](uint32_t buf_idx) {
+                                                                     rx_buf_pool_->free(buf_idx);
+                                                                 });
+        workers_.push_back(std::move(worker));
+    }
+    log_->debug("created %d process workers with client interface to storage\n", config->process_workers);
 
     // create local unix socket for receiving messages from applications
     server_ = std::make_shared<auto_os::lib::unix_udp_server>(config->unix_server_path);
-    auto rx_callback = std::bind(&dlt_service::receive_dlt_message, this, std::placeholders::_1);
-    evt_mgr_->create_socket_event(server_->get_socket(), rx_callback);
-    log_->debug("created unix udp server [%s]\n", config->unix_server_path.c_str());
+    if (config->rx_batch_size > 1) {
+        auto rx_callback = std::bind(&dlt_service::receive_dlt_message_batch, this, std::placeholders::_1);
+        evt_mgr_->create_socket_event(server_->get_socket(), rx_callback);
+        rx_spare_bufs_.reserve(config->rx_batch_size);
+    } else {
+        auto rx_callback = std::bind(&dlt_service::receive_dlt_message, this, std::placeholders::_1);
+        evt_mgr_->create_socket_event(server_->get_socket(), rx_callback);
+    }
+    log_->debug("created unix udp server [%s] rx batch %d\n", config->unix_server_path.c_str(),
+                                                              config->rx_batch_size);
+
+    // shared memory transport, clients hand over their rings on this socket
+    if (!config->shm_server_path.empty()) {
+        shm_server_ = std::make_unique<dlt_shm_server>(config->shm_server_path,
+                                                     config->shm_max_ring_size);
+        evt_mgr_->create_socket_event(shm_server_->get_socket(),
+                                      std::bind(&dlt_service::accept_shm_client, this, std::placeholders::_1));
+        evt_mgr_->create_socket_event(shm_server_->get_pending_event(),
+                                      std::bind(&dlt_service::receive_shm_handover, this, std::placeholders::_1));
+        evt_mgr_->create_socket_event(shm_server_->get_event(),
+                                      std::bind(&dlt_service::receive_shm_messages, this, std::placeholders::_1));
+        log_->debug("created shared memory server [%s]\n", config->shm_server_path.c_str());
+    }
+
+    if (config->metrics) {
+        setup_metrics(config);
+    }
 
-    // create process receive data thread
-    process_msg_thr_ = std::make_unique<std::thread>(&dlt_service::process_received_message, this);
-    process_msg_thr_->detach();
-    log_->debug("created process_msg thread\n");
+    // the workers only see the configuration through the snapshot
+    config_ = snap.release();
+    setup_config_watch();
 
-    // create client connect to storage interface
-    storage_client_ = std::make_unique<auto_os::lib::udp_client>();
-    log_->debug("created client interface to storage\n");
+    // create process receive data threads
+    for (auto &worker : workers_) {
+        worker->thr = std::make_unique<std::thread>(&dlt_service::process_received_message, this, worker.get());
+        worker->thr->detach();
+    }
+    log_->debug("created process_msg threads\n");
 }
 
 void dlt_service::receive_dlt_message(int fd)
@@ -99,170 +352,1281 @@ void dlt_service::receive_dlt_message(int fd)
     std::string sender_path;
     int ret;
 
+    // receive straight into a pooled buffer
+    dlt_msg.rx_msg = rx_buf_pool_->alloc(dlt_msg.buf_idx);
+    if (!dlt_msg.rx_msg) {
+        // pool exhausted, zero length read discards the datagram
+        recv(fd, nullptr, 0, 0);
+        rx_pool_exhausted(1);
+        return;
+    }
+    rx_pool_empty_ = false;
+
+    // leave room to encode the dlt header in front of the payload
+    dlt_msg.rx_msg += DLT_RX_HEADROOM;
+
     // receive a message from the client
-    ret = server_->recv_msg(sender_path, dlt_msg.rx_msg, sizeof(dlt_msg.rx_msg));
+    ret = server_->recv_msg(sender_path, dlt_msg.rx_msg, DLT_RX_MSG_MAX_LEN);
     if (ret < 0) {
+        rx_buf_pool_->free(dlt_msg.buf_idx);
         return;
     }
 
     dlt_msg.rx_msg_len = ret;
 
-    {
-        // queue received messages
-        std::unique_lock<std::mutex> lock(rx_msg_q_lock_);
-        rx_msg_list_.emplace(dlt_msg);
+    // the records are copied out into buffers of their own
+    if (dlt_msg_envelope::is_envelope(dlt_msg.rx_msg, ret)) {
+        int queued = receive_envelope(dlt_msg.rx_msg, ret, &sender_path, false);
+
+        rx_buf_pool_->free(dlt_msg.buf_idx);
+        if (queued > 0) {
+            notify_rx();
+        }
+        return;
+    }
+
+    if (!accept_msg((dlt_msg_if *)dlt_msg.rx_msg, ret)) {
+        rx_buf_pool_->free(dlt_msg.buf_idx);
+        return;
+    }
+
+    // queue received message and wake up its worker
+    sequence_msg(dlt_msg);
+    notify_rx();
+}
+
+void dlt_service::receive_dlt_message_batch(int fd)
+{
+    dlt_config *config = get_config()->config.get();
+    struct mmsghdr msgs[DLT_RX_BATCH_SIZE_MAX];
+    struct iovec iovs[DLT_RX_BATCH_SIZE_MAX];
+    // senders, only needed to answer a hello
+    struct sockaddr_un addrs[DLT_RX_BATCH_SIZE_MAX];
+    uint32_t idx;
+    int n_bufs;
+    int ret;
+    int i;
+
+    // top up the buffers left over from the previous batch
+    while (rx_spare_bufs_.size() < (size_t)config->rx_batch_size) {
+        if (!rx_buf_pool_->alloc(idx)) {
+            break;
+        }
+        rx_spare_bufs_.push_back(idx);
+    }
+
+    n_bufs = rx_spare_bufs_.size();
+    if (n_bufs == 0) {
+        // pool exhausted, zero length read discards the datagram
+        recv(fd, nullptr, 0, 0);
+        rx_pool_exhausted(1);
+        return;
+    }
+    rx_pool_empty_ = false;
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * n_bufs);
+    for (i = 0; i < n_bufs; i ++) {
+        iovs[i].iov_base = rx_buf_pool_->get(rx_spare_bufs_[i]) + DLT_RX_HEADROOM;
+        iovs[i].iov_len = DLT_RX_MSG_MAX_LEN;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
+
+    // drain whatever is queued on the socket without blocking
+    ret = recvmmsg(fd, msgs, n_bufs, MSG_DONTWAIT, nullptr);
+    if (ret <= 0) {
+        return;
+    }
+
+    for (i = 0; i < ret; i ++) {
+        dlt_rx_msg dlt_msg;
+
+        dlt_msg.buf_idx = rx_spare_bufs_[i];
+        dlt_msg.rx_msg = (uint8_t *)iovs[i].iov_base;
+        dlt_msg.rx_msg_len = msgs[i].msg_len;
+        if (dlt_msg_envelope::is_envelope(dlt_msg.rx_msg, dlt_msg.rx_msg_len)) {
+            int path_len = msgs[i].msg_hdr.msg_namelen - offsetof(struct sockaddr_un, sun_path);
+            std::string sender;
+
+            // the sender is only answered to a hello
+            if (((dlt_msg_envelope *)dlt_msg.rx_msg)->flags & DLT_WIRE_HELLO) {
+                sender.assign(addrs[i].sun_path, strnlen(addrs[i].sun_path, std::max(path_len, 0)));
+            }
+
+            receive_envelope(dlt_msg.rx_msg, dlt_msg.rx_msg_len, &sender, false);
+            rx_buf_pool_->free(dlt_msg.buf_idx);
+            continue;
+        }
+        if (!accept_msg((dlt_msg_if *)dlt_msg.rx_msg, dlt_msg.rx_msg_len)) {
+            rx_buf_pool_->free(dlt_msg.buf_idx);
+            continue;
+        }
+        sequence_msg(dlt_msg);
+    }
+
+    // keep the unused buffers for the next batch
+    rx_spare_bufs_.erase(rx_spare_bufs_.begin(), rx_spare_bufs_.begin() + ret);
+
+    // one wakeup for the whole batch
+    notify_rx();
+}
+
+void dlt_service::accept_shm_client(int)
+{
+    if (shm_server_->accept_client() < 0) {
+        log_->error("failed to accept shared memory client\n");
+    }
+}
+
+void dlt_service::receive_shm_handover(int)
+{
+    int dropped = shm_server_->receive_pending();
+
+    if (dropped > 0) {
+        log_->error("dropped %d shared memory clients that did not send their ring\n", dropped);
+    }
+}
+
+void dlt_service::receive_shm_messages(int)
+{
+    dlt_config *config = get_config()->config.get();
+    int queued = 0;
+
+    shm_server_->drain([&](const uint8_t *msg, uint32_t len) {
+        dlt_rx_msg dlt_msg;
+
+        if (dlt_msg_envelope::is_envelope(msg, len)) {
+            int ret = receive_envelope(msg, len, nullptr, true);
+
+            if (ret < 0) {
+                shm_stalled_ = true;
+                return false;
+            }
+            queued += ret;
+            if (queued >= config->rx_batch_size) {
+                notify_rx();
+                queued = 0;
+            }
+            return true;
+        }
+
+        // filtered messages are consumed straight from the ring
+        if (!accept_msg((const dlt_msg_if *)msg, len)) {
+            return true;
+        }
+
+        // leave the rest in the rings, the process thread wakes us
+        // once it returned buffers
+        dlt_msg.rx_msg = rx_buf_pool_->alloc(dlt_msg.buf_idx);
+        if (!dlt_msg.rx_msg) {
+            shm_stalled_ = true;
+            return false;
+        }
+
+        dlt_msg.rx_msg += DLT_RX_HEADROOM;
+        memcpy(dlt_msg.rx_msg, msg, len);
+        dlt_msg.rx_msg_len = len;
+        sequence_msg(dlt_msg);
+
+        if (++ queued == config->rx_batch_size) {
+            notify_rx();
+            queued = 0;
+        }
+
+        return true;
+    }, config->rx_batch_size);
+
+    if (queued > 0) {
+        notify_rx();
+    }
+}
+
+void dlt_service::rx_pool_exhausted(uint64_t n)
+{
+    rx_buf_pool_->set_exhausted(n);
+    if (!rx_pool_empty_) {
+        log_->error("rx buffer pool exhausted, %lu messages dropped so far\n",
+                    rx_buf_pool_->get_exhausted());
+        rx_pool_empty_ = true;
+    }
+}
+
+int dlt_service::receive_envelope(const uint8_t *data, int len, const std::string *sender, bool retry)
+{
+    const dlt_msg_envelope *env = (const dlt_msg_envelope *)data;
+    uint32_t bufs[DLT_RX_ENVELOPE_MAX_RECORDS];
+    int offs[DLT_RX_ENVELOPE_MAX_RECORDS];
+    dlt_drop_reason reasons[DLT_RX_ENVELOPE_MAX_RECORDS];
+    // indices of the records that pass, in order
+    int passed[DLT_RX_ENVELOPE_MAX_RECORDS];
+    int n_records = 0;
+    int n_passed = 0;
+    int n_queued;
+    int off;
+    int i;
+    int j;
+
+    if ((len < (int)sizeof(dlt_msg_envelope)) || (len > DLT_RX_MSG_MAX_LEN)) {
+        rx_metrics_.drop(dlt_drop_reason::MALFORMED);
+        return 0;
+    }
+
+    if (env->flags & DLT_WIRE_HELLO) {
+        dlt_msg_envelope ack;
+
+        if (!sender || sender->empty()) {
+            return 0;
+        }
+
+        memset(&ack, 0, sizeof(ack));
+        ack.magic = DLT_WIRE_MAGIC;
+        ack.version = std::min((int)env->version, DLT_WIRE_VERSION);
+        ack.flags = DLT_WIRE_HELLO_ACK;
+        memcpy(ack.session_id, env->session_id, sizeof(ack.session_id));
+        server_->send_msg(*sender, (uint8_t *)&ack, sizeof(ack));
+
+        return 0;
+    }
+
+    // clients send envelopes only in the version we acknowledged
+    if (env->version != DLT_WIRE_VERSION) {
+        rx_metrics_.drop(dlt_drop_reason::MALFORMED);
+        return 0;
+    }
+
+    // walk the records before anything is queued, checking each one on
+    // its header so that filtered records are never copied
+    for (off = sizeof(dlt_msg_envelope); off < len; n_records ++) {
+        const dlt_msg_record *rec = (const dlt_msg_record *)(data + off);
+        dlt_msg_if hdr;
+
+        if ((len - off < (int)sizeof(dlt_msg_record)) ||
+            (len - off - (int)sizeof(dlt_msg_record) < rec->len)) {
+            break;
+        }
+
+        memcpy(hdr.app_id, rec->app_id, sizeof(hdr.app_id));
+        memcpy(hdr.ctx_id, rec->ctx_id, sizeof(hdr.ctx_id));
+        hdr.dlt_log_lvl = rec->dlt_log_lvl;
+        hdr.dlt_msg_type_info = rec->dlt_msg_type_info | DLT_MSG_IF_TIMESTAMP;
+        offs[n_records] = off;
+        if (check_msg(&hdr, sizeof(dlt_msg_if) + rec->len + DLT_MSG_IF_TIMESTAMP_LEN, reasons[n_records])) {
+            passed[n_passed ++] = n_records;
+        }
+
+        off += sizeof(dlt_msg_record) + rec->len;
+    }
+    if ((off != len) || (n_records != env->n_records)) {
+        rx_metrics_.drop(dlt_drop_reason::MALFORMED);
+        return 0;
+    }
+
+    for (n_queued = 0; n_queued < n_passed; n_queued ++) {
+        if (!rx_buf_pool_->alloc(bufs[n_queued])) {
+            break;
+        }
+    }
+    if (n_queued < n_passed) {
+        // the shared memory ring keeps the envelope until the workers
+        // returned enough buffers, unless the pool never has that many
+        if (retry && ((size_t)n_passed <= rx_buf_pool_->get_n_bufs() - rx_spare_bufs_.size())) {
+            while (n_queued > 0) {
+                rx_buf_pool_->free(bufs[-- n_queued]);
+            }
+            return -1;
+        }
+        // the event loop does not wait for the workers, the records that
+        // do not fit are dropped
+        rx_pool_exhausted(n_passed - n_queued);
+    }
+
+    // counted once the envelope is taken, a retried one is counted once
+    for (i = 0, j = 0; i < n_records; i ++) {
+        const dlt_msg_record *rec = (const dlt_msg_record *)(data + offs[i]);
+
+        rx_metrics_.rx_msgs.add();
+        rx_metrics_.rx_bytes.add(sizeof(dlt_msg_if) + rec->len + DLT_MSG_IF_TIMESTAMP_LEN);
+        if ((j < n_passed) && (passed[j] == i)) {
+            if (j < n_queued) {
+                app_counts_.add(rec->app_id);
+            }
+            j ++;
+        } else {
+            rx_metrics_.drop(reasons[i]);
+        }
+    }
+
+    // each record that passed becomes a dlt_msg_if with its timestamp at
+    // the end, as a client of wire version 0 sends it
+    for (i = 0; i < n_queued; i ++) {
+        const dlt_msg_record *rec = (const dlt_msg_record *)(data + offs[passed[i]]);
+        dlt_rx_msg dlt_msg;
+        dlt_msg_if *msg;
+
+        dlt_msg.buf_idx = bufs[i];
+        dlt_msg.rx_msg = rx_buf_pool_->get(bufs[i]) + DLT_RX_HEADROOM;
+        dlt_msg.rx_msg_len = sizeof(dlt_msg_if) + rec->len + DLT_MSG_IF_TIMESTAMP_LEN;
+
+        msg = (dlt_msg_if *)dlt_msg.rx_msg;
+        memcpy(msg->app_id, rec->app_id, sizeof(msg->app_id));
+        memcpy(msg->ctx_id, rec->ctx_id, sizeof(msg->ctx_id));
+        memcpy(msg->session_id, env->session_id, sizeof(msg->session_id));
+        msg->dlt_log_lvl = rec->dlt_log_lvl;
+        msg->dlt_msg_type_info = rec->dlt_msg_type_info | DLT_MSG_IF_TIMESTAMP;
+        memcpy(msg->dlt_msg, rec->dlt_msg, rec->len);
+        memcpy(msg->dlt_msg + rec->len, &rec->timestamp, DLT_MSG_IF_TIMESTAMP_LEN);
+
+        sequence_msg(dlt_msg);
+    }
+
+    return n_queued;
+}
+
+int dlt_service::load_filters(const dlt_config *config)
+{
+    dlt_filter_table filter;
+
+    if (filter.load(config->filter_default_level, config->filter_rules) < 0) {
+        log_->error("invalid filter rules in [%s]\n", config_file_.c_str());
+        return -1;
+    }
+
+    filter_ = std::move(filter);
+
+    // clients skip suppressed messages before formatting them
+    if (filter_page_) {
+        filter_page_->publish(filter_.get_default(), [this](auto add) {
+            filter_.for_each(add);
+        });
+        if (filter_page_->state == DLT_FILTER_PAGE_OVERFLOW) {
+            log_->error("too many filter rules to publish, clients send everything\n");
+        }
+    }
+    log_->debug("loaded %zu filter rules, default level %s\n", filter_.size(),
+                                                              config->filter_default_level.c_str());
+
+    return 0;
+}
+
+void dlt_service::setup_filter_page()
+{
+    void *mem;
+    int fd;
+
+    // a page left by a previous run is marked closed, so clients still
+    // holding it look for the new one
+    fd = shm_open(DLT_FILTER_PAGE_NAME, O_RDWR | O_CLOEXEC, 0);
+    if (fd >= 0) {
+        struct stat st;
+
+        if ((fstat(fd, &st) == 0) && (st.st_size == sizeof(dlt_filter_page))) {
+            mem = mmap(nullptr, sizeof(dlt_filter_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mem != MAP_FAILED) {
+                ((dlt_filter_page *)mem)->state = DLT_FILTER_PAGE_CLOSED;
+                munmap(mem, sizeof(dlt_filter_page));
+            }
+        }
+        close(fd);
+        shm_unlink(DLT_FILTER_PAGE_NAME);
+    }
+
+    fd = shm_open(DLT_FILTER_PAGE_NAME, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        log_->error("failed to create filter page [%s]\n", DLT_FILTER_PAGE_NAME);
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(dlt_filter_page)) < 0) {
+        close(fd);
+        return;
+    }
+
+    mem = mmap(nullptr, sizeof(dlt_filter_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        log_->error("failed to map filter page\n");
+        return;
+    }
+
+    filter_page_ = (dlt_filter_page *)mem;
+}
+
+std::unique_ptr<dlt_config_snapshot> dlt_service::make_config(std::unique_ptr<dlt_config> config,
+                                                              const dlt_config_snapshot *prev)
+{
+    auto snap = std::make_unique<dlt_config_snapshot>();
+    const dlt_config *c = config.get();
+
+    snap->config = std::move(config);
+    fill_ecu_id(snap.get());
+
+    // the header only depends on these, most reloads keep it
+    if (prev &&
+        (c->use_ext_hdr == prev->config->use_ext_hdr) &&
+        (c->send_ecu_id == prev->config->send_ecu_id) &&
+        (memcmp(snap->ecu_id, prev->ecu_id, sizeof(snap->ecu_id)) == 0) &&
+        (c->send_timestamp == prev->config->send_timestamp) &&
+        (c->version == prev->config->version) &&
+        (c->verbose_mode == prev->config->verbose_mode)) {
+        snap->hdr_tmpl = prev->hdr_tmpl;
+        memcpy(snap->msg_info, prev->msg_info, sizeof(snap->msg_info));
+        memcpy(snap->msg_info_nv, prev->msg_info_nv, sizeof(snap->msg_info_nv));
+    } else if (setup_header_template(snap.get()) < 0) {
+        return nullptr;
+    }
+
+    // the workers reconfigure their forwarder when the storage server changes
+    snap->storage_generation = 0;
+    if (prev) {
+        const dlt_config *p = prev->config.get();
+
+        snap->storage_generation = prev->storage_generation;
+        if ((c->storage_service_addr != p->storage_service_addr) ||
+            (c->storage_service_port != p->storage_service_port) ||
+            (c->storage_batch_size != p->storage_batch_size) ||
+            (c->storage_pack_msgs != p->storage_pack_msgs) ||
+            (c->storage_mtu != p->storage_mtu) ||
+            (c->storage_compress != p->storage_compress) ||
+            (c->storage_compress_size != p->storage_compress_size)) {
+            snap->storage_generation ++;
+        }
+    }
+
+    return snap;
+}
+
+void dlt_service::setup_sinks(dlt_config_snapshot *snap)
+{
+    const dlt_config *config = snap->config.get();
+
+    // the console is created the first time it is enabled and then kept,
+    // a worker may still write to it through an older snapshot
+    if (config->log_to_console && !console_) {
+        console_ = std::make_unique<dlt_console_sink>(config->console_queue_size, snap->ecu_id, &catalog_);
+    }
+
+    sinks_.clear();
+    for (dlt_sink *sink : std::initializer_list<dlt_sink *>{enc_msg_list_.get(),
+                                                           file_storage_.get(),
+                                                           viewer_server_.get(),
+                                                           console_.get()}) {
+        if (!sink) {
+            continue;
+        }
+        sinks_.push_back(sink);
+        if ((sink == console_.get()) && !config->log_to_console) {
+            continue;
+        }
+        snap->sinks.push_back(sink);
+        log_->debug("writing messages to sink [%s]\n", sink->get_name());
+    }
+
+    // messages of the old snapshot may still be printed with the new id
+    if (console_) {
+        console_->set_ecu_id(snap->ecu_id);
+    }
+    if (file_storage_) {
+        file_storage_->set_ecu_id(snap->ecu_id);
+    }
+}
+
+void dlt_service::reload_config()
+{
+    std::unique_ptr<dlt_config> parsed = std::make_unique<dlt_config>();
+    std::unique_ptr<dlt_config_snapshot> snap;
+    dlt_config_snapshot *prev = get_config();
+    const dlt_config *old = prev->config.get();
+    struct in_addr addr;
+
+    // parsed here on the event_manager thread, the workers carry on with
+    // the snapshot they have
+    if (parsed->parse(config_file_) < 0) {
+        log_->error("failed to parse [%s], keeping the configuration in use\n", config_file_.c_str());
+        return;
+    }
+
+    if (inet_pton(AF_INET, parsed->storage_service_addr.c_str(), &addr) != 1) {
+        log_->error("invalid storage server address [%s], keeping the configuration in use\n",
+                    parsed->storage_service_addr.c_str());
+        return;
+    }
+
+    // the rest is set up once at startup, the new snapshot keeps the
+    // values in use so it describes what the service does
+    auto keep = [this](const char *name, auto &value, const auto &in_use) {
+        if (!(value == in_use)) {
+            log_->info("[%s] changed, takes effect on restart\n", name);
+            value = in_use;
+        }
+    };
+    dlt_file_storage_config &fs = parsed->file_storage_config;
+
+    keep("network.socket_type", parsed->conn_type, old->conn_type);
+    keep("network.unix_socket.server_path", parsed->unix_server_path, old->unix_server_path);
+    keep("network.unix_socket.shm_server_path", parsed->shm_server_path, old->shm_server_path);
+    keep("network.unix_socket.shm_max_ring_size_kb", parsed->shm_max_ring_size, old->shm_max_ring_size);
+    keep("network.viewer_server.enabled", parsed->viewer_server, old->viewer_server);
+    keep("network.viewer_server.address", parsed->viewer_address, old->viewer_address);
+    keep("network.viewer_server.port", parsed->viewer_port, old->viewer_port);
+    keep("network.viewer_server.queue_size_kb", parsed->viewer_queue_size, old->viewer_queue_size);
+    keep("network.viewer_server.max_clients", parsed->viewer_max_clients, old->viewer_max_clients);
+    keep("console_queue_size_kb", parsed->console_queue_size, old->console_queue_size);
+    keep("rx_buffer_pool_size", parsed->rx_buffer_pool_size, old->rx_buffer_pool_size);
+    keep("rx_batch_size", parsed->rx_batch_size, old->rx_batch_size);
+    keep("process_workers", parsed->process_workers, old->process_workers);
+    keep("replay_buffer_size", parsed->replay_buffer_size, old->replay_buffer_size);
+    keep("nonverbose_catalog", parsed->nonverbose_catalog, old->nonverbose_catalog);
+    keep("filters.publish", parsed->publish_filters, old->publish_filters);
+    keep("storage.enabled", parsed->file_storage, old->file_storage);
+    keep("storage.directory", fs.directory, old->file_storage_config.directory);
+    keep("storage.prefix", fs.prefix, old->file_storage_config.prefix);
+    keep("storage.segment_size_mb", fs.segment_size, old->file_storage_config.segment_size);
+    keep("storage.segment_duration_s", fs.segment_duration_s, old->file_storage_config.segment_duration_s);
+    keep("storage.max_segments", fs.max_segments, old->file_storage_config.max_segments);
+    keep("storage.block_size_kb", fs.block_size, old->file_storage_config.block_size);
+    keep("storage.flush_interval_ms", fs.flush_interval_ms, old->file_storage_config.flush_interval_ms);
+    keep("storage.fsync", fs.fsync, old->file_storage_config.fsync);
+    keep("storage.fsync_interval_ms", fs.fsync_interval_ms, old->file_storage_config.fsync_interval_ms);
+    keep("storage.direct_io", fs.direct_io, old->file_storage_config.direct_io);
+    keep("storage.index", fs.index, old->file_storage_config.index);
+    keep("storage.compress", fs.compress, old->file_storage_config.compress);
+    keep("metrics.enabled", parsed->metrics, old->metrics);
+    keep("metrics.socket_path", parsed->metrics_socket_path, old->metrics_socket_path);
+    keep("metrics.interval_ms", parsed->metrics_interval_ms, old->metrics_interval_ms);
+
+    snap = make_config(std::move(parsed), prev);
+    if (!snap) {
+        log_->error("failed to build dlt header template, keeping the configuration in use\n");
+        return;
+    }
+
+    // the current table stays in use if the new one does not load
+    if ((snap->config->filter_default_level != old->filter_default_level) ||
+        (snap->config->filter_rules != old->filter_rules)) {
+        if (load_filters(snap->config.get()) < 0) {
+            return;
+        }
+    }
+
+    setup_sinks(snap.get());
+    client_timestamps_ = snap->config->client_timestamps;
+
+    // workers pick the new snapshot up with their next batch
+    retired_configs_.push_back(config_.exchange(snap.release(), std::memory_order_acq_rel));
+    free_retired_configs();
+
+    log_->info("reloaded [%s]\n", config_file_.c_str());
+}
+
+void dlt_service::free_retired_configs()
+{
+    auto in_use = [this](dlt_config_snapshot *snap) {
+        for (auto &worker : workers_) {
+            if (worker->config_in_use.load(std::memory_order_seq_cst) == snap) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // a worker holding an old snapshot lets it go after its batch, what
+    // is left here is freed on the next reload
+    retired_configs_.erase(std::remove_if(retired_configs_.begin(), retired_configs_.end(),
+                                          [&](dlt_config_snapshot *snap) {
+                                              if (in_use(snap)) {
+                                                  return false;
+                                              }
+                                              delete snap;
+                                              return true;
+                                          }),
+                           retired_configs_.end());
+}
+
+void dlt_service::setup_config_watch()
+{
+    size_t slash = config_file_.rfind('/');
+    std::string dir = ".";
+
+    if (slash != std::string::npos) {
+        dir = config_file_.substr(0, std::max(slash, (size_t)1));
+        config_name_ = config_file_.substr(slash + 1);
+    } else {
+        config_name_ = config_file_;
+    }
+
+    config_watch_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (config_watch_fd_ < 0) {
+        log_->error("failed to watch [%s], reload with SIGHUP\n", config_file_.c_str());
+        return;
+    }
+
+    // editors and deployment tools usually write a new file and rename
+    // it over the old one, so the directory is watched and not the file
+    if (inotify_add_watch(config_watch_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        log_->error("failed to watch [%s], reload with SIGHUP\n", dir.c_str());
+        close(config_watch_fd_);
+        config_watch_fd_ = -1;
+        return;
+    }
+    evt_mgr_->create_socket_event(config_watch_fd_,
+                                  std::bind(&dlt_service::receive_config_change, this, std::placeholders::_1));
+}
+
+void dlt_service::receive_config_change(int fd)
+{
+    alignas(struct inotify_event) char buf[4096];
+    bool changed = false;
+    ssize_t len;
+
+    // a burst of writes and renames is one reload
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *evt = (struct inotify_event *)p;
+
+            if ((evt->len > 0) && (config_name_ == evt->name)) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + evt->len;
+        }
+    }
+
+    if (changed) {
+        reload_config();
+    }
+}
+
+void dlt_service::receive_signal(int fd)
+{
+    struct signalfd_siginfo info;
+
+    if (read(fd, &info, sizeof(info)) != sizeof(info)) {
+        return;
     }
+
+    log_->info("reloading [%s], %lu messages filtered so far\n",
+               config_file_.c_str(),
+               rx_metrics_.drops[static_cast<int>(dlt_drop_reason::FILTERED)].get());
+
+    reload_config();
 }
 
-void dlt_service::process_received_message()
+static void append(std::string &out, const char *fmt, ...)
 {
-    dlt_config *config = dlt_config::instance();
+    char line[256];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    out.append(line, std::min(len, (int)sizeof(line) - 1));
+}
+
+// application ids are up to 4 characters, shorter ones are 0 padded
+static std::string app_name(uint32_t id)
+{
+    const char *name = (const char *)&id;
+
+    return std::string(name, strnlen(name, sizeof(id)));
+}
+
+void dlt_service::setup_metrics(const dlt_config *config)
+{
+    struct sockaddr_un addr;
+
+    metrics_ = true;
+    stats_at_ns_ = dlt_metrics_now_ns();
+
+    // metrics are kept even if the endpoint can not be created
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (config->metrics_socket_path.length() >= sizeof(addr.sun_path)) {
+        log_->error("stats socket path [%s] is too long\n", config->metrics_socket_path.c_str());
+    } else {
+        strcpy(addr.sun_path, config->metrics_socket_path.c_str());
+        unlink(addr.sun_path);
+
+        stats_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if ((stats_fd_ < 0) ||
+            (bind(stats_fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+            (listen(stats_fd_, 4) < 0)) {
+            log_->error("failed to create stats socket [%s]\n", addr.sun_path);
+            if (stats_fd_ >= 0) {
+                close(stats_fd_);
+                stats_fd_ = -1;
+            }
+        } else {
+            evt_mgr_->create_socket_event(stats_fd_,
+                                          std::bind(&dlt_service::accept_stats_client, this, std::placeholders::_1));
+            log_->debug("stats socket [%s]\n", addr.sun_path);
+        }
+    }
+
+    if (config->metrics_interval_ms <= 0) {
+        return;
+    }
+
+    // the event manager has no timers, a timerfd wakes it up like a socket
+    struct itimerspec its;
+
+    its.it_interval.tv_sec = config->metrics_interval_ms / 1000;
+    its.it_interval.tv_nsec = (config->metrics_interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+
+    stats_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ((stats_timer_fd_ < 0) || (timerfd_settime(stats_timer_fd_, 0, &its, nullptr) < 0)) {
+        log_->error("failed to create statistics timer\n");
+        return;
+    }
+    evt_mgr_->create_socket_event(stats_timer_fd_, std::bind(&dlt_service::log_stats, this, std::placeholders::_1));
+}
+
+std::string dlt_service::render_stats()
+{
+    dlt_metrics_snapshot snap;
+    std::string out;
+    struct {
+        const char *name;
+        dlt_histogram_snapshot *hist;
+    } hists[] = {
+        {"encode_ns", &snap.encode_ns},
+        {"sink_ns", &snap.sink_ns},
+        {"forward_ns", &snap.forward_ns},
+    };
+    int i;
+
+    snap.add(rx_metrics_);
+    for (auto &worker : workers_) {
+        snap.add(worker->metrics);
+    }
+
+    append(out, "uptime_ms %lu\n", std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::chrono::steady_clock::now() - start_time_).count());
+    append(out, "rx_msgs %lu\n", snap.rx_msgs);
+    append(out, "rx_bytes %lu\n", snap.rx_bytes);
+    append(out, "encoded %lu\n", snap.encoded);
+    append(out, "drop.rx_pool %lu\n", rx_buf_pool_->get_exhausted());
+    for (i = 0; i < DLT_DROP_REASONS; i ++) {
+        append(out, "drop.%s %lu\n", drop_reason_names[i], snap.drops[i]);
+    }
+    if (shm_server_) {
+        append(out, "drop.shm_ring %lu\n", shm_server_->get_dropped());
+    }
+
+    for (i = 0; i < (int)workers_.size(); i ++) {
+        append(out, "worker.%d.encoded %lu\n", i, workers_[i]->metrics.encoded.get());
+        append(out, "worker.%d.queue_hwm %lu\n", i, workers_[i]->rx_queue_hwm.get());
+        append(out, "worker.%d.send_errors %lu\n", i, workers_[i]->storage_client->get_send_errors());
+    }
+
+    for (auto &h : hists) {
+        uint64_t count = h.hist->count();
+
+        append(out, "%s.samples %lu\n", h.name, count);
+        append(out, "%s.avg %lu\n", h.name, count ? h.hist->sum / count : 0);
+        append(out, "%s.p50 %lu\n", h.name, h.hist->percentile(0.5));
+        append(out, "%s.p99 %lu\n", h.name, h.hist->percentile(0.99));
+        append(out, "%s.p999 %lu\n", h.name, h.hist->percentile(0.999));
+    }
+
+    for (auto sink : sinks_) {
+        append(out, "sink.%s.dropped %lu\n", sink->get_name(), sink->get_dropped());
+    }
+
+    app_counts_.for_each([&](const uint8_t *app_id, uint64_t count) {
+        uint32_t id = 0;
+        std::string name = "other";
+
+        if (app_id) {
+            memcpy(&id, app_id, sizeof(id));
+            name = app_name(id);
+        }
+        append(out, "app.%s.msgs %lu\n", name.c_str(), count);
+        if (app_id && app_rates_.count(id)) {
+            append(out, "app.%s.rate %.1f\n", name.c_str(), app_rates_[id]);
+        }
+    });
+
+    return out;
+}
+
+void dlt_service::accept_stats_client(int fd)
+{
+    std::string stats;
+    int client;
+
+    client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+        return;
+    }
+
+    // one snapshot per connection, a few KB always fit the socket buffer
+    stats = render_stats();
+    send(client, stats.data(), stats.length(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(client);
+}
+
+void dlt_service::log_stats(int fd)
+{
+    dlt_metrics_snapshot snap;
+    std::vector<std::pair<double, uint32_t>> top;
+    uint64_t expirations;
+    uint64_t pool_empty = rx_buf_pool_->get_exhausted();
+    uint64_t queue_hwm = 0;
+    uint64_t send_errors = 0;
+    uint64_t now = dlt_metrics_now_ns();
+    double secs = (now - stats_at_ns_) / 1e9;
+    std::string text;
+    int i;
+
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return;
+    }
+
+    snap.add(rx_metrics_);
+    for (auto &worker : workers_) {
+        snap.add(worker->metrics);
+        queue_hwm = std::max(queue_hwm, worker->rx_queue_hwm.get());
+        send_errors += worker->storage_client->get_send_errors();
+    }
+
+    app_rates_.clear();
+    app_counts_.for_each([&](const uint8_t *app_id, uint64_t count) {
+        uint32_t id;
+
+        if (!app_id) {
+            return;
+        }
+        memcpy(&id, app_id, sizeof(id));
+        app_rates_[id] = (count - app_counts_prev_[id]) / secs;
+        app_counts_prev_[id] = count;
+        if (app_rates_[id] > 0) {
+            top.push_back({app_rates_[id], id});
+        }
+    });
+
+    append(text, "rx %.0f msgs/s %.1f KB/s, encoded %.0f msgs/s, dropped pool %lu",
+                 (snap.rx_msgs - stats_prev_.rx_msgs) / secs,
+                 (snap.rx_bytes - stats_prev_.rx_bytes) / secs / 1024,
+                 (snap.encoded - stats_prev_.encoded) / secs,
+                 pool_empty - stats_pool_empty_);
+    for (i = 0; i < DLT_DROP_REASONS; i ++) {
+        append(text, " %s %lu", drop_reason_names[i], snap.drops[i] - stats_prev_.drops[i]);
+    }
+    append(text, ", queue hwm %lu, send errors %lu", queue_hwm, send_errors);
+    append(text, ", p99 encode %lu ns sinks %lu ns forward %lu ns",
+                 snap.encode_ns.since(stats_prev_.encode_ns).percentile(0.99),
+                 snap.sink_ns.since(stats_prev_.sink_ns).percentile(0.99),
+                 snap.forward_ns.since(stats_prev_.forward_ns).percentile(0.99));
+    log_self(text);
+
+    // busiest applications first, as many as fit one message
+    if (!top.empty()) {
+        std::sort(top.begin(), top.end(), std::greater<>());
+        text = "apps";
+        for (auto &app : top) {
+            if (text.length() > DLT_MSG_MAX_LEN - 64) {
+                break;
+            }
+            append(text, " %s %.0f/s", app_name(app.second).c_str(), app.first);
+        }
+        log_self(text);
+    }
+
+    stats_prev_ = snap;
+    stats_pool_empty_ = pool_empty;
+    stats_at_ns_ = now;
+}
+
+void dlt_service::log_self(const std::string &text)
+{
+    const uint8_t *app_id = (const uint8_t *)DLT_METRICS_APP_ID;
+    const uint8_t *ctx_id = (const uint8_t *)DLT_METRICS_CTX_ID;
+    dlt_rx_msg dlt_msg;
+    dlt_msg_if *msg;
+    int len = std::min(text.length(), DLT_RX_MSG_MAX_LEN - sizeof(dlt_msg_if));
+
+    if (!filter_.pass(app_id, ctx_id, DLT_MSG_LOG_LVL_INFO)) {
+        return;
+    }
+
+    dlt_msg.rx_msg = rx_buf_pool_->alloc(dlt_msg.buf_idx);
+    if (!dlt_msg.rx_msg) {
+        rx_buf_pool_->set_exhausted();
+        return;
+    }
+
+    // built like a client message, so it is encoded, stored and forwarded
+    // by the workers as any other
+    dlt_msg.rx_msg += DLT_RX_HEADROOM;
+    msg = (dlt_msg_if *)dlt_msg.rx_msg;
+    memcpy(msg->app_id, app_id, sizeof(msg->app_id));
+    memcpy(msg->ctx_id, ctx_id, sizeof(msg->ctx_id));
+    memcpy(msg->session_id, app_id, sizeof(msg->session_id));
+    msg->dlt_log_lvl = DLT_MSG_LOG_LVL_INFO;
+    msg->dlt_msg_type_info = DLT_MSG_TYPEINFO_STRG;
+    memcpy(msg->dlt_msg, text.data(), len);
+    dlt_msg.rx_msg_len = sizeof(dlt_msg_if) + len;
+
+    sequence_msg(dlt_msg);
+    notify_rx();
+}
+
+void dlt_service::sequence_msg(dlt_rx_msg &msg)
+{
+    dlt_msg_if *rx_msg = (dlt_msg_if *)msg.rx_msg;
+    dlt_worker *worker;
+    uint32_t session_id;
+    uint32_t app_id;
+    uint32_t shard;
+
+    msg.msg_counter = msg_counter_;
+    inc_msg_counter();
+
+    // dlt timestamps are in 0.1 ms since the ecu started. the timestamp
+    // the application took is at the end of the message, it is removed so
+    // the workers see the payload only
+    if (rx_msg->dlt_msg_type_info & DLT_MSG_IF_TIMESTAMP) {
+        msg.rx_msg_len -= DLT_MSG_IF_TIMESTAMP_LEN;
+        rx_msg->dlt_msg_type_info &= ~DLT_MSG_IF_TIMESTAMP;
+        if (client_timestamps_) {
+            memcpy(&msg.timestamp, msg.rx_msg + msg.rx_msg_len, sizeof(msg.timestamp));
+        } else {
+            msg.timestamp = clock_->now();
+        }
+    } else {
+        msg.timestamp = clock_->now();
+    }
+
+    memcpy(&session_id, rx_msg->session_id, sizeof(session_id));
+    memcpy(&app_id, rx_msg->app_id, sizeof(app_id));
+    shard = ((session_id * 0x9e3779b1) ^ app_id) * 0x85ebca6b;
+    worker = workers_[(shard >> 16) % workers_.size()].get();
+
+    worker->rx_msg_list->push(msg);
+    worker->rx_pending = true;
+}
+
+void dlt_service::notify_rx()
+{
+    uint64_t val = 1;
+
+    for (auto &worker : workers_) {
+        if (worker->rx_pending) {
+            // the ring only grows until the worker is woken up, so this is
+            // the deepest it got for this batch
+            worker->rx_queue_hwm.set_max(worker->rx_msg_list->size());
+            worker->rx_pending = false;
+            write(worker->rx_evt_fd, &val, sizeof(val));
+        }
+    }
+}
+
+void dlt_service::wake_stalled_rx()
+{
+    if (shm_stalled_ && shm_stalled_.exchange(false)) {
+        shm_server_->wakeup();
+    }
+}
+
+bool dlt_service::wait_rx(dlt_worker *worker, int timeout_ms)
+{
+    struct pollfd pfd;
+    uint64_t val;
+
+    pfd.fd = worker->rx_evt_fd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return false;
+    }
+
+    read(worker->rx_evt_fd, &val, sizeof(val));
+
+    return true;
+}
+
+void dlt_service::process_received_message(dlt_worker *worker)
+{
+    std::chrono::steady_clock::time_point flush_at;
+    dlt_config_snapshot *snap;
+    dlt_rx_msg *msg;
+    int timeout_ms = -1;
 
     while (1) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        {
-            std::unique_lock<std::mutex> lock(rx_msg_q_lock_);
-            int q_len = rx_msg_list_.size();
-            while (q_len > 0) {
-                dlt_rx_msg msg = rx_msg_list_.front();
-
-                dlt_encoded_msg enc_msg;
-                dlt_msg_if *rx_msg = (dlt_msg_if *)msg.rx_msg;
-
-                dlt_header hdr;
-                size_t off = 0;
-
-                hdr.set_msg_type_info(dlt_msg_typeinfo::DLT_MSG_TYPEINFO_STRG);
-                if (config->use_ext_hdr)
-                    hdr.std_hdr.set_use_ext_hdr();
-                if (config->send_ecu_id) {
-                    hdr.std_hdr.set_valid_ecu_id();
-                    hdr.std_hdr.set_ecu_id(config->ecu_id);
-                }
-                hdr.std_hdr.set_valid_session_id();
-                hdr.std_hdr.set_version(config->version);
-                hdr.std_hdr.set_msg_counter(msg_counter_);
-                hdr.std_hdr.set_session_id(rx_msg->session_id);
-
-                if (config->verbose_mode)
-                    hdr.ext_hdr.set_verbose();
-                hdr.ext_hdr.set_app_id(rx_msg->app_id);
-                hdr.ext_hdr.set_context_id(rx_msg->ctx_id);
-                switch (rx_msg->dlt_log_lvl) {
-                    case DLT_MSG_LOG_LVL_INFO:
-                        hdr.ext_hdr.set_msg_type(
-                            dlt_extended_header_msg_type::eDLT_TYPE_LOG);
-                        hdr.ext_hdr.set_msg_type_info_log(
-                            dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO);
-                    break;
-                    case DLT_MSG_LOG_LVL_WARNING:
-                        hdr.ext_hdr.set_msg_type(
-                            dlt_extended_header_msg_type::eDLT_TYPE_LOG);
-                        hdr.ext_hdr.set_msg_type_info_log(
-                            dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN);
-                    break;
-                    case DLT_MSG_LOG_LVL_VERBOSE:
-                        hdr.ext_hdr.set_msg_type(
-                            dlt_extended_header_msg_type::eDLT_TYPE_LOG);
-                        hdr.ext_hdr.set_msg_type_info_log(
-                            dlt_extended_header_msg_type_info_log::eDLT_LOG_VERBOSE);
-                    break;
-                    case DLT_MSG_LOG_LVL_ERROR:
-                        hdr.ext_hdr.set_msg_type(
-                            dlt_extended_header_msg_type::eDLT_TYPE_LOG);
-                        hdr.ext_hdr.set_msg_type_info_log(
-                            dlt_extended_header_msg_type_info_log::eDLT_LOG_ERROR);
-                    break;
-                    case DLT_MSG_LOG_LVL_FATAL:
-                        hdr.ext_hdr.set_msg_type(
-                            dlt_extended_header_msg_type::eDLT_TYPE_LOG);
-                        hdr.ext_hdr.set_msg_type_info_log(
-                            dlt_extended_header_msg_type_info_log::eDLT_LOG_FATAL);
-                    break;
-                    default:
-                        rx_msg_list_.pop();
-                        q_len = rx_msg_list_.size();
-                    continue;
-                }
-
-                // encode DLT message
-                enc_msg.enc_msg_len = hdr.encode((uint8_t *)(rx_msg->dlt_msg), msg.rx_msg_len - sizeof(dlt_msg_if),
-                                            (uint8_t *)(enc_msg.enc_msg), sizeof(enc_msg.enc_msg), off);
-
-                enc_msg_list_.push(enc_msg);
-
-                // send DLT message if storage client is available
-                storage_client_->send_msg(config->storage_service_addr,
-                                          config->storage_service_port,
-                                          enc_msg.enc_msg, enc_msg.enc_msg_len);
-
-                inc_msg_counter();
-
-                // if logging to console enabled .. dump the contents
-                if (config->log_to_console)
-                    log_console(rx_msg->dlt_log_lvl,
-                                ecu_id_,
-                                msg_counter_,
-                                rx_msg->app_id,
-                                rx_msg->ctx_id,
-                                rx_msg->dlt_msg,
-                                msg.rx_msg_len - sizeof(dlt_msg_if));
-
-                rx_msg_list_.pop();
-                q_len = rx_msg_list_.size();
+        // eventfd counts every notify, so a message queued while we were
+        // draining is never missed
+        if (!wait_rx(worker, timeout_ms)) {
+            // flush timer expired
+            worker->storage_client->flush();
+            timeout_ms = -1;
+            wake_stalled_rx();
+            continue;
+        }
+
+        // one configuration for the whole batch, a reload in between is
+        // seen by the next one
+        snap = acquire_config(worker);
+        if (worker->storage_generation != snap->storage_generation) {
+            const dlt_config *config = snap->config.get();
+
+            // sends what was queued for the previous storage server first
+            if (worker->storage_client->configure(config->storage_service_addr,
+                                                  config->storage_service_port,
+                                                  config->storage_batch_size,
+                                                  config->storage_pack_msgs,
+                                                  config->storage_mtu,
+                                                  config->storage_compress ?
+                                                    config->storage_compress_size : 0) < 0) {
+                log_->error("invalid storage server address [%s]\n", config->storage_service_addr.c_str());
             }
+            worker->storage_generation = snap->storage_generation;
+        }
+
+        while ((msg = worker->rx_msg_list->front()) != nullptr) {
+            // forwarded buffers are freed once the batch is sent
+            if (!process_msg(worker, snap, msg)) {
+                worker->metrics.drop(dlt_drop_reason::MALFORMED);
+                rx_buf_pool_->free(msg->buf_idx);
+            }
+            worker->rx_msg_list->pop();
+        }
+
+        // buffers are back, let a stalled receive continue
+        wake_stalled_rx();
+
+        // the batch size flushes inside the forwarder, anything left over
+        // goes out when the flush interval expires
+        if (!worker->storage_client->has_pending()) {
+            release_config(worker);
+            timeout_ms = -1;
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (timeout_ms < 0) {
+            flush_at = now + std::chrono::milliseconds(snap->config->storage_flush_interval_ms);
+        }
+        release_config(worker);
+
+        if (now >= flush_at) {
+            worker->storage_client->flush();
+            timeout_ms = -1;
+        } else {
+            timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    flush_at - now).count() + 1;
         }
     }
 }
 
-void dlt_service::log_console(uint8_t loglvl,
-                              uint8_t *ecuid,
-                              uint16_t msg_count,
-                              uint8_t *app_id,
-                              uint8_t *ctx_id,
-                              const char *str,
-                              int str_len)
+int dlt_service::setup_header_template(dlt_config_snapshot *snap)
 {
-    char msg[4096];
-    std::string log_level;
+    const dlt_config *config = snap->config.get();
+    dlt_header hdr;
+    int lvl;
 
-    // copy the string and null terminate
-    strncpy(msg, str, str_len);
-    msg[str_len] = '\0';
+    hdr.set_msg_type_info(dlt_msg_typeinfo::DLT_MSG_TYPEINFO_STRG);
+    if (config->use_ext_hdr)
+        hdr.std_hdr.set_use_ext_hdr();
+    if (config->send_ecu_id) {
+        hdr.std_hdr.set_valid_ecu_id();
+        hdr.std_hdr.set_ecu_id(config->ecu_id);
+    }
+    hdr.std_hdr.set_valid_session_id();
+    if (config->send_timestamp) {
+        hdr.std_hdr.set_valid_timestamp();
+    }
+    hdr.std_hdr.set_version(config->version);
 
-    switch (loglvl) {
-        case DLT_MSG_LOG_LVL_INFO:
-            log_level = "info";
-        break;
-        case DLT_MSG_LOG_LVL_WARNING:
-            log_level = "warning";
-        break;
-        case DLT_MSG_LOG_LVL_VERBOSE:
-            log_level = "verbose";
-        break;
-        case DLT_MSG_LOG_LVL_ERROR:
-            log_level = "error";
+    if (snap->hdr_tmpl.init(hdr) < 0) {
+        return -1;
+    }
+
+    // message info only varies with the log level
+    for (lvl = 0; lvl <= DLT_MSG_LOG_LVL_FATAL; lvl ++) {
+        dlt_extended_header ext_hdr;
+        ext_hdr.set_msg_type(dlt_extended_header_msg_type::eDLT_TYPE_LOG);
+        switch (lvl) {
+            case DLT_MSG_LOG_LVL_INFO:
+                ext_hdr.set_msg_type_info_log(
+                    dlt_extended_header_msg_type_info_log::eDLT_LOG_INFO);
+            break;
+            case DLT_MSG_LOG_LVL_WARNING:
+                ext_hdr.set_msg_type_info_log(
+                    dlt_extended_header_msg_type_info_log::eDLT_LOG_WARN);
+            break;
+            case DLT_MSG_LOG_LVL_VERBOSE:
+                ext_hdr.set_msg_type_info_log(
+                    dlt_extended_header_msg_type_info_log::eDLT_LOG_VERBOSE);
+            break;
+            case DLT_MSG_LOG_LVL_ERROR:
+                ext_hdr.set_msg_type_info_log(
+                    dlt_extended_header_msg_type_info_log::eDLT_LOG_ERROR);
+            break;
+            case DLT_MSG_LOG_LVL_FATAL:
+                ext_hdr.set_msg_type_info_log(
+                    dlt_extended_header_msg_type_info_log::eDLT_LOG_FATAL);
+            break;
+        }
+        snap->msg_info_nv[lvl] = ext_hdr.message_info;
+        if (config->verbose_mode)
+            ext_hdr.set_verbose();
+        snap->msg_info[lvl] = ext_hdr.message_info;
+    }
+
+    return 0;
+}
+
+int dlt_service::count_args(uint8_t *args, int args_len)
+{
+    dlt_msg_view view;
+    dlt_arg_view arg;
+    int n_args = 0;
+    int ret;
+
+    // clients encode arguments in host byte order, little endian
+    memset(&view, 0, sizeof(view));
+    view.payload = args;
+    view.payload_len = args_len;
+
+    dlt_arg_reader reader(view);
+    while ((ret = reader.next(arg)) == 1) {
+        n_args ++;
+    }
+
+    return ret < 0 ? -1 : n_args;
+}
+
+bool dlt_service::process_msg(dlt_worker *worker, const dlt_config_snapshot *snap, dlt_rx_msg *msg)
+{
+    dlt_msg_if rx_msg;
+    uint8_t *payload;
+    uint8_t *enc_buf;
+    int payload_len;
+    int len;
+    uint64_t t_encode = 0;
+    uint64_t t_sinks = 0;
+    uint64_t t_forward = 0;
+    bool timed = false;
+
+    if (metrics_ && (-- worker->metrics_sample == 0)) {
+        worker->metrics_sample = DLT_METRICS_SAMPLE_RATE;
+        timed = true;
+        t_encode = dlt_metrics_now_ns();
+    }
+
+    // the header is encoded over the dlt_msg_if, keep a copy of it
+    memcpy(&rx_msg, msg->rx_msg, sizeof(rx_msg));
+
+    if ((rx_msg.dlt_log_lvl < DLT_MSG_LOG_LVL_INFO) ||
+        (rx_msg.dlt_log_lvl > DLT_MSG_LOG_LVL_FATAL)) {
+        return false;
+    }
+
+    payload = msg->rx_msg + sizeof(dlt_msg_if);
+    payload_len = msg->rx_msg_len - sizeof(dlt_msg_if);
+
+    // encode DLT message in place
+    switch (rx_msg.dlt_msg_type_info) {
+        case DLT_MSG_TYPEINFO_STRG:
+            enc_buf = snap->hdr_tmpl.encode(payload, payload_len,
+                                            msg->msg_counter,
+                                            rx_msg.session_id,
+                                            msg->timestamp,
+                                            snap->msg_info[rx_msg.dlt_log_lvl],
+                                            rx_msg.app_id,
+                                            rx_msg.ctx_id);
+            len = snap->hdr_tmpl.hdr_len + payload_len + 1;
         break;
-        case DLT_MSG_LOG_LVL_FATAL:
-            log_level = "fatal";
+        case DLT_MSG_TYPEINFO_ARGS: {
+            int n_args = count_args(payload, payload_len);
+
+            // malformed arguments are dropped rather than forwarded
+            if ((n_args < 0) || (n_args > UINT8_MAX)) {
+                return false;
+            }
+
+            enc_buf = snap->hdr_tmpl.encode_args(payload, payload_len,
+                                                 n_args,
+                                                 msg->msg_counter,
+                                                 rx_msg.session_id,
+                                                 msg->timestamp,
+                                                 snap->msg_info[rx_msg.dlt_log_lvl],
+                                                 rx_msg.app_id,
+                                                 rx_msg.ctx_id);
+            len = snap->hdr_tmpl.base_len + payload_len;
+        } break;
+        case DLT_MSG_TYPEINFO_NONVERBOSE:
+            // message id and packed arguments make up the whole payload
+            if (payload_len < (int)sizeof(uint32_t)) {
+                return false;
+            }
+
+            enc_buf = snap->hdr_tmpl.encode_args(payload, payload_len,
+                                                 0,
+                                                 msg->msg_counter,
+                                                 rx_msg.session_id,
+                                                 msg->timestamp,
+                                                 snap->msg_info_nv[rx_msg.dlt_log_lvl],
+                                                 rx_msg.app_id,
+                                                 rx_msg.ctx_id);
+            len = snap->hdr_tmpl.base_len + payload_len;
         break;
         default:
-            log_level = "unknown";
-        break;
+        return false;
+    }
+
+    if (timed) {
+        t_sinks = dlt_metrics_now_ns();
+        worker->metrics.encode_ns.record(t_sinks - t_encode);
     }
 
-    fprintf(stderr, "[%c%c%c%c] [%d] [%c%c%c%c][%c%c%c%c] [%s] %s",
-                    ecuid[0], ecuid[1], ecuid[2], ecuid[3],
-                    msg_count,
-                    app_id[0], app_id[1], app_id[2], app_id[3],
-                    ctx_id[0], ctx_id[1], ctx_id[2], ctx_id[3],
-                    log_level.c_str(),
-                    msg);
+    // the copying sinks take the message in place, each into its own queue
+    for (auto sink : snap->sinks) {
+        sink->write(enc_buf, len);
+    }
+
+    if (timed) {
+        t_forward = dlt_metrics_now_ns();
+        worker->metrics.sink_ns.record(t_forward - t_sinks);
+    }
+
+    // last, the forwarder owns the buffer from here and releases it once
+    // the datagram is sent
+    worker->storage_client->queue(enc_buf, len, msg->buf_idx);
+
+    if (timed) {
+        worker->metrics.forward_ns.record(dlt_metrics_now_ns() - t_forward);
+    }
+    worker->metrics.encoded.add();
+
+    return true;
 }
 
 dlt_service::~dlt_service()
 {
-
+    for (auto &worker : workers_) {
+        close(worker->rx_evt_fd);
+    }
+    close(sig_fd_);
+    if (config_watch_fd_ >= 0) {
+        close(config_watch_fd_);
+    }
+    if (stats_fd_ >= 0) {
+        close(stats_fd_);
+        unlink(get_config()->config->metrics_socket_path.c_str());
+    }
+    if (stats_timer_fd_ >= 0) {
+        close(stats_timer_fd_);
+    }
+    if (filter_page_) {
+        filter_page_->state = DLT_FILTER_PAGE_CLOSED;
+        munmap(filter_page_, sizeof(dlt_filter_page));
+        shm_unlink(DLT_FILTER_PAGE_NAME);
+    }
 }
 
 void dlt_service::run()
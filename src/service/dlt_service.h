@@ -13,13 +13,29 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
 #include <queue>
 #include <thread>
 #include <mutex>
-#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <auto_lib.h>
 #include <dlt_enc_dec.h>
+#include <dlt_spsc_ring.h>
+#include <dlt_buf_pool.h>
+#include <dlt_forwarder.h>
+#include <dlt_replay_ring.h>
+#include <dlt_catalog.h>
+#include <dlt_shm_server.h>
+#include <dlt_filter.h>
+#include <dlt_filter_page.h>
+#include <dlt_file_storage.h>
+#include <dlt_viewer_server.h>
+#include <dlt_console_sink.h>
+#include <dlt_sink.h>
+#include <dlt_metrics.h>
+#include <dlt_clock.h>
 
 // maximum message counter
 #define MSG_COUNTER_MAX_UINT 255
@@ -27,6 +43,60 @@
 // DLT configuration file
 #define DLT_CONFIG_FILE "./dlt_config.json"
 
+// default number of receive buffers, bounds the messages pending for processing
+#define DLT_RX_POOL_SIZE 1024
+
+// size of one receive buffer
+#define DLT_RX_BUF_SIZE 4096
+
+// space kept in front of a received message to encode the dlt header in
+// place, and one byte after it for the string null terminator
+#define DLT_RX_HEADROOM DLT_HDR_MAX_LEN
+#define DLT_RX_MSG_MAX_LEN (DLT_RX_BUF_SIZE - DLT_RX_HEADROOM - 1)
+
+// most records an envelope fitting a receive buffer holds
+#define DLT_RX_ENVELOPE_MAX_RECORDS ((DLT_RX_MSG_MAX_LEN - sizeof(dlt_msg_envelope)) / sizeof(dlt_msg_record))
+
+// default and maximum number of datagrams read per wakeup
+#define DLT_RX_BATCH_SIZE 32
+#define DLT_RX_BATCH_SIZE_MAX 256
+
+// default storage server batching
+#define DLT_STORAGE_BATCH_SIZE 32
+#define DLT_STORAGE_FLUSH_INTERVAL_MS 1
+#define DLT_STORAGE_MTU 1472
+
+// bytes of messages compressed into one datagram
+#define DLT_STORAGE_COMPRESS_SIZE 4096
+
+// default and maximum number of process workers
+#define DLT_PROCESS_WORKERS 1
+#define DLT_PROCESS_WORKERS_MAX 16
+
+// default local file storage
+#define DLT_FILE_STORAGE_DIRECTORY "./dlt_storage"
+#define DLT_FILE_STORAGE_PREFIX "dlt"
+#define DLT_FILE_STORAGE_SEGMENT_SIZE_MB 16
+#define DLT_FILE_STORAGE_MAX_SEGMENTS 16
+#define DLT_FILE_STORAGE_BLOCK_SIZE_KB 256
+#define DLT_FILE_STORAGE_FLUSH_INTERVAL_MS 100
+#define DLT_FILE_STORAGE_FSYNC_INTERVAL_MS 1000
+
+// default tcp viewer server
+#define DLT_VIEWER_ADDRESS "0.0.0.0"
+#define DLT_VIEWER_QUEUE_SIZE_KB 1024
+
+// default byte budget of recently encoded messages kept for replay
+#define DLT_REPLAY_BUFFER_SIZE (256 * 1024)
+
+// default stats endpoint and period of the statistics messages
+#define DLT_METRICS_SOCKET_PATH "/tmp/dlt_stats.sock"
+#define DLT_METRICS_INTERVAL_MS 10000
+
+// the service logs its statistics under its own ids
+#define DLT_METRICS_APP_ID "DLTD"
+#define DLT_METRICS_CTX_ID "STAT"
+
 namespace auto_os::middleware {
 
 /**
@@ -46,34 +116,53 @@ struct dlt_config {
     bool use_msb_first;
     bool send_ecu_id;
     bool send_timestamp;
+    // use the timestamp taken by the application, the arrival time otherwise
+    bool client_timestamps;
     int version;
     bool verbose_mode;
     std::string ecu_id;
     network_conn_type conn_type;
     std::string unix_server_path;
+    std::string shm_server_path;
+    size_t shm_max_ring_size;
     std::string udpv4_server_address;
     int udpv4_server_port;
     std::string storage_service_addr;
     int storage_service_port;
+    int storage_batch_size;
+    int storage_flush_interval_ms;
+    bool storage_pack_msgs;
+    int storage_mtu;
+    bool storage_compress;
+    int storage_compress_size;
+    bool viewer_server;
+    std::string viewer_address;
+    int viewer_port;
+    int viewer_queue_size;
+    int viewer_max_clients;
     bool log_to_console;
+    int console_queue_size;
+    bool file_storage;
+    dlt_file_storage_config file_storage_config;
+    int rx_buffer_pool_size;
+    int rx_batch_size;
+    int process_workers;
+    int replay_buffer_size;
+    std::string nonverbose_catalog;
+    bool publish_filters;
+    std::string filter_default_level;
+    std::vector<dlt_filter_rule> filter_rules;
+    bool metrics;
+    std::string metrics_socket_path;
+    int metrics_interval_ms;
 
+    explicit dlt_config() : conn_type(network_conn_type::UNIX), udpv4_server_port(0) { }
     ~dlt_config() { }
     dlt_config(const dlt_config &) = delete;
     const dlt_config& operator=(const dlt_config &) = delete;
     dlt_config(const dlt_config &&) = delete;
     const dlt_config&& operator=(const dlt_config &&) = delete;
 
-    /**
-     * @brief - get dlt config instance
-     * 
-     * @return dlt_config* 
-     */
-    static dlt_config *instance()
-    {
-        static dlt_config config;
-        return &config;
-    }
-
     /**
      * @brief - parse configuration file
      * 
@@ -81,19 +170,69 @@ struct dlt_config {
      * @return out returns 0 on success -1 on failure
      */
     int parse(const std::string config_file);
+};
 
-    private:
-        explicit dlt_config() { }
+/**
+ * @brief configuration in use and what is derived from it, never changed
+ *        once published
+ *
+ * a changed configuration file is parsed on the event_manager thread into
+ * a new snapshot that replaces the pointer in dlt_service. the workers
+ * load the pointer once per batch, so they never lock and never see half
+ * of a reload. the header template is only rebuilt when the header
+ * options changed.
+ */
+struct dlt_config_snapshot {
+    std::unique_ptr<dlt_config> config;
+    uint8_t ecu_id[4];
+    dlt_header_template hdr_tmpl;
+    // extended header message info by dlt_msg_log_lvl
+    uint8_t msg_info[DLT_MSG_LOG_LVL_FATAL + 1];
+    uint8_t msg_info_nv[DLT_MSG_LOG_LVL_FATAL + 1];
+    // enabled outputs, each message is written to all of them before it
+    // is handed to the worker's forwarder
+    std::vector<dlt_sink *> sinks;
+    // changes with the storage server settings, the workers then
+    // reconfigure their forwarder
+    uint32_t storage_generation;
 };
 
+/**
+ * @brief received message, the data itself stays in the rx buffer pool
+ *
+ * rx_msg points DLT_RX_HEADROOM bytes into the pool buffer. msg_counter
+ * is assigned in arrival order before the message is handed to a worker,
+ * and so is the timestamp of messages not timestamped by the application.
+ */
 struct dlt_rx_msg {
-    uint8_t rx_msg[4096];
+    uint8_t *rx_msg;
     int rx_msg_len;
+    uint32_t buf_idx;
+    uint8_t msg_counter;
+    uint32_t timestamp;
 };
 
-struct dlt_encoded_msg {
-    uint8_t enc_msg[4096];
-    int enc_msg_len;
+/**
+ * @brief process worker, encodes, forwards and prints the messages of
+ *        the sources sharded to it
+ */
+struct dlt_worker {
+    std::unique_ptr<dlt_spsc_ring<dlt_rx_msg>> rx_msg_list;
+    int rx_evt_fd;
+    // set by the receive side when it queued messages since the last notify
+    bool rx_pending;
+    // deepest the ring was when the receive side woke the worker
+    dlt_counter rx_queue_hwm;
+    std::unique_ptr<dlt_forwarder> storage_client;
+    // storage settings the forwarder was configured with
+    uint32_t storage_generation;
+    // snapshot the worker is using, nullptr while it waits for messages
+    std::atomic<dlt_config_snapshot *> config_in_use;
+    std::unique_ptr<std::thread> thr;
+    // only written by the worker thread
+    dlt_thread_metrics metrics;
+    // messages until the next timed one
+    uint32_t metrics_sample;
 };
 
 class dlt_service {
@@ -123,17 +262,85 @@ class dlt_service {
         // [PRS_Dlt_00308] ⌈If the ECU ID is shorter than four 8-bit ASCII characters, the
         // remaining characters shall be filled with 0x00. ⌋ (SRS_Dlt_00022)
         // 
-        inline void fill_ecu_id()
+        static inline void fill_ecu_id(dlt_config_snapshot *snap)
         {
-            dlt_config *config = dlt_config::instance();
-            int i;
+            size_t i;
 
-            ecu_id_[0] = ecu_id_[1] = ecu_id_[2] = ecu_id_[3] = 0x00;
+            snap->ecu_id[0] = snap->ecu_id[1] = snap->ecu_id[2] = snap->ecu_id[3] = 0x00;
 
-            for (i = 0; i < config->ecu_id.length(); i ++) {
-                ecu_id_[i] = config->ecu_id[i];
+            for (i = 0; (i < snap->config->ecu_id.length()) && (i < sizeof(snap->ecu_id)); i ++) {
+                snap->ecu_id[i] = snap->config->ecu_id[i];
             }
         }
+
+        /**
+         * @brief configuration in use, for the event_manager thread
+         */
+        inline dlt_config_snapshot *get_config()
+        {
+            return config_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief take the configuration in use for a batch of a worker
+         *
+         * the snapshot stays valid until release_config.
+         */
+        inline dlt_config_snapshot *acquire_config(dlt_worker *worker)
+        {
+            dlt_config_snapshot *snap;
+
+            // a replaced snapshot is freed once no worker has it in use,
+            // so check it was not replaced before that became visible
+            do {
+                snap = config_.load(std::memory_order_acquire);
+                worker->config_in_use.store(snap, std::memory_order_seq_cst);
+            } while (snap != config_.load(std::memory_order_seq_cst));
+
+            return snap;
+        }
+
+        inline void release_config(dlt_worker *worker)
+        {
+            worker->config_in_use.store(nullptr, std::memory_order_release);
+        }
+
+        /**
+         * @brief derive a snapshot from a parsed configuration
+         *
+         * @param in config parsed configuration
+         * @param in prev snapshot in use, nullptr at startup
+         * @return returns the snapshot or nullptr if the header can not be built
+         */
+        std::unique_ptr<dlt_config_snapshot> make_config(std::unique_ptr<dlt_config> config,
+                                                         const dlt_config_snapshot *prev);
+
+        /**
+         * @brief parse the configuration file again and publish it
+         *
+         * the configuration in use stays if the file does not parse. what
+         * can only be set up at startup is reported and keeps its value.
+         */
+        void reload_config();
+
+        /**
+         * @brief free the replaced snapshots no worker uses any more
+         */
+        void free_retired_configs();
+
+        /**
+         * @brief watch the directory of the configuration file, editors
+         *        often replace the file rather than write it
+         */
+        void setup_config_watch();
+
+        /**
+         * @brief reload the configuration once the file was written
+         * 
+         * @param in fd inotify descriptor
+         */
+        void receive_config_change(int fd);
+
         /**
          * @brief receive dlt message
          * 
@@ -142,38 +349,301 @@ class dlt_service {
         void receive_dlt_message(int fd);
 
         /**
-         * @brief process received message
+         * @brief receive up to rx_batch_size messages with one recvmmsg
+         * 
+         * @param in fd socket descriptor
+         */
+        void receive_dlt_message_batch(int fd);
+
+        /**
+         * @brief accept a client of the shared memory transport
+         * 
+         * @param in fd control socket descriptor
+         */
+        void accept_shm_client(int fd);
+
+        /**
+         * @brief take the rings of accepted shared memory clients
+         * 
+         * @param in fd epoll descriptor of the connections waiting for their ring
+         */
+        void receive_shm_handover(int fd);
+
+        /**
+         * @brief take messages from the shared memory rings
+         * 
+         * @param in fd eventfd of the shared memory transport
+         */
+        void receive_shm_messages(int fd);
+
+        /**
+         * @brief queue the records of an envelope, or answer a hello
+         *
+         * the records are validated and filtered in place, only those
+         * that pass get a buffer and are copied. with retry either all of
+         * them are queued or none and nothing is counted, so the caller
+         * can hand the envelope in again once the workers returned
+         * buffers. without retry, or when the envelope needs more buffers
+         * than the pool can ever have free, the records that do not fit
+         * are dropped and counted.
+         *
+         * @param in data envelope
+         * @param in len length of the envelope
+         * @param in sender socket to answer a hello on, nullptr if unknown
+         * @param in retry the caller keeps the envelope when the pool is exhausted
+         * @return returns number of records queued, -1 if the envelope is to be retried
+         */
+        int receive_envelope(const uint8_t *data, int len, const std::string *sender, bool retry);
+
+        /**
+         * @brief count messages dropped on an empty rx buffer pool
+         *
+         * @param in n number of messages
+         */
+        void rx_pool_exhausted(uint64_t n);
+
+        /**
+         * @brief let a stalled shared memory drain continue, called by the workers
+         *        once they returned buffers
+         */
+        void wake_stalled_rx();
+
+        /**
+         * @brief count a received message, validate it and apply the filter table
+         * 
+         * @param in msg message header
+         * @param in len length of the message
+         * @return true if the message is to be processed
+         * @return false if it is dropped, before it is copied or encoded
+         */
+        inline bool accept_msg(const dlt_msg_if *msg, int len)
+        {
+            dlt_drop_reason reason;
+
+            rx_metrics_.rx_msgs.add();
+            rx_metrics_.rx_bytes.add(len);
+
+            if (!check_msg(msg, len, reason)) {
+                rx_metrics_.drop(reason);
+                return false;
+            }
+
+            app_counts_.add(msg->app_id);
+
+            return true;
+        }
+
+        /**
+         * @brief validate a message and apply the filter table without counting it
+         *
+         * only the header is read, the payload may be somewhere else.
+         *
+         * @param in msg message header
+         * @param in len length of the message
+         * @param out reason why the message is dropped
+         * @return true if the message is to be processed
+         */
+        inline bool check_msg(const dlt_msg_if *msg, int len, dlt_drop_reason &reason)
+        {
+            if ((len < (int)sizeof(dlt_msg_if)) || (len > DLT_RX_MSG_MAX_LEN) ||
+                ((msg->dlt_msg_type_info & DLT_MSG_IF_TIMESTAMP) &&
+                 (len < (int)(sizeof(dlt_msg_if) + DLT_MSG_IF_TIMESTAMP_LEN))) ||
+                (msg->dlt_log_lvl < DLT_MSG_LOG_LVL_INFO) ||
+                (msg->dlt_log_lvl > DLT_MSG_LOG_LVL_FATAL)) {
+                reason = dlt_drop_reason::INVALID;
+                return false;
+            }
+
+            if (!filter_.pass(msg->app_id, msg->ctx_id, msg->dlt_log_lvl)) {
+                reason = dlt_drop_reason::FILTERED;
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief load the filter table from the configuration
+         * 
+         * @param in config configuration with the filter rules
+         * @return returns 0 on success -1 on failure
+         */
+        int load_filters(const dlt_config *config);
+
+        /**
+         * @brief create the shared memory page the filters are published in
+         */
+        void setup_filter_page();
+
+        /**
+         * @brief reload the configuration on SIGHUP
+         * 
+         * @param in fd signalfd
+         */
+        void receive_signal(int fd);
+
+        /**
+         * @brief create the stats endpoint and the statistics timer
+         * 
+         * @param in config configuration with the metrics settings
+         */
+        void setup_metrics(const dlt_config *config);
+
+        /**
+         * @brief write a snapshot of the metrics to a stats client and close it
+         * 
+         * @param in fd listening socket of the stats endpoint
          */
-        void process_received_message();
+        void accept_stats_client(int fd);
 
         /**
-         * @brief log to console
+         * @brief log the statistics of the last interval as dlt messages
          * 
-         * @param in loglvl log level
-         * @param in ecu_id ecu_id string
-         * @param in msg_count msg counter
-         * @param in app_id application id
-         * @param in ctx_id context id
-         * @param in str message string
-         * @param in str_len length of the string
+         * @param in fd timerfd
          */
-        void log_console(uint8_t loglvl,
-                         uint8_t *ecu_id,
-                         uint16_t msg_count,
-                         uint8_t *app_id,
-                         uint8_t *ctx_id,
-                         const char *str,
-                         int str_len);
+        void log_stats(int fd);
+
+        /**
+         * @brief render the metrics of all threads as "name value" lines
+         */
+        std::string render_stats();
+
+        /**
+         * @brief queue a string message of the service itself like a received one
+         * 
+         * @param in text message text
+         */
+        void log_self(const std::string &text);
+
+        /**
+         * @brief assign counter and timestamp and queue to the worker of the source
+         *
+         * messages of one session and application always go to the same
+         * worker so their order is kept.
+         * 
+         * @param in msg received message
+         */
+        void sequence_msg(dlt_rx_msg &msg);
+
+        /**
+         * @brief process received messages of one worker
+         * 
+         * @param in worker worker
+         */
+        void process_received_message(dlt_worker *worker);
+
+        /**
+         * @brief prebuild the dlt header bytes from the configuration
+         * 
+         * @param in snap snapshot with the configuration and ecu id
+         * @return returns 0 on success -1 on failure
+         */
+        int setup_header_template(dlt_config_snapshot *snap);
+
+        /**
+         * @brief create the console once it is enabled and list the
+         *        enabled outputs in the snapshot
+         * 
+         * @param in snap snapshot being built
+         */
+        void setup_sinks(dlt_config_snapshot *snap);
+
+        /**
+         * @brief validate and count verbose arguments sent by a client
+         * 
+         * @param in args encoded arguments
+         * @param in args_len length of the arguments
+         * @return returns number of arguments or -1 if malformed
+         */
+        int count_args(uint8_t *args, int args_len);
+
+        /**
+         * @brief encode one received message, fan it out to the sinks and
+         *        forward it
+         * 
+         * @param in worker worker running the message
+         * @param in msg received message
+         * @return true if the buffer was handed to the forwarder
+         * @return false if the message was dropped
+         */
+        bool process_msg(dlt_worker *worker, const dlt_config_snapshot *snap, dlt_rx_msg *msg);
+
+        /**
+         * @brief wake up the workers that got messages queued
+         */
+        void notify_rx();
+
+        /**
+         * @brief block until notify_rx wakes up the worker
+         * 
+         * @param in worker worker
+         * @param in timeout_ms time to wait, -1 waits forever
+         * @return true if woken up by notify_rx
+         * @return false on timeout
+         */
+        bool wait_rx(dlt_worker *worker, int timeout_ms);
+
         auto_os::lib::event_manager *evt_mgr_;
         std::shared_ptr<auto_os::lib::logger> log_;
         std::shared_ptr<auto_os::lib::unix_udp_server> server_;
-        std::unique_ptr<auto_os::lib::udp_client> storage_client_;
         uint8_t msg_counter_;
-        uint8_t ecu_id_[4];
-        std::queue<dlt_rx_msg> rx_msg_list_;
-        std::queue<dlt_encoded_msg> enc_msg_list_;
-        std::unique_ptr<std::thread> process_msg_thr_;
-        std::mutex rx_msg_q_lock_;
+        // start of the service, for the uptime
+        std::chrono::steady_clock::time_point start_time_;
+        // timestamps the messages the applications did not timestamp
+        dlt_clock *clock_;
+        bool client_timestamps_;
+        // formats of non verbose messages for the console
+        dlt_catalog catalog_;
+        std::string config_file_;
+        // replaced only on the event_manager thread
+        std::atomic<dlt_config_snapshot *> config_;
+        // replaced snapshots that a worker may still use
+        std::vector<dlt_config_snapshot *> retired_configs_;
+        // inotify on the directory of config_file_
+        int config_watch_fd_;
+        std::string config_name_;
+        // only used on the event_manager thread, so it can be replaced
+        // at runtime without locking
+        dlt_filter_table filter_;
+        int sig_fd_;
+        // filters as seen by the clients, nullptr if not published
+        dlt_filter_page *filter_page_;
+        // buffers are allocated and filled by receive_dlt_message on the
+        // event_manager thread and released by the workers
+        std::unique_ptr<dlt_buf_pool> rx_buf_pool_;
+        std::vector<std::unique_ptr<dlt_worker>> workers_;
+        bool rx_pool_empty_;
+        // buffers allocated for a batch receive but not filled
+        std::vector<uint32_t> rx_spare_bufs_;
+        std::unique_ptr<dlt_shm_server> shm_server_;
+        // set when a shared memory drain stopped on an empty rx buffer pool
+        std::atomic<bool> shm_stalled_;
+        // recent history for late connecting clients, nullptr if disabled
+        std::unique_ptr<dlt_replay_ring> enc_msg_list_;
+        // local .dlt segments, nullptr if disabled
+        std::unique_ptr<dlt_file_storage> file_storage_;
+        // tcp stream to dlt viewers, nullptr if disabled
+        std::unique_ptr<dlt_viewer_server> viewer_server_;
+        // console output, nullptr if disabled
+        std::unique_ptr<dlt_console_sink> console_;
+        // every output above that was created, the enabled ones are in
+        // the configuration snapshot
+        std::vector<dlt_sink *> sinks_;
+        // latencies are only sampled with metrics enabled, counters are
+        // always kept
+        bool metrics_;
+        // written on the event_manager thread only
+        dlt_thread_metrics rx_metrics_;
+        dlt_app_counters app_counts_;
+        int stats_fd_;
+        int stats_timer_fd_;
+        // totals at the previous statistics message, for the rates
+        uint64_t stats_at_ns_;
+        dlt_metrics_snapshot stats_prev_;
+        uint64_t stats_pool_empty_;
+        std::map<uint32_t, uint64_t> app_counts_prev_;
+        // messages per second of each application in the last interval
+        std::map<uint32_t, double> app_rates_;
 };
 
 }
@@ -0,0 +1,319 @@
+/**
+ * @file dlt_shm_server.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief accepts shared memory rings from dlt_lib clients
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <errno.h>
+#include <stdexcept>
+#include <algorithm>
+#include <dlt_msg_if.h>
+#include <dlt_shm_server.h>
+
+namespace auto_os::middleware {
+
+dlt_shm_server::dlt_shm_server(const std::string path, size_t max_ring_size) :
+                                path_(path),
+                                max_ring_size_(max_ring_size),
+                                closed_dropped_(0)
+{
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.length() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("shared memory socket path too long");
+    }
+    strcpy(addr.sun_path, path.c_str());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("failed to create shared memory socket");
+    }
+
+    unlink(path.c_str());
+    if ((bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(listen_fd_, DLT_SHM_MAX_CLIENTS) < 0)) {
+        close(listen_fd_);
+        throw std::runtime_error("failed to bind shared memory socket");
+    }
+
+    evt_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (evt_fd_ < 0) {
+        close(listen_fd_);
+        throw std::runtime_error("failed to create shared memory eventfd");
+    }
+
+    struct epoll_event evt;
+
+    pending_epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    pending_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    evt.events = EPOLLIN;
+    evt.data.fd = pending_timer_fd_;
+    if ((pending_epfd_ < 0) || (pending_timer_fd_ < 0) ||
+        (epoll_ctl(pending_epfd_, EPOLL_CTL_ADD, pending_timer_fd_, &evt) < 0)) {
+        if (pending_epfd_ >= 0) {
+            close(pending_epfd_);
+        }
+        if (pending_timer_fd_ >= 0) {
+            close(pending_timer_fd_);
+        }
+        close(evt_fd_);
+        close(listen_fd_);
+        throw std::runtime_error("failed to create shared memory handover events");
+    }
+}
+
+dlt_shm_server::~dlt_shm_server()
+{
+    for (auto &pending : pending_) {
+        close(pending.conn_fd);
+    }
+    for (auto &client : clients_) {
+        close(client.conn_fd);
+    }
+    close(pending_timer_fd_);
+    close(pending_epfd_);
+    close(evt_fd_);
+    close(listen_fd_);
+    unlink(path_.c_str());
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int dlt_shm_server::accept_client()
+{
+    struct epoll_event evt;
+    int conn_fd;
+    int ret;
+
+    conn_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (conn_fd < 0) {
+        return -1;
+    }
+
+    remove_closed_clients();
+    if (clients_.size() + pending_.size() >= DLT_SHM_MAX_CLIENTS) {
+        close(conn_fd);
+        return -1;
+    }
+
+    // the client sends the memfd right after connect, usually it is
+    // already queued
+    ret = receive_ring(conn_fd);
+    if (ret != 0) {
+        return ret > 0 ? 0 : -1;
+    }
+
+    evt.events = EPOLLIN;
+    evt.data.fd = conn_fd;
+    if (epoll_ctl(pending_epfd_, EPOLL_CTL_ADD, conn_fd, &evt) < 0) {
+        close(conn_fd);
+        return -1;
+    }
+    pending_.push_back({conn_fd, now_ns() + DLT_SHM_HANDOVER_TIMEOUT_MS * 1000000ULL});
+    arm_pending_timer();
+
+    return 0;
+}
+
+int dlt_shm_server::receive_pending()
+{
+    struct epoll_event evts[DLT_SHM_MAX_CLIENTS + 1];
+    uint64_t now = now_ns();
+    uint64_t val;
+    int dropped = 0;
+    int n_evts;
+    int i;
+
+    n_evts = epoll_wait(pending_epfd_, evts, DLT_SHM_MAX_CLIENTS + 1, 0);
+    for (i = 0; i < n_evts; i ++) {
+        int fd = evts[i].data.fd;
+        int ret;
+
+        if (fd == pending_timer_fd_) {
+            read(pending_timer_fd_, &val, sizeof(val));
+            continue;
+        }
+
+        ret = receive_ring(fd);
+        if (ret == 0) {
+            continue;
+        }
+        // a failed connection is closed, which also takes it out of the set
+        if (ret > 0) {
+            epoll_ctl(pending_epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        pending_.erase(std::remove_if(pending_.begin(), pending_.end(),
+                                      [fd](const dlt_shm_pending &p) { return p.conn_fd == fd; }),
+                       pending_.end());
+    }
+
+    for (auto it = pending_.begin(); it != pending_.end(); ) {
+        if (it->deadline_ns <= now) {
+            close(it->conn_fd);
+            it = pending_.erase(it);
+            dropped ++;
+            continue;
+        }
+        it ++;
+    }
+
+    arm_pending_timer();
+
+    return dropped;
+}
+
+void dlt_shm_server::arm_pending_timer()
+{
+    struct itimerspec its;
+    uint64_t deadline = 0;
+
+    memset(&its, 0, sizeof(its));
+    for (auto &pending : pending_) {
+        if ((deadline == 0) || (pending.deadline_ns < deadline)) {
+            deadline = pending.deadline_ns;
+        }
+    }
+
+    // a zero deadline disarms the timer
+    its.it_value.tv_sec = deadline / 1000000000ULL;
+    its.it_value.tv_nsec = deadline % 1000000000ULL;
+    timerfd_settime(pending_timer_fd_, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
+int dlt_shm_server::receive_ring(int conn_fd)
+{
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    uint8_t hello;
+    int ring_fd = -1;
+    int ret;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    ret = recvmsg(conn_fd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    if ((ret < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+        return 0;
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if ((ret > 0) && cmsg && (cmsg->cmsg_level == SOL_SOCKET) &&
+        (cmsg->cmsg_type == SCM_RIGHTS) && (cmsg->cmsg_len == CMSG_LEN(sizeof(int)))) {
+        memcpy(&ring_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (ring_fd < 0) {
+        close(conn_fd);
+        return -1;
+    }
+
+    // the client keeps the memfd, without the seals it could truncate it
+    // and fault the daemon in drain
+    struct stat st;
+    int seals = fcntl(ring_fd, F_GET_SEALS);
+
+    if ((seals < 0) ||
+        ((seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)) ||
+        (fstat(ring_fd, &st) < 0) ||
+        ((size_t)st.st_size > DLT_SHM_RING_HDR_SIZE + max_ring_size_)) {
+        close(ring_fd);
+        close(conn_fd);
+        return -1;
+    }
+
+    dlt_shm_client client;
+
+    try {
+        client.ring = std::make_unique<dlt_shm_ring>(ring_fd, 0);
+    } catch (std::exception &e) {
+        close(ring_fd);
+        close(conn_fd);
+        return -1;
+    }
+    client.conn_fd = conn_fd;
+
+    // reply with the eventfd to wake us on and the wire version we take
+    // from the ring, older releases echo the byte the client sent
+    hello = DLT_WIRE_VERSION;
+    memset(&msg, 0, sizeof(msg));
+    memset(ctrl, 0, sizeof(ctrl));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &evt_fd_, sizeof(int));
+
+    // nothing was sent on the connection yet, the reply fits
+    if (sendmsg(conn_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+        close(conn_fd);
+        return -1;
+    }
+
+    clients_.push_back(std::move(client));
+
+    // ring starts with waiting clear, pick up anything already queued
+    wakeup();
+
+    return 1;
+}
+
+void dlt_shm_server::remove_closed_clients()
+{
+    for (auto it = clients_.begin(); it != clients_.end(); ) {
+        uint8_t b;
+
+        // peek returns 0 only once the client closed its end
+        if (recv(it->conn_fd, &b, sizeof(b), MSG_DONTWAIT | MSG_PEEK) == 0) {
+            // leftover messages are taken by the next drain
+            if (it->ring->empty()) {
+                closed_dropped_ += it->ring->get_dropped();
+                close(it->conn_fd);
+                it = clients_.erase(it);
+                continue;
+            }
+        }
+        it ++;
+    }
+}
+
+uint64_t dlt_shm_server::get_dropped()
+{
+    uint64_t dropped = closed_dropped_;
+
+    for (auto &client : clients_) {
+        dropped += client.ring->get_dropped();
+    }
+
+    return dropped;
+}
+
+}
@@ -0,0 +1,194 @@
+/**
+ * @file dlt_shm_server.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief accepts shared memory rings from dlt_lib clients
+ * @version 0.1
+ * @date 2021-12-27
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_SHM_SERVER_H__
+#define __AUTO_MIDDLEWARE_DLT_SHM_SERVER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sys/socket.h>
+#include <dlt_shm_ring.h>
+
+namespace auto_os::middleware {
+
+// maximum number of clients with a shared memory ring
+#define DLT_SHM_MAX_CLIENTS 64
+
+// time a client has to send its memfd after connecting
+#define DLT_SHM_HANDOVER_TIMEOUT_MS 500
+
+// largest ring data area a client may hand over
+#define DLT_SHM_MAX_RING_SIZE_KB 16384
+
+/**
+ * @brief control socket and rings of the shared memory transport
+ *
+ * a client connects to the seqpacket control socket and passes the memfd
+ * of its ring, sealed against shrinking and growing so it can not fault
+ * the daemon, and no larger than the configured maximum. it gets back one eventfd shared by all clients, written when
+ * a ring goes from empty to non empty, and the DLT_WIRE_VERSION the ring
+ * entries may be sent in. the connection stays open, once it
+ * is closed the ring is drained and unmapped. a client that has not sent
+ * its memfd yet waits in an epoll set of its own, so it never blocks the
+ * event_manager thread, and is dropped after DLT_SHM_HANDOVER_TIMEOUT_MS.
+ * only called from the event_manager thread.
+ */
+class dlt_shm_server {
+    public:
+        /**
+         * @brief create control socket
+         * 
+         * @param in path unix socket path
+         * @param in max_ring_size largest ring data area accepted in bytes
+         */
+        explicit dlt_shm_server(const std::string path, size_t max_ring_size);
+        ~dlt_shm_server();
+
+        dlt_shm_server(const dlt_shm_server &) = delete;
+        const dlt_shm_server &operator=(const dlt_shm_server &) = delete;
+        dlt_shm_server(const dlt_shm_server &&) = delete;
+        const dlt_shm_server &&operator=(const dlt_shm_server &&) = delete;
+
+        inline int get_socket() { return listen_fd_; }
+        inline int get_event() { return evt_fd_; }
+        inline int get_pending_event() { return pending_epfd_; }
+
+        /**
+         * @brief accept a client and map its ring once it is sent
+         * 
+         * @return returns 0 on success -1 on failure
+         */
+        int accept_client();
+
+        /**
+         * @brief take the rings of the clients that sent them since they
+         *        connected and drop the ones that took too long
+         * 
+         * @return returns number of clients dropped
+         */
+        int receive_pending();
+
+        /**
+         * @brief take messages from all rings until they are empty
+         *
+         * the rings are served round robin, rx_batch messages at a time,
+         * and re-armed for the eventfd. closed clients are removed once
+         * their ring is empty. when the callback refuses a message the
+         * drain stops with the rings left as they are, call wakeup() once
+         * there is room again.
+         * 
+         * @param in cb called with each message, only valid in the call,
+         *           returns false if the message can not be taken now
+         * @param in rx_batch messages taken from one ring per round
+         * @return returns number of messages taken
+         */
+        template <typename Cb>
+        int drain(Cb cb, int rx_batch)
+        {
+            uint64_t val;
+            int n_msgs = 0;
+            bool pending = true;
+            bool stalled = false;
+            auto take = [&](const uint8_t *msg, uint32_t len) {
+                if (!cb(msg, len)) {
+                    stalled = true;
+                    return false;
+                }
+                return true;
+            };
+
+            read(evt_fd_, &val, sizeof(val));
+
+            while (pending) {
+                int round = 0;
+
+                for (auto &client : clients_) {
+                    round += client.ring->pop(take, rx_batch);
+                    if (stalled) {
+                        return n_msgs + round;
+                    }
+                }
+                n_msgs += round;
+
+                if (round > 0) {
+                    continue;
+                }
+
+                pending = false;
+                for (auto &client : clients_) {
+                    if (!client.ring->set_waiting()) {
+                        pending = true;
+                    }
+                }
+            }
+
+            remove_closed_clients();
+
+            return n_msgs;
+        }
+
+        /**
+         * @brief run drain again from the event_manager thread
+         */
+        inline void wakeup()
+        {
+            uint64_t val = 1;
+
+            write(evt_fd_, &val, sizeof(val));
+        }
+
+        /**
+         * @brief messages the clients dropped on a full ring
+         */
+        uint64_t get_dropped();
+
+    private:
+        struct dlt_shm_client {
+            int conn_fd;
+            std::unique_ptr<dlt_shm_ring> ring;
+        };
+
+        struct dlt_shm_pending {
+            int conn_fd;
+            uint64_t deadline_ns;
+        };
+
+        /**
+         * @brief map the ring a client sent and answer it
+         * 
+         * @param in conn_fd connection of the client, closed on failure
+         * @return returns 1 if the client was added, 0 if nothing was
+         *         sent yet and -1 on failure
+         */
+        int receive_ring(int conn_fd);
+
+        /**
+         * @brief wake up receive_pending at the earliest deadline
+         */
+        void arm_pending_timer();
+
+        void remove_closed_clients();
+
+        std::string path_;
+        size_t max_ring_size_;
+        int listen_fd_;
+        int evt_fd_;
+        // connections waiting for their memfd and their deadline timer
+        int pending_epfd_;
+        int pending_timer_fd_;
+        std::vector<dlt_shm_pending> pending_;
+        std::vector<dlt_shm_client> clients_;
+        uint64_t closed_dropped_;
+};
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file dlt_sink.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief output of encoded dlt messages
+ * @version 0.1
+ * @date 2022-01-01
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_SINK_H__
+#define __AUTO_MIDDLEWARE_DLT_SINK_H__
+
+#include <stdint.h>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief output the workers fan every encoded message out to
+ *
+ * a message is encoded once in its rx buffer and the same bytes are
+ * handed to every sink. write is called by any worker and must not wait
+ * for I/O, a sink copies the message into a queue of its own that its
+ * own thread drains, and drops the message when the queue is full. so a
+ * slow sink only loses its own messages.
+ */
+class dlt_sink {
+    public:
+        virtual ~dlt_sink() { }
+
+        /**
+         * @brief queue an encoded message
+         *
+         * @param in msg encoded dlt message, valid during the call only
+         * @param in len length of the message
+         * @return returns 0 on success -1 if the message is dropped
+         */
+        virtual int write(const uint8_t *msg, int len) = 0;
+
+        /**
+         * @brief name in logs and statistics
+         */
+        virtual const char *get_name() = 0;
+
+        /**
+         * @brief messages dropped because the queue was full
+         */
+        virtual uint64_t get_dropped() = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/**
+ * @file dlt_spsc_ring.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief bounded single producer / single consumer ring
+ * @version 0.1
+ * @date 2021-12-26
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_SPSC_RING_H__
+#define __AUTO_MIDDLEWARE_DLT_SPSC_RING_H__
+
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+namespace auto_os::middleware {
+
+/**
+ * @brief lock free ring between exactly one producer thread and one consumer thread
+ *
+ * head_ is only written by the consumer and tail_ only by the producer,
+ * so each side owns one index and publishes it with release ordering.
+ */
+template <typename T>
+class dlt_spsc_ring {
+    public:
+        /**
+         * @brief create ring
+         * 
+         * @param in capacity number of slots, must be a power of 2
+         */
+        explicit dlt_spsc_ring(size_t capacity) :
+                            slots_(capacity),
+                            mask_(capacity - 1),
+                            head_(0),
+                            tail_(0)
+        {
+            if ((capacity == 0) || ((capacity & (capacity - 1)) != 0)) {
+                throw std::runtime_error("ring capacity must be a power of 2");
+            }
+        }
+        ~dlt_spsc_ring() { }
+
+        dlt_spsc_ring(const dlt_spsc_ring &) = delete;
+        const dlt_spsc_ring &operator=(const dlt_spsc_ring &) = delete;
+        dlt_spsc_ring(const dlt_spsc_ring &&) = delete;
+        const dlt_spsc_ring &&operator=(const dlt_spsc_ring &&) = delete;
+
+        /**
+         * @brief get a slot to fill in, called from producer
+         * 
+         * @return returns free slot or nullptr if ring is full
+         */
+        inline T *producer_slot()
+        {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+
+            if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+                return nullptr;
+            }
+
+            return &slots_[tail & mask_];
+        }
+
+        /**
+         * @brief publish the slot returned by producer_slot
+         */
+        inline void producer_commit()
+        {
+            tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+        }
+
+        /**
+         * @brief copy an element into the ring, called from producer
+         * 
+         * @param in val element
+         * @return true if queued
+         * @return false if ring is full
+         */
+        inline bool push(const T &val)
+        {
+            T *slot = producer_slot();
+
+            if (!slot) {
+                return false;
+            }
+
+            *slot = val;
+            producer_commit();
+
+            return true;
+        }
+
+        /**
+         * @brief get oldest element, called from consumer
+         * 
+         * @return returns element or nullptr if ring is empty
+         */
+        inline T *front()
+        {
+            size_t head = head_.load(std::memory_order_relaxed);
+
+            if (head == tail_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+
+            return &slots_[head & mask_];
+        }
+
+        /**
+         * @brief release element returned by front, called from consumer
+         */
+        inline void pop()
+        {
+            head_.store(head_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+        }
+
+        /**
+         * @brief approximate number of queued elements
+         */
+        inline size_t size()
+        {
+            return tail_.load(std::memory_order_acquire) -
+                   head_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::vector<T> slots_;
+        size_t mask_;
+        alignas(64) std::atomic<size_t> head_;
+        alignas(64) std::atomic<size_t> tail_;
+};
+
+}
+
+#endif
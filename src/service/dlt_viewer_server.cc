@@ -0,0 +1,337 @@
+/**
+ * @file dlt_viewer_server.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief streams encoded dlt messages to dlt viewers over tcp
+ * @version 0.1
+ * @date 2021-12-31
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <dlt_viewer_server.h>
+
+namespace auto_os::middleware {
+
+dlt_viewer_server::dlt_viewer_server(const std::string addr,
+                                     int port,
+                                     size_t queue_size,
+                                     int max_clients,
+                                     dlt_replay_ring *replay) :
+                                queue_size_(queue_size),
+                                max_clients_(max_clients),
+                                replay_(replay),
+                                n_clients_(0),
+                                dropped_(0),
+                                stop_(false)
+{
+    struct sockaddr_in sa;
+    struct epoll_event ev;
+    int on = 1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    if (inet_pton(AF_INET, addr.c_str(), &sa.sin_addr) != 1) {
+        throw std::runtime_error("invalid viewer server address");
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("failed to create viewer socket");
+    }
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if ((bind(listen_fd_, (struct sockaddr *)&sa, sizeof(sa)) < 0) ||
+        (listen(listen_fd_, max_clients_) < 0)) {
+        close(listen_fd_);
+        throw std::runtime_error("failed to listen on viewer port");
+    }
+
+    evt_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ep_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if ((evt_fd_ < 0) || (ep_fd_ < 0)) {
+        close(listen_fd_);
+        throw std::runtime_error("failed to create viewer events");
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(ep_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    ev.data.fd = evt_fd_;
+    epoll_ctl(ep_fd_, EPOLL_CTL_ADD, evt_fd_, &ev);
+
+    thr_ = std::thread(&dlt_viewer_server::run, this);
+}
+
+dlt_viewer_server::~dlt_viewer_server()
+{
+    uint64_t val = 1;
+
+    stop_ = true;
+    if (::write(evt_fd_, &val, sizeof(val)) < 0) {
+        // the thread also wakes up on its poll timeout
+    }
+    thr_.join();
+
+    for (auto &c : clients_) {
+        close(c->fd);
+    }
+    close(ep_fd_);
+    close(evt_fd_);
+    close(listen_fd_);
+}
+
+bool dlt_viewer_server::queue(client *c, const uint8_t *msg, int len)
+{
+    size_t pos = c->tail % queue_size_;
+    size_t n = std::min((size_t)len, queue_size_ - pos);
+    bool was_empty = (c->head == c->tail);
+
+    // whole messages only, a viewer never sees a partial frame
+    if (queue_size_ - (c->tail - c->head) < (size_t)len) {
+        c->dropped ++;
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(c->buf.get() + pos, msg, n);
+    memcpy(c->buf.get(), msg + n, len - n);
+    c->tail += len;
+
+    return was_empty;
+}
+
+void dlt_viewer_server::queue_all(const uint8_t *msg, int len)
+{
+    bool wake = false;
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+
+        for (auto &c : clients_) {
+            // a viewer with data queued is already being written
+            if (queue(c.get(), msg, len)) {
+                wake = true;
+            }
+        }
+    }
+
+    if (wake) {
+        uint64_t val = 1;
+
+        if (::write(evt_fd_, &val, sizeof(val)) < 0) {
+            // counter is already non zero
+        }
+    }
+}
+
+void dlt_viewer_server::run()
+{
+    struct epoll_event events[DLT_VIEWER_MAX_CLIENTS + 2];
+
+    while (!stop_) {
+        int n = epoll_wait(ep_fd_, events, DLT_VIEWER_MAX_CLIENTS + 2, 1000);
+
+        for (int i = 0; i < n; i ++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listen_fd_) {
+                accept_client();
+            } else if (fd == evt_fd_) {
+                uint64_t val;
+
+                if (read(evt_fd_, &val, sizeof(val)) < 0) {
+                    // spurious wakeup
+                }
+                // the clients behind wait for EPOLLOUT instead. send_client
+                // may remove the client, walking backwards skips nobody
+                for (size_t j = clients_.size(); j > 0; j --) {
+                    if (!clients_[j - 1]->want_out) {
+                        send_client(clients_[j - 1].get());
+                    }
+                }
+            } else {
+                client *c = find_client(fd);
+
+                if (!c) {
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    uint8_t buf[512];
+                    int ret;
+
+                    // viewer control requests are not answered, read them
+                    // to notice the close
+                    ret = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+                    if ((ret == 0) || ((ret < 0) && (errno != EAGAIN) && (errno != EINTR))) {
+                        remove_client(c);
+                        continue;
+                    }
+                }
+                if (events[i].events & EPOLLOUT) {
+                    send_client(c);
+                }
+            }
+        }
+    }
+}
+
+void dlt_viewer_server::accept_client()
+{
+    struct epoll_event ev;
+    int on = 1;
+    int fd;
+
+    fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    if ((int)clients_.size() >= max_clients_) {
+        close(fd);
+        return;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    auto c = std::make_unique<client>();
+
+    c->fd = fd;
+    c->buf = std::make_unique<uint8_t[]>(queue_size_);
+    c->head = 0;
+    c->tail = 0;
+    c->want_out = false;
+    c->dropped = 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(ep_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        return;
+    }
+
+    client *cp = c.get();
+    uint64_t pos = 0;
+    auto replay_cb = [&](const uint8_t *msg, uint16_t msg_len) {
+        queue(cp, msg, msg_len);
+    };
+
+    // history first. the viewer is not published yet, so the workers do
+    // not wait on lock_ while it is copied
+    if (replay_) {
+        replay_->replay(replay_cb, &pos);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+
+        // the workers write the replay ring before the viewers, catching
+        // up on it here means a message may reach this viewer twice but
+        // never goes missing
+        if (replay_) {
+            replay_->replay(replay_cb, &pos);
+        }
+        clients_.push_back(std::move(c));
+        n_clients_.store(clients_.size(), std::memory_order_relaxed);
+    }
+
+    send_client(cp);
+}
+
+void dlt_viewer_server::send_client(client *c)
+{
+    while (1) {
+        uint64_t head;
+        uint64_t tail;
+        ssize_t ret;
+
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+
+            head = c->head;
+            tail = c->tail;
+        }
+
+        if (head == tail) {
+            break;
+        }
+
+        size_t pos = head % queue_size_;
+        size_t n = std::min(tail - head, queue_size_ - pos);
+
+        ret = send(c->fd, c->buf.get() + pos, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                // the viewer is behind, only its queue grows
+                if (!c->want_out) {
+                    struct epoll_event ev;
+
+                    memset(&ev, 0, sizeof(ev));
+                    ev.events = EPOLLIN | EPOLLOUT;
+                    ev.data.fd = c->fd;
+                    epoll_ctl(ep_fd_, EPOLL_CTL_MOD, c->fd, &ev);
+                    c->want_out = true;
+                }
+                return;
+            }
+            remove_client(c);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(lock_);
+
+        c->head += ret;
+    }
+
+    if (c->want_out) {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = c->fd;
+        epoll_ctl(ep_fd_, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_out = false;
+    }
+}
+
+void dlt_viewer_server::remove_client(client *c)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+
+    for (auto it = clients_.begin(); it != clients_.end(); it ++) {
+        if (it->get() == c) {
+            epoll_ctl(ep_fd_, EPOLL_CTL_DEL, c->fd, nullptr);
+            close(c->fd);
+            clients_.erase(it);
+            break;
+        }
+    }
+    n_clients_.store(clients_.size(), std::memory_order_relaxed);
+}
+
+dlt_viewer_server::client *dlt_viewer_server::find_client(int fd)
+{
+    for (auto &c : clients_) {
+        if (c->fd == fd) {
+            return c.get();
+        }
+    }
+
+    return nullptr;
+}
+
+}
@@ -0,0 +1,120 @@
+/**
+ * @file dlt_viewer_server.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief streams encoded dlt messages to dlt viewers over tcp
+ * @version 0.1
+ * @date 2021-12-31
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_VIEWER_SERVER_H__
+#define __AUTO_MIDDLEWARE_DLT_VIEWER_SERVER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <dlt_replay_ring.h>
+#include <dlt_sink.h>
+
+namespace auto_os::middleware {
+
+// standard dlt viewer port
+#define DLT_VIEWER_PORT 3490
+
+// maximum number of connected viewers
+#define DLT_VIEWER_MAX_CLIENTS 16
+
+/**
+ * @brief tcp server streaming every encoded message to all viewers
+ *
+ * Each viewer has its own byte queue. write copies a message into all
+ * queues under a short lock and never waits for a socket, a message that
+ * does not fit in a viewer's queue is dropped for that viewer only. A
+ * thread of its own writes the queues with non blocking sends and waits
+ * for EPOLLOUT on a viewer that is behind. A new viewer first gets the
+ * history kept in the replay ring.
+ */
+class dlt_viewer_server : public dlt_sink {
+    public:
+        /**
+         * @brief create the listening socket and start the server thread
+         *
+         * @param in addr ipv4 address to listen on
+         * @param in port tcp port
+         * @param in queue_size bytes queued per viewer
+         * @param in max_clients maximum number of viewers
+         * @param in replay history sent to new viewers, may be nullptr
+         */
+        explicit dlt_viewer_server(const std::string addr,
+                                   int port,
+                                   size_t queue_size,
+                                   int max_clients,
+                                   dlt_replay_ring *replay);
+        ~dlt_viewer_server();
+
+        dlt_viewer_server(const dlt_viewer_server &) = delete;
+        const dlt_viewer_server &operator=(const dlt_viewer_server &) = delete;
+        dlt_viewer_server(const dlt_viewer_server &&) = delete;
+        const dlt_viewer_server &&operator=(const dlt_viewer_server &&) = delete;
+
+        /**
+         * @brief queue an encoded message to every viewer, called by the workers
+         *
+         * @param in msg encoded message
+         * @param in len length of the message
+         * @return returns 0, drops are counted per viewer
+         */
+        inline int write(const uint8_t *msg, int len) override
+        {
+            if (n_clients_.load(std::memory_order_relaxed) > 0) {
+                queue_all(msg, len);
+            }
+            return 0;
+        }
+
+        inline const char *get_name() override { return "viewer"; }
+        inline uint64_t get_dropped() override { return dropped_.load(std::memory_order_relaxed); }
+        inline int get_clients() { return n_clients_.load(std::memory_order_relaxed); }
+
+    private:
+        struct client {
+            int fd;
+            std::unique_ptr<uint8_t[]> buf;
+            // running byte offsets, written under lock_, the bytes in
+            // between are only read by the server thread
+            uint64_t head;
+            uint64_t tail;
+            bool want_out;
+            uint64_t dropped;
+        };
+
+        void queue_all(const uint8_t *msg, int len);
+        bool queue(client *c, const uint8_t *msg, int len);
+        void run();
+        void accept_client();
+        void send_client(client *c);
+        void remove_client(client *c);
+        client *find_client(int fd);
+
+        int listen_fd_;
+        int evt_fd_;
+        int ep_fd_;
+        size_t queue_size_;
+        int max_clients_;
+        dlt_replay_ring *replay_;
+
+        std::mutex lock_;
+        std::vector<std::unique_ptr<client>> clients_;
+        std::atomic<int> n_clients_;
+        std::atomic<uint64_t> dropped_;
+        std::atomic<bool> stop_;
+        std::thread thr_;
+};
+
+}
+
+#endif
@@ -0,0 +1,529 @@
+/**
+ * @file dlt_file_storage.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief stores encoded dlt messages in rotated .dlt files
+ * @version 0.1
+ * @date 2021-12-28
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <stdexcept>
+#include <dlt_enc_dec.h>
+#include <dlt_compress.h>
+#include <dlt_file_storage.h>
+
+namespace auto_os::middleware {
+
+dlt_file_storage::dlt_file_storage(const dlt_file_storage_config &config, const uint8_t *ecu_id) :
+                                config_(config),
+                                stop_(false),
+                                fd_(-1),
+                                idx_fd_(-1),
+                                fd_direct_(false),
+                                staging_(nullptr),
+                                staging_len_(0),
+                                file_off_(0),
+                                reopen_delay_ms_(0),
+                                segment_seq_(0),
+                                dropped_(0),
+                                write_errors_(0),
+                                bytes_written_(0)
+{
+    struct dirent *ent;
+    DIR *dir;
+
+    set_ecu_id(ecu_id);
+
+    // whole number of aligned writes per block
+    config_.block_size = (config_.block_size + DLT_STORAGE_ALIGN - 1) & ~((size_t)DLT_STORAGE_ALIGN - 1);
+    if (config_.block_size < DLT_STORAGE_ALIGN) {
+        config_.block_size = DLT_STORAGE_ALIGN;
+    }
+
+    if ((mkdir(config_.directory.c_str(), 0755) < 0) && (errno != EEXIST)) {
+        throw std::runtime_error("failed to create storage directory");
+    }
+
+    // segments of earlier runs count against max_segments, the names
+    // carry the creation time so they sort oldest first
+    dir = opendir(config_.directory.c_str());
+    if (!dir) {
+        throw std::runtime_error("failed to open storage directory");
+    }
+    while ((ent = readdir(dir)) != nullptr) {
+        std::string name = ent->d_name;
+
+        if ((name.compare(0, config_.prefix.length() + 1, config_.prefix + "_") == 0) &&
+            (name.length() > 4) && (name.compare(name.length() - 4, 4, ".dlt") == 0)) {
+            segments_.push_back(config_.directory + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(segments_.begin(), segments_.end());
+
+    if (config_.compress) {
+        comp_buf_.resize(dlt_block::bound(config_.block_size));
+    }
+
+    staging_ = (uint8_t *)aligned_alloc(DLT_STORAGE_ALIGN, config_.block_size + DLT_STORAGE_ALIGN);
+    if (!staging_) {
+        throw std::runtime_error("failed to allocate storage buffer");
+    }
+
+    for (int i = 0; i < DLT_STORAGE_N_BLOCKS; i ++) {
+        auto b = std::make_unique<block>();
+
+        b->buf = std::make_unique<uint8_t[]>(config_.block_size);
+        b->len = 0;
+        // spans are cut at DLT_INDEX_SPAN_SIZE and at the block start
+        b->spans.resize(config_.index ? config_.block_size / DLT_INDEX_SPAN_SIZE + 1 : 0);
+        b->n_spans = 0;
+        free_.push_back(b.get());
+        blocks_.push_back(std::move(b));
+    }
+    active_ = free_.back();
+    free_.pop_back();
+
+    if (open_segment() < 0) {
+        free(staging_);
+        throw std::runtime_error("failed to open storage segment");
+    }
+
+    writer_thr_ = std::thread(&dlt_file_storage::writer, this);
+}
+
+dlt_file_storage::~dlt_file_storage()
+{
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+
+        stop_ = true;
+    }
+    cond_.notify_one();
+    writer_thr_.join();
+
+    free(staging_);
+}
+
+int dlt_file_storage::write(const uint8_t *msg, int len)
+{
+    uint8_t hdr[DLT_STORAGE_HDR_LEN];
+    static const uint8_t no_id[4] = {0, 0, 0, 0};
+    const uint8_t *app_id = no_id;
+    const uint8_t *ctx_id = no_id;
+    uint8_t level = DLT_INDEX_LEVEL_NON_LOG;
+    struct timespec ts;
+    uint32_t ecu_id;
+    uint32_t sec;
+    int32_t usec;
+    size_t need = DLT_STORAGE_HDR_LEN + len;
+
+    if (need > config_.block_size) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    // storage header, time of storing in little endian
+    clock_gettime(CLOCK_REALTIME, &ts);
+    sec = ts.tv_sec;
+    usec = ts.tv_nsec / 1000;
+    memcpy(hdr, DLT_STORAGE_HDR_PATTERN, DLT_STORAGE_HDR_PATTERN_LEN);
+    memcpy(hdr + 4, &sec, sizeof(sec));
+    memcpy(hdr + 8, &usec, sizeof(usec));
+    ecu_id = ecu_id_.load(std::memory_order_relaxed);
+    memcpy(hdr + 12, &ecu_id, sizeof(ecu_id));
+
+    if (config_.index) {
+        dlt_msg_view view;
+        size_t more;
+
+        if ((dlt_decoder::parse(msg, len, false, view, more) > 0) && view.has_ext_hdr) {
+            app_id = view.app_id;
+            ctx_id = view.ctx_id;
+            level = dlt_index_level_bit(view.message_info);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(lock_);
+
+    if (active_->len + need > config_.block_size) {
+        // the device is behind, drop rather than wait
+        if (free_.empty()) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        full_.push_back(active_);
+        active_ = free_.back();
+        free_.pop_back();
+        cond_.notify_one();
+    }
+
+    memcpy(active_->buf.get() + active_->len, hdr, DLT_STORAGE_HDR_LEN);
+    memcpy(active_->buf.get() + active_->len + DLT_STORAGE_HDR_LEN, msg, len);
+    if (config_.index) {
+        index_msg(active_, need, (uint64_t)sec * 1000000 + usec, app_id, ctx_id, level);
+    }
+    active_->len += need;
+
+    return 0;
+}
+
+void dlt_file_storage::index_msg(block *b, size_t need, uint64_t time_us,
+                                 const uint8_t *app_id, const uint8_t *ctx_id, uint8_t level)
+{
+    span *sp = b->n_spans > 0 ? &b->spans[b->n_spans - 1] : nullptr;
+    dlt_index_entry *e;
+    uint16_t i;
+
+    if (!sp || (sp->entry.length >= DLT_INDEX_SPAN_SIZE)) {
+        sp = &b->spans[b->n_spans ++];
+        memset(&sp->entry, 0, sizeof(sp->entry));
+        sp->entry.block_off = b->len;
+        sp->entry.first_us = time_us;
+        sp->entry.last_us = time_us;
+    }
+
+    e = &sp->entry;
+    e->length += need;
+    e->n_msgs ++;
+    // workers take the time before the lock, keep the range exact
+    e->first_us = std::min(e->first_us, time_us);
+    e->last_us = std::max(e->last_us, time_us);
+    e->levels |= level;
+
+    for (i = 0; i < e->n_keys; i ++) {
+        if ((memcmp(sp->keys[i].app_id, app_id, 4) == 0) &&
+            (memcmp(sp->keys[i].ctx_id, ctx_id, 4) == 0)) {
+            sp->keys[i].levels |= level;
+            return;
+        }
+    }
+    if (e->n_keys == DLT_INDEX_MAX_KEYS) {
+        e->flags |= DLT_INDEX_KEYS_OVERFLOW;
+        return;
+    }
+    memcpy(sp->keys[i].app_id, app_id, 4);
+    memcpy(sp->keys[i].ctx_id, ctx_id, 4);
+    sp->keys[i].levels = level;
+    memset(sp->keys[i].reserved, 0, sizeof(sp->keys[i].reserved));
+    e->n_keys ++;
+}
+
+void dlt_file_storage::write_index(block *b, size_t seg_off, bool compressed)
+{
+    size_t len = 0;
+
+    if (idx_fd_ < 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < b->n_spans; i ++) {
+        len += sizeof(dlt_index_entry) + b->spans[i].entry.n_keys * sizeof(dlt_index_key);
+    }
+    idx_buf_.resize(len);
+
+    len = 0;
+    for (size_t i = 0; i < b->n_spans; i ++) {
+        span *sp = &b->spans[i];
+        size_t keys_len = sp->entry.n_keys * sizeof(dlt_index_key);
+
+        if (compressed) {
+            sp->entry.offset = seg_off;
+        } else {
+            sp->entry.offset = seg_off + sp->entry.block_off;
+            sp->entry.block_off = 0;
+        }
+        memcpy(idx_buf_.data() + len, &sp->entry, sizeof(sp->entry));
+        memcpy(idx_buf_.data() + len + sizeof(sp->entry), sp->keys, keys_len);
+        len += sizeof(sp->entry) + keys_len;
+    }
+
+    // the index is only a hint, a reader scans data past its last entry
+    if (::write(idx_fd_, idx_buf_.data(), len) != (ssize_t)len) {
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void dlt_file_storage::writer()
+{
+    std::unique_lock<std::mutex> lock(lock_);
+
+    while (1) {
+        block *b = nullptr;
+        bool partial = false;
+
+        cond_.wait_for(lock, std::chrono::milliseconds(config_.flush_interval_ms), [this]() {
+            return !full_.empty() || stop_;
+        });
+
+        if (!full_.empty()) {
+            b = full_.front();
+            full_.pop_front();
+        } else if ((active_->len > 0) && !free_.empty()) {
+            // flush interval expired or stopping, take the partial block
+            b = active_;
+            active_ = free_.back();
+            free_.pop_back();
+            partial = true;
+        } else if (stop_) {
+            break;
+        }
+
+        lock.unlock();
+
+        // without a segment the blocks are discarded until one opens
+        if (fd_ < 0) {
+            reopen_segment();
+        }
+
+        if (b) {
+            size_t seg_off = file_off_ + staging_len_;
+            int len = -1;
+
+            if (config_.compress) {
+                len = dlt_block::encode(b->buf.get(), b->len, true, comp_buf_.data(), comp_buf_.size());
+            }
+            if (len > 0) {
+                write_block(comp_buf_.data(), len);
+            } else {
+                write_block(b->buf.get(), b->len);
+            }
+            write_index(b, seg_off, len > 0);
+        }
+        // make the tail of a partial block visible in the file
+        if (partial) {
+            write_staging(true);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        if (((config_.segment_size > 0) && (file_off_ + staging_len_ >= config_.segment_size)) ||
+            ((config_.segment_duration_s > 0) && (file_off_ + staging_len_ > 0) &&
+             (now - segment_start_ >= std::chrono::seconds(config_.segment_duration_s)))) {
+            close_segment();
+            reopen_segment();
+        } else if (b && (fd_ >= 0) && ((config_.fsync == dlt_fsync_policy::BATCH) ||
+                   ((config_.fsync == dlt_fsync_policy::INTERVAL) &&
+                    (now - last_fsync_ >= std::chrono::milliseconds(config_.fsync_interval_ms))))) {
+            fdatasync(fd_);
+            last_fsync_ = now;
+        }
+
+        lock.lock();
+
+        if (b) {
+            b->len = 0;
+            b->n_spans = 0;
+            free_.push_back(b);
+        }
+    }
+
+    lock.unlock();
+    close_segment();
+}
+
+void dlt_file_storage::write_block(const uint8_t *data, size_t len)
+{
+    size_t cap = config_.block_size + DLT_STORAGE_ALIGN;
+
+    while (len > 0) {
+        size_t n = std::min(len, cap - staging_len_);
+
+        // write_staging always empties all but the unaligned tail, this
+        // only guards against looping on a full buffer
+        if (n == 0) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            staging_len_ = 0;
+            continue;
+        }
+
+        memcpy(staging_ + staging_len_, data, n);
+        staging_len_ += n;
+        data += n;
+        len -= n;
+
+        if (staging_len_ >= config_.block_size) {
+            write_staging(false);
+        }
+    }
+}
+
+int dlt_file_storage::write_staging(bool pad)
+{
+    size_t aligned = staging_len_ & ~((size_t)DLT_STORAGE_ALIGN - 1);
+    size_t wlen = aligned;
+    size_t off = 0;
+
+    // buffered files need no padding, the tail is written as is
+    if (pad) {
+        wlen = fd_direct_ ? (staging_len_ + DLT_STORAGE_ALIGN - 1) & ~((size_t)DLT_STORAGE_ALIGN - 1)
+                          : staging_len_;
+        memset(staging_ + staging_len_, 0, wlen - staging_len_);
+    }
+
+    // no segment is open, the data is lost
+    if (fd_ < 0) {
+        if (staging_len_ > 0) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            staging_len_ = 0;
+        }
+        return -1;
+    }
+
+    if (wlen == 0) {
+        return 0;
+    }
+
+    while (off < wlen) {
+        ssize_t ret = pwrite(fd_, staging_ + off, wlen - off, file_off_ + off);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        off += ret;
+    }
+    bytes_written_.fetch_add(aligned, std::memory_order_relaxed);
+
+    // the unaligned tail stays in the staging buffer and is written
+    // again at the same offset with the next data
+    memmove(staging_, staging_ + aligned, staging_len_ - aligned);
+    staging_len_ -= aligned;
+    file_off_ += aligned;
+
+    return 0;
+}
+
+int dlt_file_storage::open_segment()
+{
+    char name[64];
+    struct tm tm;
+    time_t now = time(nullptr);
+    std::string path;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+    localtime_r(&now, &tm);
+    snprintf(name, sizeof(name), "_%04d%02d%02d_%02d%02d%02d_%04d.dlt",
+                                 tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                                 tm.tm_hour, tm.tm_min, tm.tm_sec,
+                                 segment_seq_ ++ % 10000);
+    path = config_.directory + "/" + config_.prefix + name;
+
+    fd_direct_ = false;
+    fd_ = -1;
+    if (config_.direct_io) {
+        fd_ = open(path.c_str(), flags | O_DIRECT, 0644);
+        fd_direct_ = (fd_ >= 0);
+    }
+    // tmpfs and some other file systems do not support O_DIRECT
+    if (fd_ < 0) {
+        fd_ = open(path.c_str(), flags, 0644);
+    }
+    if (fd_ < 0) {
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    file_off_ = 0;
+    staging_len_ = 0;
+    segment_start_ = std::chrono::steady_clock::now();
+    last_fsync_ = segment_start_;
+
+    if (config_.index) {
+        dlt_index_file_hdr hdr;
+
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, DLT_INDEX_MAGIC, sizeof(hdr.magic));
+        hdr.version = DLT_INDEX_VERSION;
+        hdr.span_size = DLT_INDEX_SPAN_SIZE;
+        hdr.flags = config_.compress ? DLT_INDEX_FILE_COMPRESSED : 0;
+
+        idx_fd_ = open(dlt_index_path(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if ((idx_fd_ >= 0) && (::write(idx_fd_, &hdr, sizeof(hdr)) != sizeof(hdr))) {
+            close(idx_fd_);
+            idx_fd_ = -1;
+        }
+        if (idx_fd_ < 0) {
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    segments_.push_back(path);
+    remove_old_segments();
+
+    return 0;
+}
+
+void dlt_file_storage::reopen_segment()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    if (now < reopen_at_) {
+        return;
+    }
+
+    // a full disk or too many open files may clear up, retry less often
+    // while it does not
+    if (open_segment() < 0) {
+        reopen_delay_ms_ = std::min(std::max(reopen_delay_ms_ * 2, DLT_STORAGE_REOPEN_MIN_MS),
+                                    DLT_STORAGE_REOPEN_MAX_MS);
+        reopen_at_ = now + std::chrono::milliseconds(reopen_delay_ms_);
+        return;
+    }
+    reopen_delay_ms_ = 0;
+}
+
+void dlt_file_storage::close_segment()
+{
+    size_t size;
+
+    if (fd_ < 0) {
+        return;
+    }
+
+    size = file_off_ + staging_len_;
+    write_staging(true);
+    bytes_written_.fetch_add(staging_len_, std::memory_order_relaxed);
+
+    // cut the padding of the last direct write
+    if (ftruncate(fd_, size) < 0) {
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (config_.fsync != dlt_fsync_policy::NONE) {
+        fdatasync(fd_);
+    }
+
+    close(fd_);
+    fd_ = -1;
+    if (idx_fd_ >= 0) {
+        close(idx_fd_);
+        idx_fd_ = -1;
+    }
+    staging_len_ = 0;
+    file_off_ = 0;
+}
+
+void dlt_file_storage::remove_old_segments()
+{
+    if (config_.max_segments <= 0) {
+        return;
+    }
+
+    while (segments_.size() > (size_t)config_.max_segments) {
+        unlink(segments_.front().c_str());
+        unlink(dlt_index_path(segments_.front()).c_str());
+        segments_.pop_front();
+    }
+}
+
+}
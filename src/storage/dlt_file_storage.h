@@ -0,0 +1,199 @@
+/**
+ * @file dlt_file_storage.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief stores encoded dlt messages in rotated .dlt files
+ * @version 0.1
+ * @date 2021-12-28
+ * 
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_FILE_STORAGE_H__
+#define __AUTO_MIDDLEWARE_DLT_FILE_STORAGE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <dlt_storage_index.h>
+#include <dlt_sink.h>
+
+namespace auto_os::middleware {
+
+// alignment of O_DIRECT writes, covers 512 and 4096 byte sector devices
+#define DLT_STORAGE_ALIGN 4096
+
+// number of message blocks between the workers and the writer thread
+#define DLT_STORAGE_N_BLOCKS 8
+
+// retry delay after a segment failed to open, doubled up to the maximum
+#define DLT_STORAGE_REOPEN_MIN_MS 100
+#define DLT_STORAGE_REOPEN_MAX_MS 10000
+
+/**
+ * @brief when written data is synced to the device
+ */
+enum class dlt_fsync_policy {
+    // left to the kernel
+    NONE,
+    // when a segment is closed
+    SEGMENT,
+    // at most every fsync_interval_ms
+    INTERVAL,
+    // after every write
+    BATCH,
+};
+
+/**
+ * @brief file storage configuration
+ */
+struct dlt_file_storage_config {
+    std::string directory;
+    std::string prefix;
+    // a segment is closed once it reaches this size or age, 0 disables
+    size_t segment_size;
+    int segment_duration_s;
+    // oldest segments are removed above this count, 0 keeps all
+    int max_segments;
+    // size of one write
+    size_t block_size;
+    // partially filled blocks are written at this interval
+    int flush_interval_ms;
+    dlt_fsync_policy fsync;
+    int fsync_interval_ms;
+    bool direct_io;
+    // write a .idx file next to each segment
+    bool index;
+    // write blocks as compressed dlt_block
+    bool compress;
+};
+
+/**
+ * @brief writes messages with a storage header into .dlt segment files
+ *
+ * Workers copy messages into blocks under a short lock, a writer thread
+ * writes full blocks, and partial ones every flush interval, so a slow
+ * device never stalls processing. When no block is free the message is
+ * dropped and counted. With direct_io the file is opened with O_DIRECT
+ * and written in DLT_STORAGE_ALIGN multiples from an aligned staging
+ * buffer. The unaligned tail is written padded, then rewritten with the
+ * next block, and the padding is truncated when the segment is closed.
+ *
+ * With index enabled every DLT_INDEX_SPAN_SIZE bytes of messages get a
+ * dlt_index_entry with their time range and (app_id, ctx_id, level)
+ * keys, appended to the segment's .idx file after the block is written.
+ * With compress each block is written as one dlt_block.
+ */
+class dlt_file_storage : public dlt_sink {
+    public:
+        /**
+         * @brief create storage and start the writer thread
+         * 
+         * @param in config storage configuration
+         * @param in ecu_id ecu id of the storage header
+         */
+        explicit dlt_file_storage(const dlt_file_storage_config &config, const uint8_t *ecu_id);
+        ~dlt_file_storage();
+
+        dlt_file_storage(const dlt_file_storage &) = delete;
+        const dlt_file_storage &operator=(const dlt_file_storage &) = delete;
+        dlt_file_storage(const dlt_file_storage &&) = delete;
+        const dlt_file_storage &&operator=(const dlt_file_storage &&) = delete;
+
+        /**
+         * @brief store an encoded message, never blocks on the device
+         * 
+         * @param in msg encoded dlt message
+         * @param in len length of the message
+         * @return returns 0 on success -1 if the message is dropped
+         */
+        int write(const uint8_t *msg, int len) override;
+
+        /**
+         * @brief change the ecu id of the storage header
+         */
+        inline void set_ecu_id(const uint8_t *ecu_id)
+        {
+            uint32_t id;
+
+            memcpy(&id, ecu_id, sizeof(id));
+            ecu_id_.store(id, std::memory_order_relaxed);
+        }
+
+        inline const char *get_name() override { return "file"; }
+        inline uint64_t get_dropped() override { return dropped_.load(std::memory_order_relaxed); }
+        inline uint64_t get_write_errors() { return write_errors_.load(std::memory_order_relaxed); }
+        inline uint64_t get_bytes_written() { return bytes_written_.load(std::memory_order_relaxed); }
+
+    private:
+        // index entry of a span, offset is relative to the block until
+        // the block is written
+        struct span {
+            dlt_index_entry entry;
+            dlt_index_key keys[DLT_INDEX_MAX_KEYS];
+        };
+
+        struct block {
+            std::unique_ptr<uint8_t[]> buf;
+            size_t len;
+            std::vector<span> spans;
+            size_t n_spans;
+        };
+
+        void writer();
+        void write_block(const uint8_t *data, size_t len);
+        int write_staging(bool pad);
+        int open_segment();
+        void reopen_segment();
+        void close_segment();
+        void remove_old_segments();
+        void index_msg(block *b, size_t need, uint64_t time_us,
+                       const uint8_t *app_id, const uint8_t *ctx_id, uint8_t level);
+        void write_index(block *b, size_t seg_off, bool compressed);
+
+        dlt_file_storage_config config_;
+        // changed by a configuration reload
+        std::atomic<uint32_t> ecu_id_;
+
+        // shared between the workers and the writer
+        std::mutex lock_;
+        std::condition_variable cond_;
+        std::vector<std::unique_ptr<block>> blocks_;
+        block *active_;
+        std::deque<block *> full_;
+        std::vector<block *> free_;
+        bool stop_;
+
+        // writer thread only
+        int fd_;
+        int idx_fd_;
+        std::vector<uint8_t> idx_buf_;
+        std::vector<uint8_t> comp_buf_;
+        bool fd_direct_;
+        uint8_t *staging_;
+        size_t staging_len_;
+        // file offset of the start of the staging buffer
+        size_t file_off_;
+        std::chrono::steady_clock::time_point segment_start_;
+        std::chrono::steady_clock::time_point last_fsync_;
+        // next attempt to open a segment after one failed
+        std::chrono::steady_clock::time_point reopen_at_;
+        int reopen_delay_ms_;
+        int segment_seq_;
+        std::deque<std::string> segments_;
+
+        std::atomic<uint64_t> dropped_;
+        std::atomic<uint64_t> write_errors_;
+        std::atomic<uint64_t> bytes_written_;
+        std::thread writer_thr_;
+};
+
+}
+
+#endif
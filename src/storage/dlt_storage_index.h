@@ -0,0 +1,103 @@
+/**
+ * @file dlt_storage_index.h
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief layout of the sidecar index written next to each .dlt segment
+ * @version 0.1
+ * @date 2021-12-29
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ */
+#ifndef __AUTO_MIDDLEWARE_DLT_STORAGE_INDEX_H__
+#define __AUTO_MIDDLEWARE_DLT_STORAGE_INDEX_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+namespace auto_os::middleware {
+
+#define DLT_INDEX_MAGIC "DLTI"
+#define DLT_INDEX_VERSION 1
+#define DLT_INDEX_SUFFIX ".idx"
+
+// bytes of messages described by one index entry, a query reads at
+// least this much around each match
+#define DLT_INDEX_SPAN_SIZE 65536
+
+// distinct (app_id, ctx_id) pairs listed per entry, an entry with more
+// is marked DLT_INDEX_KEYS_OVERFLOW and always scanned
+#define DLT_INDEX_MAX_KEYS 32
+
+#define DLT_INDEX_KEYS_OVERFLOW 0x01
+
+// the segment is made of compressed blocks
+#define DLT_INDEX_FILE_COMPRESSED 0x01
+
+// bit of a message that is not a log message in the level bitmaps,
+// log messages use bit 1 (fatal) to 6 (verbose)
+#define DLT_INDEX_LEVEL_NON_LOG 0x01
+
+/**
+ * @brief file header
+ */
+struct dlt_index_file_hdr {
+    char magic[4];
+    uint32_t version;
+    uint32_t span_size;
+    uint32_t flags;
+} __attribute__ ((__packed__));
+
+/**
+ * @brief one (app_id, ctx_id) pair seen in a span, with the bitmap of
+ *        its levels
+ */
+struct dlt_index_key {
+    uint8_t app_id[4];
+    uint8_t ctx_id[4];
+    uint8_t levels;
+    uint8_t reserved[3];
+} __attribute__ ((__packed__));
+
+/**
+ * @brief one span of messages, followed by n_keys dlt_index_key
+ *
+ * Entries are appended in file order. Times are the storage header
+ * times in microseconds since the epoch. In a compressed segment offset
+ * is the file offset of the block holding the span and block_off the
+ * offset of the span in the decompressed block.
+ */
+struct dlt_index_entry {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t n_msgs;
+    uint64_t first_us;
+    uint64_t last_us;
+    uint8_t levels;
+    uint8_t flags;
+    uint16_t n_keys;
+    uint32_t block_off;
+} __attribute__ ((__packed__));
+
+/**
+ * @brief level bitmap bit of a decoded message_info byte
+ */
+static inline uint8_t dlt_index_level_bit(uint8_t message_info)
+{
+    // message type log is 0
+    if (((message_info >> 1) & 0x07) != 0) {
+        return DLT_INDEX_LEVEL_NON_LOG;
+    }
+    return 1 << ((message_info >> 4) & 0x07);
+}
+
+/**
+ * @brief index file path of a segment
+ */
+static inline std::string dlt_index_path(const std::string &segment)
+{
+    return segment.substr(0, segment.length() - 4) + DLT_INDEX_SUFFIX;
+}
+
+}
+
+#endif
@@ -19,5 +19,9 @@ int main(int argc, char **argv)
     log->verbose(app_id, context_id, "testing dlt message\n");
     log->error(app_id, context_id, "testing dlt message\n");
     log->fatal(app_id, context_id, "testing dlt message\n");
+    // send typed verbose arguments without formatting
+    log->log(DLT_MSG_LOG_LVL_INFO, app_id, context_id, "typed dlt message", 42, -7L, 3.5, true);
+    // send a non verbose message, the format is in the catalog only
+    DLT_LOG_NV(DLT_MSG_LOG_LVL_INFO, app_id, context_id, "non verbose dlt message %d %s %.2f\n", 42, "str", 3.5);
 }
 
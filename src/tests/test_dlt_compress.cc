@@ -0,0 +1,310 @@
+/**
+ * @file test_dlt_compress.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief tests for the lz4 codec and compressed blocks
+ * @version 0.1
+ * @date 2021-12-31
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <dlt_compress.h>
+#include <dlt_enc_dec.h>
+
+using namespace auto_os::middleware;
+
+static int failures;
+
+#define TEST_ASSERT(__cond) {\
+    if (!(__cond)) {\
+        fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #__cond);\
+        failures ++;\
+    }\
+}
+
+// text like data with repeats, and data that does not compress
+static std::vector<uint8_t> make_data(size_t len, bool random)
+{
+    std::vector<uint8_t> d(len);
+    uint32_t x = 12345;
+    size_t i;
+
+    for (i = 0; i < len; i ++) {
+        x = x * 1103515245 + 12345;
+        d[i] = random ? (x >> 16) & 0xff : "dlt message counter "[i % 20] + (i / 200) % 3;
+    }
+
+    return d;
+}
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t> &raw)
+{
+    std::vector<uint8_t> c(dlt_lz4::bound(raw.size()));
+    // never pass the null data() of an empty vector
+    std::vector<uint8_t> src(raw);
+    int ret;
+
+    src.push_back(0);
+    ret = dlt_lz4::compress(src.data(), raw.size(), c.data(), c.size());
+    TEST_ASSERT(ret > 0);
+    c.resize(ret > 0 ? ret : 0);
+
+    return c;
+}
+
+static int decompress(const std::vector<uint8_t> &c, size_t dst_size)
+{
+    std::vector<uint8_t> out(dst_size + 1);
+
+    return dlt_lz4::decompress(c.data(), c.size(), out.data(), dst_size);
+}
+
+static void test_roundtrip()
+{
+    size_t lens[] = { 0, 1, 12, 13, 100, 4096, 70000 };
+
+    for (size_t len : lens) {
+        for (int random = 0; random < 2; random ++) {
+            std::vector<uint8_t> raw = make_data(len, random);
+            std::vector<uint8_t> c = compress(raw);
+            std::vector<uint8_t> out(len + 1);
+
+            TEST_ASSERT(c.size() <= dlt_lz4::bound(len));
+            TEST_ASSERT(dlt_lz4::decompress(c.data(), c.size(), out.data(), len) == (int)len);
+            TEST_ASSERT(len == 0 || memcmp(out.data(), raw.data(), len) == 0);
+        }
+    }
+
+    // output that does not fit is a failure, not a short result
+    {
+        std::vector<uint8_t> raw = make_data(4096, true);
+        std::vector<uint8_t> c(4096);
+
+        TEST_ASSERT(dlt_lz4::compress(raw.data(), raw.size(), c.data(), c.size()) == -1);
+    }
+}
+
+static void test_truncated()
+{
+    std::vector<uint8_t> raw = make_data(4096, false);
+    std::vector<uint8_t> c = compress(raw);
+    size_t i;
+
+    // cutting the stream anywhere never yields the whole output
+    for (i = 0; i < c.size(); i ++) {
+        std::vector<uint8_t> t(c.begin(), c.begin() + i);
+        int ret = decompress(t, raw.size());
+
+        TEST_ASSERT(ret < (int)raw.size());
+    }
+
+    // literal length extension missing or cut
+    TEST_ASSERT(decompress({ 0xf0 }, 64) == -1);
+    TEST_ASSERT(decompress({ 0xf0, 0xff }, 64) == -1);
+    TEST_ASSERT(decompress({ 0xf0, 0x05, 'a' }, 64) == -1);
+    // literals shorter than the token says
+    TEST_ASSERT(decompress({ 0x50, 'a', 'b' }, 64) == -1);
+    // offset cut after one byte
+    TEST_ASSERT(decompress({ 0x10, 'a', 0x01 }, 64) == -1);
+    // match length extension missing
+    TEST_ASSERT(decompress({ 0x1f, 'a', 0x01, 0x00 }, 64) == -1);
+}
+
+static void test_bad_offset()
+{
+    // offset 0
+    TEST_ASSERT(decompress({ 0x10, 'a', 0x00, 0x00, 0x50, 'a', 'b', 'c', 'd', 'e' }, 64) == -1);
+    // offset before the start of the output
+    TEST_ASSERT(decompress({ 0x10, 'a', 0x02, 0x00, 0x50, 'a', 'b', 'c', 'd', 'e' }, 64) == -1);
+    TEST_ASSERT(decompress({ 0x00, 0x01, 0x00, 0x50, 'a', 'b', 'c', 'd', 'e' }, 64) == -1);
+    TEST_ASSERT(decompress({ 0x10, 'a', 0xff, 0xff, 0x50, 'a', 'b', 'c', 'd', 'e' }, 64) == -1);
+    // offset 1 repeats the last byte
+    {
+        std::vector<uint8_t> c = { 0x10, 'a', 0x01, 0x00, 0x50, 'a', 'b', 'c', 'd', 'e' };
+        std::vector<uint8_t> out(64);
+
+        TEST_ASSERT(dlt_lz4::decompress(c.data(), c.size(), out.data(), out.size()) == 10);
+        TEST_ASSERT(memcmp(out.data(), "aaaaaabcde", 10) == 0);
+    }
+}
+
+static void test_overrun()
+{
+    std::vector<uint8_t> raw = make_data(4096, false);
+    std::vector<uint8_t> c = compress(raw);
+    std::vector<uint8_t> lit = { 0x50, 'a', 'b', 'c', 'd', 'e' };
+    // 'a' then a match of 4 + 15 + 20 bytes and the closing literals
+    std::vector<uint8_t> match = { 0x1f, 'a', 0x01, 0x00, 20, 0x50, 'a', 'b', 'c', 'd', 'e' };
+    size_t i;
+
+    // every output size short of the raw length
+    for (i = 0; i < raw.size(); i += 7) {
+        TEST_ASSERT(decompress(c, i) == -1);
+    }
+
+    // literals past dst_size
+    TEST_ASSERT(decompress(lit, 4) == -1);
+    TEST_ASSERT(decompress(lit, 5) == 5);
+
+    // match past dst_size
+    TEST_ASSERT(decompress(match, 1 + 39 + 5) == 45);
+    for (i = 0; i < 1 + 39 + 5; i ++) {
+        TEST_ASSERT(decompress(match, i) == -1);
+    }
+}
+
+static std::vector<uint8_t> make_block(uint8_t codec, uint32_t raw_len, uint32_t data_len,
+                                       const std::vector<uint8_t> &data)
+{
+    dlt_block_hdr hdr;
+    std::vector<uint8_t> b(DLT_BLOCK_HDR_LEN);
+
+    memcpy(hdr.magic, DLT_BLOCK_MAGIC, DLT_BLOCK_MAGIC_LEN);
+    hdr.codec = codec;
+    hdr.flags = 0;
+    hdr.reserved = 0;
+    hdr.raw_len = raw_len;
+    hdr.data_len = data_len;
+    memcpy(b.data(), &hdr, sizeof(hdr));
+    b.insert(b.end(), data.begin(), data.end());
+
+    return b;
+}
+
+static void test_block()
+{
+    std::vector<uint8_t> raw = make_data(4096, false);
+    std::vector<uint8_t> c = compress(raw);
+    std::vector<uint8_t> out(raw.size());
+    dlt_block_hdr hdr;
+    size_t need;
+
+    // roundtrip through encode, compressed and stored
+    for (int random = 0; random < 2; random ++) {
+        std::vector<uint8_t> r = make_data(4096, random);
+        std::vector<uint8_t> b(dlt_block::bound(r.size()));
+        int len = dlt_block::encode(r.data(), r.size(), false, b.data(), b.size());
+
+        TEST_ASSERT(len > 0);
+        TEST_ASSERT(dlt_block::is_block(b.data(), len));
+        TEST_ASSERT(dlt_block::parse(b.data(), len, hdr, need) == len);
+        TEST_ASSERT(hdr.codec == (random ? DLT_BLOCK_CODEC_NONE : DLT_BLOCK_CODEC_LZ4));
+        TEST_ASSERT(dlt_block::decode(b.data(), hdr, out.data()) == (int)r.size());
+        TEST_ASSERT(out == r);
+    }
+
+    // incomplete header and data
+    {
+        std::vector<uint8_t> b = make_block(DLT_BLOCK_CODEC_LZ4, raw.size(), c.size(), c);
+
+        TEST_ASSERT(dlt_block::parse(b.data(), DLT_BLOCK_HDR_LEN - 1, hdr, need) == 0);
+        TEST_ASSERT(need == DLT_BLOCK_HDR_LEN);
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size() - 1, hdr, need) == 0);
+        TEST_ASSERT(need == b.size());
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == (int)b.size());
+    }
+
+    // header fields that do not agree
+    {
+        std::vector<uint8_t> b;
+
+        b = make_block(DLT_BLOCK_CODEC_NONE, 10, 11, std::vector<uint8_t>(11));
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+        b = make_block(DLT_BLOCK_CODEC_NONE, 11, 10, std::vector<uint8_t>(10));
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+        b = make_block(DLT_BLOCK_CODEC_LZ4, 10, dlt_lz4::bound(10) + 1, std::vector<uint8_t>(dlt_lz4::bound(10) + 1));
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+        b = make_block(DLT_BLOCK_CODEC_LZ4, DLT_BLOCK_MAX_RAW_LEN + 1, 16, std::vector<uint8_t>(16));
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+        b = make_block(DLT_BLOCK_CODEC_LZ4 + 1, 16, 16, std::vector<uint8_t>(16));
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+        b = make_block(DLT_BLOCK_CODEC_LZ4, 0xffffffff, 0xffffffff, { });
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+        b = make_block(DLT_BLOCK_CODEC_NONE, 4, 4, { 1, 2, 3, 4 });
+        b[3] = 0x02;
+        TEST_ASSERT(!dlt_block::is_block(b.data(), b.size()));
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == -1);
+    }
+
+    // raw_len that does not match the decompressed length
+    {
+        std::vector<uint8_t> b;
+        std::vector<uint8_t> big(raw.size() + 1);
+
+        b = make_block(DLT_BLOCK_CODEC_LZ4, raw.size() + 1, c.size(), c);
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == (int)b.size());
+        TEST_ASSERT(dlt_block::decode(b.data(), hdr, big.data()) == -1);
+        b = make_block(DLT_BLOCK_CODEC_LZ4, raw.size() - 1, c.size(), c);
+        TEST_ASSERT(dlt_block::parse(b.data(), b.size(), hdr, need) == (int)b.size());
+        TEST_ASSERT(dlt_block::decode(b.data(), hdr, out.data()) == -1);
+    }
+}
+
+// a block in a stream is returned frame by frame, a broken one is skipped
+static void test_block_in_stream()
+{
+    std::vector<uint8_t> frames;
+    std::vector<uint8_t> stream;
+    dlt_msg_view msg;
+    int counter = 0;
+    int i;
+
+    for (i = 0; i < 20; i ++) {
+        uint8_t f[] = { DLT_HDR_VERSION << 5, (uint8_t)i, 0x00, 0x0c, 'd', 'l', 't', ' ', 'm', 's', 'g', ' ' };
+
+        frames.insert(frames.end(), f, f + sizeof(f));
+    }
+
+    std::vector<uint8_t> b(dlt_block::bound(frames.size()));
+    int len = dlt_block::encode(frames.data(), frames.size(), false, b.data(), b.size());
+
+    TEST_ASSERT(len > 0);
+    b.resize(len > 0 ? len : 0);
+    stream = b;
+    stream.insert(stream.end(), frames.begin(), frames.begin() + 12);
+
+    {
+        dlt_decoder dec;
+
+        dec.feed(stream.data(), stream.size());
+        while (dec.next(msg) == 1) {
+            TEST_ASSERT(msg.msg_counter == counter % 20);
+            counter ++;
+        }
+        TEST_ASSERT(counter == 21);
+        TEST_ASSERT(dec.get_errors() == 0);
+    }
+
+    // the same block with a raw_len one byte short
+    {
+        dlt_decoder dec;
+
+        b[8] --;
+        dec.feed(b.data(), b.size());
+        while (dec.next(msg) == 1) {
+        }
+        TEST_ASSERT(dec.get_errors() > 0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    test_roundtrip();
+    test_truncated();
+    test_bad_offset();
+    test_overrun();
+    test_block();
+    test_block_in_stream();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
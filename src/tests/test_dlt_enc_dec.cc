@@ -0,0 +1,558 @@
+/**
+ * @file test_dlt_enc_dec.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief tests for the dlt stream decoder and the verbose argument reader
+ * @version 0.1
+ * @date 2021-12-31
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <dlt_enc_dec.h>
+
+using namespace auto_os::middleware;
+
+static int failures;
+
+#define TEST_ASSERT(__cond) {\
+    if (!(__cond)) {\
+        fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #__cond);\
+        failures ++;\
+    }\
+}
+
+// header type with protocol version 1
+#define TEST_HTYP (DLT_HDR_VERSION << 5)
+
+static void put_u16(std::vector<uint8_t> &b, uint16_t val, bool msb_first)
+{
+    if (msb_first) {
+        b.push_back(val >> 8);
+        b.push_back(val & 0xff);
+    } else {
+        b.push_back(val & 0xff);
+        b.push_back(val >> 8);
+    }
+}
+
+static void put_u32(std::vector<uint8_t> &b, uint32_t val, bool msb_first)
+{
+    int i;
+
+    for (i = 0; i < 4; i ++) {
+        int shift = msb_first ? (24 - i * 8) : (i * 8);
+        b.push_back((val >> shift) & 0xff);
+    }
+}
+
+static void put_uint(std::vector<uint8_t> &b, uint64_t val, int len, bool msb_first)
+{
+    int i;
+
+    for (i = 0; i < len; i ++) {
+        int shift = msb_first ? ((len - 1 - i) * 8) : (i * 8);
+        b.push_back((val >> shift) & 0xff);
+    }
+}
+
+// one frame with the ecu id and, if ext, an extended header
+static std::vector<uint8_t> make_frame(uint8_t counter, bool ext, bool verbose, bool msb_first,
+                                       uint8_t n_args, const std::vector<uint8_t> &payload)
+{
+    std::vector<uint8_t> b;
+    uint8_t htyp = TEST_HTYP | DLT_HDR_TYPE_WITH_ECU_ID;
+    size_t len = DLT_STD_HDR_MIN_LEN + DLT_STD_HDR_ECU_ID_LEN;
+
+    if (ext) {
+        htyp |= DLT_HDR_TYPE_USE_EXT_HEADER;
+        len += DLT_EXT_HDR_LEN;
+    }
+    if (msb_first) {
+        htyp |= DLT_HDR_TYPE_MSB_FIRST;
+    }
+    len += payload.size();
+
+    b.push_back(htyp);
+    b.push_back(counter);
+    put_u16(b, len, true);
+    b.insert(b.end(), { 'E', 'C', 'U', '1' });
+    if (ext) {
+        b.push_back(verbose ? DLT_EXT_HDR_MSG_INFO_VERBOSE : 0);
+        b.push_back(n_args);
+        b.insert(b.end(), { 'A', 'P', 'P', '1' });
+        b.insert(b.end(), { 'C', 'T', 'X', '1' });
+    }
+    b.insert(b.end(), payload.begin(), payload.end());
+
+    return b;
+}
+
+static std::vector<uint8_t> make_storage_frame(uint8_t counter)
+{
+    std::vector<uint8_t> b = { 'D', 'L', 'T', 0x01 };
+    std::vector<uint8_t> f = make_frame(counter, true, false, false, 0, { 1, 2, 3, 4 });
+
+    put_u32(b, 1000 + counter, false);
+    put_u32(b, counter, false);
+    b.insert(b.end(), { 'E', 'C', 'U', '1' });
+    b.insert(b.end(), f.begin(), f.end());
+
+    return b;
+}
+
+// feed buffers one by one and collect the message counters of the frames
+static std::vector<int> decode_all(dlt_decoder &dec, const std::vector<std::vector<uint8_t>> &bufs)
+{
+    std::vector<int> counters;
+    dlt_msg_view msg;
+
+    for (auto &b : bufs) {
+        dec.feed(b.data(), b.size());
+        while (dec.next(msg) == 1) {
+            counters.push_back(msg.msg_counter);
+        }
+    }
+
+    return counters;
+}
+
+static void cat(std::vector<uint8_t> &dst, const std::vector<uint8_t> &src)
+{
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+
+static void test_split_feed()
+{
+    std::vector<uint8_t> stream = make_frame(1, true, false, false, 0, { 0xaa, 0xbb, 0xcc, 0xdd, 0xee });
+    size_t i;
+
+    cat(stream, make_frame(2, false, false, false, 0, { 0x11 }));
+    cat(stream, make_frame(3, true, true, true, 0, { }));
+
+    // every split point, including inside the length field
+    for (i = 1; i < stream.size(); i ++) {
+        dlt_decoder dec;
+        std::vector<uint8_t> a(stream.begin(), stream.begin() + i);
+        std::vector<uint8_t> b(stream.begin() + i, stream.end());
+        std::vector<int> counters = decode_all(dec, { a, b });
+
+        TEST_ASSERT((counters == std::vector<int>{ 1, 2, 3 }));
+        TEST_ASSERT(dec.get_errors() == 0);
+    }
+
+    // one byte per feed, the reassembled view must be complete
+    {
+        dlt_decoder dec;
+        dlt_msg_view msg;
+        int n = 0;
+
+        for (i = 0; i < stream.size(); i ++) {
+            dec.feed(&stream[i], 1);
+            while (dec.next(msg) == 1) {
+                n ++;
+                if (msg.msg_counter == 1) {
+                    TEST_ASSERT(msg.payload_len == 5);
+                    TEST_ASSERT(msg.payload[0] == 0xaa && msg.payload[4] == 0xee);
+                    TEST_ASSERT(memcmp(msg.app_id, "APP1", 4) == 0);
+                }
+            }
+        }
+        TEST_ASSERT(n == 3);
+    }
+}
+
+static void test_resync_garbage()
+{
+    std::vector<uint8_t> stream = { 0xff, 0x00, 0x13, 0xc7, 0x00 };
+    dlt_decoder dec;
+    std::vector<int> counters;
+
+    cat(stream, make_frame(7, true, false, false, 0, { 1, 2, 3, 4 }));
+    stream.insert(stream.end(), { 0xe0, 0xe0 });
+    cat(stream, make_frame(8, true, false, false, 0, { 5, 6, 7, 8 }));
+
+    counters = decode_all(dec, { stream });
+    TEST_ASSERT((counters == std::vector<int>{ 7, 8 }));
+    TEST_ASSERT(dec.get_errors() > 0);
+}
+
+static void test_resync_storage()
+{
+    std::vector<uint8_t> stream = { 'x', 'D', 'L', 'D', 0x01, 0xff };
+    std::vector<uint8_t> bad = { 'D', 'L', 'T', 0x01 };
+    std::vector<int> counters;
+    size_t i;
+
+    cat(stream, make_storage_frame(1));
+    // a storage pattern followed by a frame of the wrong version
+    bad.resize(DLT_STORAGE_HDR_LEN, 0);
+    bad.insert(bad.end(), { 0xe1, 0x00, 0x00, 0x08, 0, 0, 0, 0 });
+    cat(stream, bad);
+    cat(stream, make_storage_frame(2));
+    // "DL" at the end of a buffer and "DLT" not followed by 0x01
+    stream.insert(stream.end(), { 'D', 'L', 'T', 0x02, 'D', 'L' });
+    cat(stream, make_storage_frame(3));
+
+    {
+        dlt_decoder dec(true);
+
+        counters = decode_all(dec, { stream });
+        TEST_ASSERT((counters == std::vector<int>{ 1, 2, 3 }));
+        TEST_ASSERT(dec.get_errors() > 0);
+    }
+
+    // the pattern itself split across buffers
+    for (i = 1; i < stream.size(); i ++) {
+        dlt_decoder dec(true);
+        std::vector<uint8_t> a(stream.begin(), stream.begin() + i);
+        std::vector<uint8_t> b(stream.begin() + i, stream.end());
+
+        counters = decode_all(dec, { a, b });
+        TEST_ASSERT((counters == std::vector<int>{ 1, 2, 3 }));
+    }
+
+    // storage header fields
+    {
+        std::vector<uint8_t> f = make_storage_frame(5);
+        dlt_msg_view msg;
+        size_t need;
+
+        TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), true, msg, need) == (int)f.size());
+        TEST_ASSERT(msg.storage_sec == 1005);
+        TEST_ASSERT(msg.storage_usec == 5);
+        TEST_ASSERT(memcmp(msg.storage_ecu_id, "ECU1", 4) == 0);
+    }
+}
+
+static void test_length_field()
+{
+    std::vector<uint8_t> f = make_frame(1, true, false, false, 0, { 1, 2, 3, 4 });
+    dlt_msg_view msg;
+    size_t need;
+    size_t i;
+
+    // truncated buffers are incomplete, never malformed
+    for (i = 0; i < f.size(); i ++) {
+        TEST_ASSERT(dlt_decoder::parse(f.data(), i, false, msg, need) == 0);
+        TEST_ASSERT(need > i);
+    }
+    TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) == (int)f.size());
+
+    // length shorter than the headers it announces
+    for (i = 0; i < DLT_STD_HDR_MIN_LEN + DLT_STD_HDR_ECU_ID_LEN + DLT_EXT_HDR_LEN; i ++) {
+        std::vector<uint8_t> t = f;
+
+        t[2] = 0;
+        t[3] = i;
+        TEST_ASSERT(dlt_decoder::parse(t.data(), t.size(), false, msg, need) == -1);
+    }
+
+    // length past the end of the data waits for the rest
+    {
+        std::vector<uint8_t> t = f;
+        std::vector<uint8_t> rest(0xffff - f.size(), 0x5a);
+        dlt_decoder dec;
+        std::vector<int> counters;
+
+        t[2] = 0xff;
+        t[3] = 0xff;
+        TEST_ASSERT(dlt_decoder::parse(t.data(), t.size(), false, msg, need) == 0);
+        TEST_ASSERT(need == 0xffff);
+
+        counters = decode_all(dec, { t });
+        TEST_ASSERT(counters.empty());
+        counters = decode_all(dec, { rest });
+        TEST_ASSERT((counters == std::vector<int>{ 1 }));
+        TEST_ASSERT(dec.get_errors() == 0);
+    }
+
+    // an oversized frame in a storage file
+    {
+        std::vector<uint8_t> t = make_storage_frame(1);
+
+        t[DLT_STORAGE_HDR_LEN + 2] = 0xff;
+        t[DLT_STORAGE_HDR_LEN + 3] = 0xff;
+        TEST_ASSERT(dlt_decoder::parse(t.data(), t.size(), true, msg, need) == 0);
+        TEST_ASSERT(need == DLT_STORAGE_HDR_LEN + 0xffff);
+    }
+}
+
+static void test_verbose_args(bool msb_first)
+{
+    std::vector<uint8_t> p;
+    dlt_msg_view msg;
+    dlt_arg_view arg;
+    size_t need;
+
+    // bool
+    put_u32(p, DLT_TYPEINFO_BOOL | DLT_TYPEINFO_TYLE_8BIT, msb_first);
+    p.push_back(1);
+    // signed and unsigned of every length
+    put_u32(p, DLT_TYPEINFO_SINT | DLT_TYPEINFO_TYLE_8BIT, msb_first);
+    put_uint(p, (uint8_t)-5, 1, msb_first);
+    put_u32(p, DLT_TYPEINFO_SINT | DLT_TYPEINFO_TYLE_16BIT, msb_first);
+    put_uint(p, (uint16_t)-300, 2, msb_first);
+    put_u32(p, DLT_TYPEINFO_SINT | DLT_TYPEINFO_TYLE_32BIT, msb_first);
+    put_uint(p, (uint32_t)-70000, 4, msb_first);
+    put_u32(p, DLT_TYPEINFO_SINT | DLT_TYPEINFO_TYLE_64BIT, msb_first);
+    put_uint(p, (uint64_t)-5000000000LL, 8, msb_first);
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_8BIT, msb_first);
+    put_uint(p, 0xfe, 1, msb_first);
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_16BIT, msb_first);
+    put_uint(p, 0xfedc, 2, msb_first);
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_32BIT, msb_first);
+    put_uint(p, 0xfedcba98, 4, msb_first);
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_64BIT, msb_first);
+    put_uint(p, 0xfedcba9876543210ULL, 8, msb_first);
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_128BIT, msb_first);
+    p.insert(p.end(), 16, 0x77);
+    // floats
+    {
+        float f = 1.5f;
+        double d = -2.25;
+        uint32_t fb;
+        uint64_t db;
+
+        memcpy(&fb, &f, sizeof(fb));
+        memcpy(&db, &d, sizeof(db));
+        put_u32(p, DLT_TYPEINFO_FLOA | DLT_TYPEINFO_TYLE_32BIT, msb_first);
+        put_uint(p, fb, 4, msb_first);
+        put_u32(p, DLT_TYPEINFO_FLOA | DLT_TYPEINFO_TYLE_64BIT, msb_first);
+        put_uint(p, db, 8, msb_first);
+    }
+    // string with name
+    put_u32(p, DLT_TYPEINFO_STRG | DLT_TYPEINFO_VARI, msb_first);
+    put_u16(p, 4, msb_first);
+    put_u16(p, 3, msb_first);
+    p.insert(p.end(), { 'n', 'm', 0, 'a', 'b', 'c', 0 });
+    // raw
+    put_u32(p, DLT_TYPEINFO_RAWD, msb_first);
+    put_u16(p, 3, msb_first);
+    p.insert(p.end(), { 0x01, 0x02, 0x03 });
+    // trace info, never named
+    put_u32(p, DLT_TYPEINFO_TRAI | DLT_TYPEINFO_VARI, msb_first);
+    put_u16(p, 2, msb_first);
+    p.insert(p.end(), { 'f', 0 });
+    // struct of two entries
+    put_u32(p, DLT_TYPEINFO_STRU | DLT_TYPEINFO_VARI, msb_first);
+    put_u16(p, 2, msb_first);
+    put_u16(p, 2, msb_first);
+    p.insert(p.end(), { 's', 0 });
+    // array of 2x3 uint16
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_16BIT | DLT_TYPEINFO_ARAY, msb_first);
+    put_u16(p, 2, msb_first);
+    put_u16(p, 2, msb_first);
+    put_u16(p, 3, msb_first);
+    p.insert(p.end(), 12, 0x11);
+    // named uint with a unit
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_32BIT | DLT_TYPEINFO_VARI, msb_first);
+    put_u16(p, 2, msb_first);
+    put_u16(p, 3, msb_first);
+    p.insert(p.end(), { 'v', 0, 'm', 's', 0 });
+    put_uint(p, 42, 4, msb_first);
+    // named bool has no unit
+    put_u32(p, DLT_TYPEINFO_BOOL | DLT_TYPEINFO_TYLE_8BIT | DLT_TYPEINFO_VARI, msb_first);
+    put_u16(p, 2, msb_first);
+    p.insert(p.end(), { 'b', 0 });
+    p.push_back(0);
+    // fixed point, 32 bit offset for a 16 bit value, 64 bit for 64
+    put_u32(p, DLT_TYPEINFO_SINT | DLT_TYPEINFO_TYLE_16BIT | DLT_TYPEINFO_FIXP, msb_first);
+    {
+        float q = 0.5f;
+        uint32_t qb;
+
+        memcpy(&qb, &q, sizeof(qb));
+        put_u32(p, qb, msb_first);
+    }
+    put_u32(p, 100, msb_first);
+    put_uint(p, 7, 2, msb_first);
+    put_u32(p, DLT_TYPEINFO_SINT | DLT_TYPEINFO_TYLE_64BIT | DLT_TYPEINFO_FIXP, msb_first);
+    put_u32(p, 0, msb_first);
+    put_uint(p, 200, 8, msb_first);
+    put_uint(p, 9, 8, msb_first);
+
+    std::vector<uint8_t> f = make_frame(1, true, true, msb_first, 0, p);
+
+    TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) == (int)f.size());
+    TEST_ASSERT(msg.is_verbose());
+
+    dlt_arg_reader rd(msg);
+
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_BOOL) && arg.as_bool());
+    TEST_ASSERT(rd.next(arg) == 1 && arg.data_len == 1 && arg.as_int() == -5);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.data_len == 2 && arg.as_int() == -300);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.data_len == 4 && arg.as_int() == -70000);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.data_len == 8 && arg.as_int() == -5000000000LL);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_uint() == 0xfe);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_uint() == 0xfedc);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_uint() == 0xfedcba98);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_uint() == 0xfedcba9876543210ULL);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.data_len == 16 && arg.data[15] == 0x77);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_FLOA) && arg.as_float() == 1.5);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_float() == -2.25);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_STRG) && arg.as_string() == "abc");
+    TEST_ASSERT(arg.name_len == 3 && strcmp(arg.name, "nm") == 0);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_RAWD) && arg.data_len == 3 && arg.data[2] == 0x03);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_TRAI) && arg.as_string() == "f");
+    TEST_ASSERT(arg.name == nullptr);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_STRU) && arg.n_dims == 2);
+    TEST_ASSERT(arg.name_len == 2 && strcmp(arg.name, "s") == 0);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_ARAY) && arg.n_dims == 2 && arg.data_len == 12);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_uint() == 42);
+    TEST_ASSERT(arg.unit_len == 3 && strcmp(arg.unit, "ms") == 0 && strcmp(arg.name, "v") == 0);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_BOOL) && !arg.as_bool());
+    TEST_ASSERT(arg.unit_len == 0 && strcmp(arg.name, "b") == 0);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.is_type(DLT_TYPEINFO_FIXP) && arg.quantization == 0.5f);
+    TEST_ASSERT(arg.as_int() == 7 && arg.offset + 4 == arg.data);
+    TEST_ASSERT(rd.next(arg) == 1 && arg.as_int() == 9 && arg.offset + 8 == arg.data);
+    TEST_ASSERT(rd.next(arg) == 0);
+
+    // cutting the payload inside an argument is malformed, on an argument
+    // boundary it ends cleanly
+    {
+        std::vector<size_t> ends;
+        dlt_arg_reader all(msg);
+        size_t cut;
+
+        while (all.next(arg) == 1) {
+            const uint8_t *end = arg.is_type(DLT_TYPEINFO_STRU) ?
+                                    (const uint8_t *)arg.name + arg.name_len : arg.data + arg.data_len;
+            ends.push_back(end - msg.payload);
+        }
+        TEST_ASSERT(ends.size() == 21 && ends.back() == p.size());
+
+        for (cut = 1; cut < p.size(); cut ++) {
+            dlt_msg_view t = msg;
+            size_t n = 0;
+            int ret;
+
+            t.payload_len = cut;
+            dlt_arg_reader cut_rd(t);
+            while ((ret = cut_rd.next(arg)) == 1) {
+                n ++;
+            }
+            while (n < ends.size() && ends[n] <= cut) {
+                n ++;
+            }
+            TEST_ASSERT(ret == ((n > 0 && ends[n - 1] == cut) ? 0 : -1));
+        }
+    }
+}
+
+static void test_bad_args()
+{
+    std::vector<uint8_t> p;
+    dlt_msg_view msg;
+    dlt_arg_view arg;
+    size_t need;
+
+    // no type bits
+    put_u32(p, DLT_TYPEINFO_TYLE_32BIT, false);
+    put_u32(p, 0, false);
+    std::vector<uint8_t> f = make_frame(1, true, true, false, 1, p);
+    TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) > 0);
+    {
+        dlt_arg_reader rd(msg);
+        TEST_ASSERT(rd.next(arg) == -1);
+    }
+
+    // invalid type length
+    p.clear();
+    put_u32(p, DLT_TYPEINFO_UINT | 0x7, false);
+    put_u32(p, 0, false);
+    f = make_frame(1, true, true, false, 1, p);
+    TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) > 0);
+    {
+        dlt_arg_reader rd(msg);
+        TEST_ASSERT(rd.next(arg) == -1);
+    }
+
+    // string length past the payload
+    p.clear();
+    put_u32(p, DLT_TYPEINFO_STRG, false);
+    put_u16(p, 100, false);
+    p.insert(p.end(), { 'a', 0 });
+    f = make_frame(1, true, true, false, 1, p);
+    TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) > 0);
+    {
+        dlt_arg_reader rd(msg);
+        TEST_ASSERT(rd.next(arg) == -1);
+    }
+
+    // array dimensions whose product wraps around 32 bits
+    p.clear();
+    put_u32(p, DLT_TYPEINFO_UINT | DLT_TYPEINFO_TYLE_8BIT | DLT_TYPEINFO_ARAY, false);
+    put_u16(p, 4, false);
+    put_u16(p, 0x100, false);
+    put_u16(p, 0x100, false);
+    put_u16(p, 0x100, false);
+    put_u16(p, 0x100, false);
+    f = make_frame(1, true, true, false, 1, p);
+    TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) > 0);
+    {
+        dlt_arg_reader rd(msg);
+        TEST_ASSERT(rd.next(arg) == -1);
+    }
+}
+
+static void test_non_verbose()
+{
+    std::vector<uint8_t> p;
+    size_t i;
+
+    for (i = 0; i < 4; i ++) {
+        std::vector<uint8_t> f = make_frame(1, true, false, false, 0, p);
+        dlt_msg_view msg;
+        size_t need;
+
+        TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) == (int)f.size());
+        TEST_ASSERT(!msg.is_verbose());
+        TEST_ASSERT(msg.payload_len == i);
+        TEST_ASSERT(msg.get_message_id() == 0);
+        p.push_back(0x10 + i);
+    }
+
+    for (i = 0; i < 2; i ++) {
+        std::vector<uint8_t> f = make_frame(1, true, false, i == 1, 0, p);
+        dlt_msg_view msg;
+        size_t need;
+
+        TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) == (int)f.size());
+        TEST_ASSERT(msg.get_message_id() == (i == 1 ? 0x10111213u : 0x13121110u));
+    }
+
+    // without an extended header a message is never verbose
+    {
+        std::vector<uint8_t> f = make_frame(1, false, false, false, 0, { 1 });
+        dlt_msg_view msg;
+        size_t need;
+
+        TEST_ASSERT(dlt_decoder::parse(f.data(), f.size(), false, msg, need) == (int)f.size());
+        TEST_ASSERT(!msg.is_verbose() && msg.app_id == nullptr);
+        TEST_ASSERT(msg.get_message_id() == 0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    test_split_feed();
+    test_resync_garbage();
+    test_resync_storage();
+    test_length_field();
+    test_verbose_args(false);
+    test_verbose_args(true);
+    test_bad_args();
+    test_non_verbose();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file test_dlt_lib.cc
+ * @author Devendra Naga (devendra.aaru@outlook.com)
+ * @brief tests for the messages dlt_lib sends to the daemon
+ * @version 0.1
+ * @date 2021-12-31
+ *
+ * @copyright Copyright (c) 2021-present All rights reserved
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dlt_lib.hpp>
+#include <dlt_clock.h>
+
+using namespace auto_os::middleware;
+
+static int failures;
+
+#define TEST_ASSERT(__cond) {\
+    if (!(__cond)) {\
+        fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #__cond);\
+        failures ++;\
+    }\
+}
+
+// time the fake daemon holds a message before it is read, it must not
+// show up in the timestamp
+#define TEST_HOLD_MS 50
+
+/**
+ * @brief stands in for dlt_service on a unix socket
+ *
+ * answers the wire version hello like a current release, or ignores it
+ * like a release before wire version 1.
+ */
+class fake_service {
+    public:
+        explicit fake_service(const std::string &path, bool ack) : path_(path), ack_(ack), stop_(false)
+        {
+            struct sockaddr_un addr;
+
+            fd_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+            unlink(path_.c_str());
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+            bind(fd_, (struct sockaddr *)&addr, sizeof(addr));
+            thr_ = std::thread(&fake_service::run, this);
+        }
+        ~fake_service()
+        {
+            stop_ = true;
+            thr_.join();
+            close(fd_);
+            unlink(path_.c_str());
+        }
+
+        /**
+         * @brief wait for the next message that is not a hello
+         */
+        std::vector<uint8_t> get_msg()
+        {
+            for (int i = 0; i < 200; i ++) {
+                {
+                    std::unique_lock<std::mutex> lock(lock_);
+
+                    if (!msgs_.empty()) {
+                        std::vector<uint8_t> msg = msgs_.front();
+
+                        msgs_.erase(msgs_.begin());
+                        return msg;
+                    }
+                }
+                usleep(5000);
+            }
+
+            return { };
+        }
+
+    private:
+        std::string path_;
+        bool ack_;
+        int fd_;
+        std::atomic<bool> stop_;
+        std::thread thr_;
+        std::mutex lock_;
+        std::vector<std::vector<uint8_t>> msgs_;
+
+        void run()
+        {
+            uint8_t buf[DLT_MSG_MAX_LEN];
+            struct pollfd pfd;
+
+            pfd.fd = fd_;
+            pfd.events = POLLIN;
+            while (!stop_) {
+                struct sockaddr_un from;
+                socklen_t from_len = sizeof(from);
+                int len;
+
+                if (poll(&pfd, 1, 10) <= 0) {
+                    continue;
+                }
+                len = recvfrom(fd_, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+                if (len <= 0) {
+                    continue;
+                }
+                if (dlt_msg_envelope::is_envelope(buf, len)) {
+                    dlt_msg_envelope *env = (dlt_msg_envelope *)buf;
+
+                    if (ack_ && (len == sizeof(dlt_msg_envelope)) && (env->flags & DLT_WIRE_HELLO)) {
+                        env->version = DLT_WIRE_VERSION;
+                        env->flags = DLT_WIRE_HELLO_ACK;
+                        sendto(fd_, buf, len, 0, (struct sockaddr *)&from, from_len);
+                    }
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(lock_);
+                msgs_.push_back(std::vector<uint8_t>(buf, buf + len));
+            }
+        }
+};
+
+// a synchronous message carries the time of the logging call
+static void test_sync_timestamp(const std::string &path)
+{
+    fake_service svc(path, true);
+    dlt_lib *log = dlt_lib::instance();
+    dlt_clock *clock = dlt_clock::instance();
+    uint8_t session_id[] = { 's', 'e', 's', '1' };
+    std::vector<uint8_t> msg;
+    uint32_t before;
+    uint32_t after;
+    uint32_t timestamp;
+    int i;
+
+    TEST_ASSERT(log->connect(path, session_id) == 0);
+
+    for (i = 0; i < 2; i ++) {
+        before = clock->now();
+        if (i == 0) {
+            log->info("app1", "ctx1", "timestamped %d", 1);
+        } else {
+            log->log(DLT_MSG_LOG_LVL_INFO, "app1", "ctx1", "typed", 42);
+        }
+        after = clock->now();
+        usleep(TEST_HOLD_MS * 1000);
+
+        msg = svc.get_msg();
+        TEST_ASSERT(msg.size() > sizeof(dlt_msg_if) + DLT_MSG_IF_TIMESTAMP_LEN);
+        if (msg.size() <= sizeof(dlt_msg_if) + DLT_MSG_IF_TIMESTAMP_LEN) {
+            continue;
+        }
+
+        dlt_msg_if *m = (dlt_msg_if *)msg.data();
+
+        TEST_ASSERT(m->dlt_msg_type_info & DLT_MSG_IF_TIMESTAMP);
+        TEST_ASSERT(memcmp(m->app_id, "app1", 4) == 0);
+        memcpy(&timestamp, msg.data() + msg.size() - DLT_MSG_IF_TIMESTAMP_LEN, sizeof(timestamp));
+        TEST_ASSERT(timestamp >= before && timestamp <= after);
+        if (i == 0) {
+            TEST_ASSERT(msg.size() == sizeof(dlt_msg_if) + strlen("timestamped 1") + DLT_MSG_IF_TIMESTAMP_LEN);
+        }
+    }
+
+    log->disconnect();
+}
+
+// a daemon that does not answer the hello gets the version 0 layout
+static void test_sync_legacy(const std::string &path)
+{
+    fake_service svc(path, false);
+    dlt_lib *log = dlt_lib::instance();
+    uint8_t session_id[] = { 's', 'e', 's', '2' };
+    std::vector<uint8_t> msg;
+
+    TEST_ASSERT(log->connect(path, session_id) == 0);
+    log->info("app1", "ctx1", "legacy %d", 2);
+
+    msg = svc.get_msg();
+    TEST_ASSERT(msg.size() == sizeof(dlt_msg_if) + strlen("legacy 2"));
+    if (msg.size() >= sizeof(dlt_msg_if)) {
+        dlt_msg_if *m = (dlt_msg_if *)msg.data();
+
+        TEST_ASSERT(!(m->dlt_msg_type_info & DLT_MSG_IF_TIMESTAMP));
+        TEST_ASSERT(m->dlt_msg_type_info == DLT_MSG_TYPEINFO_STRG);
+    }
+
+    log->disconnect();
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = "/tmp/dlt_lib_test_" + std::to_string(getpid()) + ".sock";
+
+    test_sync_timestamp(path);
+    test_sync_legacy(path);
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}